@@ -0,0 +1,304 @@
+#include "autotuner.hpp"
+#include "device.hpp"
+#include <stdio.h>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <algorithm>
+
+static cl_device_id QueueDevice(cl_command_queue queue) {
+  cl_device_id device = NULL;
+  clGetCommandQueueInfo(queue, CL_QUEUE_DEVICE, sizeof(cl_device_id), &device, NULL);
+  return device;
+}
+
+//stands in when the tuner has no profiler
+static Profiler noProfiler;
+
+Autotuner::~Autotuner() {
+  for (std::map<cl_program, std::string>::iterator it = programs.begin(); it != programs.end(); ++it)
+    clReleaseProgram(it->first);
+}
+
+static size_t Bucket(size_t n) {
+  size_t b = 1;
+  while (b < n)
+    b <<= 1;
+  return b;
+}
+
+//64-bit FNV-1a of the kernel's program binary for the device and its
+//build options: kernels of the same name from different sources
+//(fused_expression, -D variants) get entries of their own. The binary
+//rather than the source, which programs loaded from the binary cache
+//do not have. Computed once per program, which stays retained.
+std::string Autotuner::ProgramIdentity(cl_device_id device, cl_kernel kernel) {
+  cl_program program = NULL;
+  clGetKernelInfo(kernel, CL_KERNEL_PROGRAM, sizeof(cl_program), &program, NULL);
+  std::lock_guard<std::mutex> guard(mutex);
+  std::map<cl_program, std::string>::iterator it = programs.find(program);
+  if (it != programs.end())
+    return it->second;
+
+  std::string options;
+  size_t size = 0;
+  clGetProgramBuildInfo(program, device, CL_PROGRAM_BUILD_OPTIONS, 0, NULL, &size);
+  if (size > 0) {
+    std::vector<char> text(size);
+    clGetProgramBuildInfo(program, device, CL_PROGRAM_BUILD_OPTIONS, size, &text[0], NULL);
+    options.assign(&text[0]);
+  }
+  //CL_PROGRAM_BINARIES fills only the entries of the devices asked for
+  cl_uint numDevices = 0;
+  clGetProgramInfo(program, CL_PROGRAM_NUM_DEVICES, sizeof(cl_uint), &numDevices, NULL);
+  std::vector<cl_device_id> devices(numDevices);
+  std::vector<size_t> sizes(numDevices);
+  std::vector<unsigned char> binary;
+  std::vector<unsigned char *> binaries(numDevices, (unsigned char *) NULL);
+  if (numDevices > 0) {
+    clGetProgramInfo(program, CL_PROGRAM_DEVICES, sizeof(cl_device_id) * numDevices, &devices[0], NULL);
+    clGetProgramInfo(program, CL_PROGRAM_BINARY_SIZES, sizeof(size_t) * numDevices, &sizes[0], NULL);
+    for (cl_uint d = 0; d < numDevices; d++) {
+      if (devices[d] == device && sizes[d] > 0) {
+        binary.resize(sizes[d]);
+        binaries[d] = &binary[0];
+        clGetProgramInfo(program, CL_PROGRAM_BINARIES, sizeof(unsigned char *) * numDevices, &binaries[0], NULL);
+        break;
+      }
+    }
+  }
+
+  unsigned long long hash = 14695981039346656037ULL;
+  for (size_t i = 0; i < options.size(); i++) {
+    hash ^= (unsigned char) options[i];
+    hash *= 1099511628211ULL;
+  }
+  for (size_t i = 0; i < binary.size(); i++) {
+    hash ^= binary[i];
+    hash *= 1099511628211ULL;
+  }
+  char identity[17];
+  sprintf(identity, "%016llx", hash);
+  clRetainProgram(program);
+  programs[program] = identity;
+  return identity;
+}
+
+std::string Autotuner::Key(cl_device_id device, cl_kernel kernel, cl_uint dims, const size_t *global) {
+  char function[256] = { 0 };
+  clGetKernelInfo(kernel, CL_KERNEL_FUNCTION_NAME, sizeof(function) - 1, function, NULL);
+  std::ostringstream key;
+  key << Device::GetDeviceString(device, CL_DEVICE_NAME) << "|"
+      << Device::GetDeviceString(device, CL_DRIVER_VERSION) << "|" << function << "|"
+      << ProgramIdentity(device, kernel) << "|";
+  for (cl_uint d = 0; d < dims; d++)
+    key << (d ? "x" : "") << Bucket(global[d]);
+  return key.str();
+}
+
+//Power-of-two sizes per dimension within the device and kernel limits,
+//dividing the global size, product a multiple of the preferred multiple
+//when any such size exists
+void Autotuner::Candidates(cl_device_id device, cl_kernel kernel, cl_uint dims,
+    const size_t *global, std::vector<LocalSize> &candidates) {
+  candidates.clear();
+  //reqd_work_group_size: the compiled size is the only valid one, not even NULL
+  size_t compiled[3] = { 0, 0, 0 };
+  clGetKernelWorkGroupInfo(kernel, device, CL_KERNEL_COMPILE_WORK_GROUP_SIZE, sizeof(compiled), compiled, NULL);
+  if (compiled[0] != 0 && dims >= 1 && dims <= 3) {
+    LocalSize ls;
+    ls.dims = dims;
+    for (cl_uint d = 0; d < dims; d++)
+      ls.size[d] = compiled[d];
+    candidates.push_back(ls);
+    return;
+  }
+  candidates.push_back(LocalSize());
+
+  size_t kernelMax = 0, multiple = 1, maxItems[3] = { 1, 1, 1 };
+  cl_ulong localUsed = 0, localAvailable = 0;
+  clGetKernelWorkGroupInfo(kernel, device, CL_KERNEL_WORK_GROUP_SIZE, sizeof(size_t), &kernelMax, NULL);
+  clGetKernelWorkGroupInfo(kernel, device, CL_KERNEL_PREFERRED_WORK_GROUP_SIZE_MULTIPLE,
+      sizeof(size_t), &multiple, NULL);
+  clGetKernelWorkGroupInfo(kernel, device, CL_KERNEL_LOCAL_MEM_SIZE, sizeof(cl_ulong), &localUsed, NULL);
+  clGetDeviceInfo(device, CL_DEVICE_LOCAL_MEM_SIZE, sizeof(cl_ulong), &localAvailable, NULL);
+  clGetDeviceInfo(device, CL_DEVICE_MAX_WORK_ITEM_SIZES, sizeof(maxItems), maxItems, NULL);
+  if (multiple == 0)
+    multiple = 1;
+  //a kernel already over the local memory budget only runs, if at all, as the driver decides
+  if (kernelMax == 0 || dims == 0 || dims > 3 || (localAvailable > 0 && localUsed > localAvailable))
+    return;
+
+  std::vector<LocalSize> all;
+  LocalSize ls;
+  ls.dims = dims;
+  //odometer over the power-of-two sizes of every dimension
+  for (;;) {
+    size_t product = 1;
+    bool fits = true;
+    for (cl_uint d = 0; d < dims; d++) {
+      product *= ls.size[d];
+      fits = fits && ls.size[d] <= maxItems[d] && global[d] % ls.size[d] == 0;
+    }
+    if (fits && product <= kernelMax)
+      all.push_back(ls);
+    cl_uint d = 0;
+    while (d < dims) {
+      ls.size[d] <<= 1;
+      if (ls.size[d] <= std::min(maxItems[d], kernelMax))
+        break;
+      ls.size[d] = 1;
+      d++;
+    }
+    if (d == dims)
+      break;
+  }
+
+  bool anyMultiple = false;
+  for (size_t i = 0; i < all.size(); i++) {
+    size_t product = all[i].size[0] * all[i].size[1] * all[i].size[2];
+    anyMultiple = anyMultiple || product % multiple == 0;
+  }
+  for (size_t i = 0; i < all.size(); i++) {
+    size_t product = all[i].size[0] * all[i].size[1] * all[i].size[2];
+    if (!anyMultiple || product % multiple == 0)
+      candidates.push_back(all[i]);
+  }
+}
+
+static void Print(std::ostream &os, const LocalSize &ls) {
+  if (ls.dims == 0) {
+    os << "NULL";
+    return;
+  }
+  for (cl_uint d = 0; d < ls.dims; d++)
+    os << (d ? "x" : "") << ls.size[d];
+}
+
+cl_int Autotuner::Tune(cl_command_queue queue, cl_kernel kernel, cl_uint dims, const size_t *global,
+    LocalSize &best) {
+  cl_device_id device = QueueDevice(queue);
+  std::string key = Key(device, kernel, dims, global);
+  HostSpan span(profiler ? *profiler : noProfiler, "Autotune " + key);
+  std::vector<LocalSize> candidates;
+  Candidates(device, kernel, dims, global, candidates);
+
+  best = LocalSize();
+  double bestMs = -1;
+  cl_int firstErr = CL_SUCCESS;
+  for (size_t c = 0; c < candidates.size(); c++) {
+    const LocalSize &ls = candidates[c];
+    std::vector<double> times;
+    //one untimed run first: caches, lazy allocations
+    for (int r = 0; r <= runs; r++) {
+      cl_event event = NULL;
+      cl_int err = clEnqueueNDRangeKernel(queue, kernel, dims, NULL, global, ls.Get(), 0, NULL, &event);
+      if (err != CL_SUCCESS) {
+        if (firstErr == CL_SUCCESS)
+          firstErr = err;
+        break;
+      }
+      clWaitForEvents(1, &event);
+      cl_ulong start = 0, end = 0;
+      clGetEventProfilingInfo(event, CL_PROFILING_COMMAND_START, sizeof(cl_ulong), &start, NULL);
+      clGetEventProfilingInfo(event, CL_PROFILING_COMMAND_END, sizeof(cl_ulong), &end, NULL);
+      clReleaseEvent(event);
+      if (r > 0)
+        times.push_back((end - start) / 1e6);
+    }
+    if (times.empty())
+      continue;
+    std::sort(times.begin(), times.end());
+    double median = times[times.size() / 2];
+    if (bestMs < 0 || median < bestMs) {
+      bestMs = median;
+      best = ls;
+    }
+  }
+
+  //nothing measured: keep the key untuned so a later launch tries again
+  if (bestMs < 0) {
+    if (firstErr == CL_SUCCESS)
+      firstErr = CL_INVALID_WORK_GROUP_SIZE;
+    std::cout << "Err: Autotuner: " << key << ", no candidate ran (" << firstErr << ")" << std::endl;
+    return firstErr;
+  }
+  std::cout << "Autotuner: " << key << " -> ";
+  Print(std::cout, best);
+  std::cout << " (" << bestMs << " ms, " << candidates.size() << " candidates)" << std::endl;
+
+  std::lock_guard<std::mutex> guard(mutex);
+  Load();
+  db[key] = best;
+  Save();
+  return CL_SUCCESS;
+}
+
+bool Autotuner::Lookup(cl_command_queue queue, cl_kernel kernel, cl_uint dims, const size_t *global,
+    LocalSize &local) {
+  std::string key = Key(QueueDevice(queue), kernel, dims, global);
+  std::lock_guard<std::mutex> guard(mutex);
+  Load();
+  std::map<std::string, LocalSize>::iterator it = db.find(key);
+  if (it == db.end())
+    return false;
+  local = it->second;
+  //an entry of the same bucket may not divide this exact size
+  for (cl_uint d = 0; d < local.dims; d++) {
+    if (d >= dims || global[d] % local.size[d] != 0) {
+      local = LocalSize();
+      break;
+    }
+  }
+  return true;
+}
+
+cl_int Autotuner::Launch(cl_command_queue queue, cl_kernel kernel, cl_uint dims, const size_t *global,
+    cl_uint numWait, const cl_event *wait, cl_event *event) {
+  LocalSize local;
+  if (!Lookup(queue, kernel, dims, global, local) && autoTune) {
+    cl_int err = Tune(queue, kernel, dims, global, local);
+    if (err != CL_SUCCESS)
+      return err;
+  }
+  ProfileEvent pe(profiler ? *profiler : noProfiler, kernel, event);
+  return clEnqueueNDRangeKernel(queue, kernel, dims, NULL, global, local.Get(), numWait, wait, pe.Out());
+}
+
+//tuning.txt: one "key<TAB>dims x y z" line per entry
+void Autotuner::Load() {
+  if (loaded)
+    return;
+  loaded = true;
+  std::ifstream file((dbPath + "tuning.txt").c_str());
+  std::string line;
+  while (std::getline(file, line)) {
+    size_t tab = line.rfind('\t');
+    if (tab == std::string::npos)
+      continue;
+    LocalSize ls;
+    std::istringstream fields(line.substr(tab + 1));
+    fields >> ls.dims >> ls.size[0] >> ls.size[1] >> ls.size[2];
+    if (fields && ls.dims <= 3)
+      db[line.substr(0, tab)] = ls;
+  }
+}
+
+bool Autotuner::Save() {
+  ProgramCache::MakeDirectory(dbPath);
+  std::string fileName = dbPath + "tuning.txt";
+  std::string tmpName = fileName + ".tmp";
+  std::ofstream file(tmpName.c_str());
+  if (!file.is_open()) {
+    std::cout << "Autotuner: cannot write " << tmpName << std::endl;
+    return false;
+  }
+  std::map<std::string, LocalSize>::iterator it;
+  for (it = db.begin(); it != db.end(); it++) {
+    file << it->first << "\t" << it->second.dims << " " << it->second.size[0] << " "
+        << it->second.size[1] << " " << it->second.size[2] << "\n";
+  }
+  file.close();
+  remove(fileName.c_str());
+  return rename(tmpName.c_str(), fileName.c_str()) == 0;
+}
@@ -0,0 +1,63 @@
+#ifndef AUTOTUNER_HPP
+#define AUTOTUNER_HPP
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <CL/cl.h>
+
+class Profiler;
+
+//A local work size; dims 0 stands for NULL (the driver chooses)
+struct LocalSize {
+  LocalSize() : dims(0) { size[0] = size[1] = size[2] = 1; }
+  cl_uint dims;
+  size_t size[3];
+  const size_t *Get() const { return dims == 0 ? NULL : size; }
+};
+
+//Picks local work sizes by timing them. Candidates are pruned with the
+//kernel's work-group limit and preferred multiple, its local memory
+//use and the device's per-dimension limits, and must divide the global
+//size; NULL is always one of them. A kernel compiled with
+//reqd_work_group_size has that size as its only candidate. Results go
+//to an on-disk database keyed by device, driver, kernel, its program
+//(binary and build options) and the power-of-two bucket of each global
+//dimension, so later launches find them without timing.
+//Tuning runs the kernel with the arguments already set on it several
+//times, so the kernel must tolerate being rerun.
+class Autotuner {
+  public:
+    Autotuner() : dbPath("./kernelTune/"), autoTune(true), runs(5), profiler(NULL), loaded(false) {}
+    ~Autotuner();
+
+    std::string dbPath;   //directory of tuning.txt
+    bool autoTune;        //Launch tunes sizes it has not seen yet
+    int runs;             //timed runs per candidate
+    Profiler *profiler;   //records the launches, NULL for none
+
+    //Enqueue with the tuned local size of this (device, kernel, global)
+    cl_int Launch(cl_command_queue queue, cl_kernel kernel, cl_uint dims, const size_t *global,
+        cl_uint numWait = 0, const cl_event *wait = NULL, cl_event *event = NULL);
+    //Time the candidates and store the fastest. When none of them runs,
+    //the database is left alone and the first enqueue error is returned.
+    cl_int Tune(cl_command_queue queue, cl_kernel kernel, cl_uint dims, const size_t *global,
+        LocalSize &best);
+    bool Lookup(cl_command_queue queue, cl_kernel kernel, cl_uint dims, const size_t *global,
+        LocalSize &local);
+    void Candidates(cl_device_id device, cl_kernel kernel, cl_uint dims, const size_t *global,
+        std::vector<LocalSize> &candidates);
+
+  private:
+    std::string Key(cl_device_id device, cl_kernel kernel, cl_uint dims, const size_t *global);
+    std::string ProgramIdentity(cl_device_id device, cl_kernel kernel);
+    void Load();
+    bool Save();
+
+    std::map<std::string, LocalSize> db;
+    std::map<cl_program, std::string> programs;  //ProgramIdentity, programs retained
+    bool loaded;
+    std::mutex mutex;
+};
+
+#endif //AUTOTUNER_HPP
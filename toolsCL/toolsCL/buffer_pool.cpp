@@ -0,0 +1,187 @@
+#include "buffer_pool.hpp"
+#include <iostream>
+
+BufferLease::BufferLease(BufferLease &&other)
+    : pool(other.pool), mem(other.mem), size(other.size), capacity(other.capacity),
+      flags(other.flags) {
+  other.pool = NULL;
+  other.mem = NULL;
+}
+
+BufferLease &BufferLease::operator=(BufferLease &&other) {
+  if (this != &other) {
+    Release();
+    pool = other.pool;
+    mem = other.mem;
+    size = other.size;
+    capacity = other.capacity;
+    flags = other.flags;
+    other.pool = NULL;
+    other.mem = NULL;
+  }
+  return *this;
+}
+
+void BufferLease::Release() {
+  if (mem != NULL) {
+    if (pool != NULL)
+      pool->Return(mem, capacity, flags);
+    else
+      clReleaseMemObject(mem);
+  }
+  pool = NULL;
+  mem = NULL;
+}
+
+size_t BufferPool::SizeClass(size_t size, size_t minClass, size_t maxClass) {
+  size_t c = minClass > 0 ? minClass : 1;
+  while (c < size) {
+    if (c > ((size_t) -1 >> 1))
+      return size;
+    c <<= 1;
+  }
+  return (maxClass > 0 && c > maxClass) ? size : c;
+}
+
+void BufferPool::SetContext(cl_context ctx) {
+  if (ctx != context)
+    Clear();
+  //the smallest allocation limit of the context's devices
+  cl_ulong limit = 0;
+  cl_uint numDevices = 0;
+  if (ctx != NULL)
+    clGetContextInfo(ctx, CL_CONTEXT_NUM_DEVICES, sizeof(cl_uint), &numDevices, NULL);
+  if (numDevices > 0) {
+    std::vector<cl_device_id> devices(numDevices);
+    clGetContextInfo(ctx, CL_CONTEXT_DEVICES, sizeof(cl_device_id) * numDevices, &devices[0], NULL);
+    for (cl_uint i = 0; i < numDevices; i++) {
+      cl_ulong maxAlloc = 0;
+      clGetDeviceInfo(devices[i], CL_DEVICE_MAX_MEM_ALLOC_SIZE, sizeof(cl_ulong), &maxAlloc, NULL);
+      if (maxAlloc > 0 && (limit == 0 || maxAlloc < limit))
+        limit = maxAlloc;
+    }
+  }
+  std::lock_guard<std::mutex> guard(mutex);
+  context = ctx;
+  maxClass = (size_t) limit;
+  lastTrim = Clock::now();
+}
+
+BufferLease BufferPool::Acquire(size_t size, cl_mem_flags flags) {
+  BufferLease lease;
+  if (flags & (CL_MEM_USE_HOST_PTR | CL_MEM_COPY_HOST_PTR)) {
+    std::cout << "Err: BufferPool cannot pool host pointer buffers" << std::endl;
+    return lease;
+  }
+  size_t capacity = SizeClass(size, minClass, maxClass);
+  if (capacity != SizeClass(size, minClass)) {
+    //past the largest class: the exact size, released with the lease
+    cl_int err = CL_SUCCESS;
+    lease.mem = clCreateBuffer(context, flags, size, NULL, &err);
+    if (lease.mem == NULL) {
+      std::cout << "Err: BufferPool failed to allocate " << size << " bytes ( Err = "
+          << err << " )" << std::endl;
+      return lease;
+    }
+    std::lock_guard<std::mutex> guard(mutex);
+    stats.requests++;
+    stats.allocations++;
+    lease.size = lease.capacity = size;
+    lease.flags = flags;
+    return lease;
+  }
+
+  std::unique_lock<std::mutex> guard(mutex);
+  Clock::time_point now = Clock::now();
+  if (std::chrono::duration<double, std::milli>(now - lastTrim).count() > idleMs)
+    TrimLocked(now);
+  stats.requests++;
+  std::vector<FreeBuffer> &list = freeLists[ClassKey(flags, capacity)];
+  if (!list.empty()) {
+    lease.mem = list.back().mem;
+    list.pop_back();
+    stats.hits++;
+    stats.bytesCached -= capacity;
+  } else {
+    cl_context ctx = context;
+    guard.unlock();
+    cl_int err = CL_SUCCESS;
+    lease.mem = clCreateBuffer(ctx, flags, capacity, NULL, &err);
+    guard.lock();
+    if (lease.mem == NULL) {
+      std::cout << "Err: BufferPool failed to allocate " << capacity << " bytes ( Err = "
+          << err << " )" << std::endl;
+      return lease;
+    }
+    stats.allocations++;
+  }
+  stats.bytesLive += capacity;
+  if (stats.bytesLive > stats.peakBytesLive)
+    stats.peakBytesLive = stats.bytesLive;
+
+  lease.pool = this;
+  lease.size = size;
+  lease.capacity = capacity;
+  lease.flags = flags;
+  return lease;
+}
+
+void BufferPool::Return(cl_mem mem, size_t capacity, cl_mem_flags flags) {
+  std::lock_guard<std::mutex> guard(mutex);
+  stats.bytesLive -= capacity;
+  FreeBuffer fb;
+  fb.mem = mem;
+  fb.since = Clock::now();
+  freeLists[ClassKey(flags, capacity)].push_back(fb);
+  stats.bytesCached += capacity;
+}
+
+void BufferPool::Trim() {
+  std::lock_guard<std::mutex> guard(mutex);
+  TrimLocked(Clock::now());
+}
+
+//Free lists are stacks, so the idle buffers are at the bottom
+void BufferPool::TrimLocked(Clock::time_point now) {
+  lastTrim = now;
+  std::map<ClassKey, std::vector<FreeBuffer> >::iterator it;
+  for (it = freeLists.begin(); it != freeLists.end(); it++) {
+    std::vector<FreeBuffer> &list = it->second;
+    size_t idle = 0;
+    while (idle < list.size()
+        && std::chrono::duration<double, std::milli>(now - list[idle].since).count() > idleMs) {
+      clReleaseMemObject(list[idle].mem);
+      stats.bytesCached -= it->first.second;
+      stats.trimmed++;
+      idle++;
+    }
+    list.erase(list.begin(), list.begin() + idle);
+  }
+}
+
+void BufferPool::Clear() {
+  std::lock_guard<std::mutex> guard(mutex);
+  std::map<ClassKey, std::vector<FreeBuffer> >::iterator it;
+  for (it = freeLists.begin(); it != freeLists.end(); it++) {
+    for (size_t i = 0; i < it->second.size(); i++)
+      clReleaseMemObject(it->second[i].mem);
+  }
+  freeLists.clear();
+  stats.bytesCached = 0;
+}
+
+BufferPoolStats BufferPool::Stats() {
+  std::lock_guard<std::mutex> guard(mutex);
+  return stats;
+}
+
+void BufferPool::DisplayStats() {
+  BufferPoolStats s = Stats();
+  std::cout << "Buffer pool  requests: " << s.requests
+      << "  hit rate: " << (s.requests > 0 ? 100.0 * s.hits / s.requests : 0) << " %"
+      << "  allocations: " << s.allocations
+      << "  trimmed: " << s.trimmed
+      << "  cached: " << s.bytesCached
+      << " B  live: " << s.bytesLive
+      << " B  peak live: " << s.peakBytesLive << " B" << std::endl;
+}
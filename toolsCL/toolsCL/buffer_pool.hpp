@@ -0,0 +1,97 @@
+#ifndef BUFFER_POOL_HPP
+#define BUFFER_POOL_HPP
+#include <map>
+#include <vector>
+#include <mutex>
+#include <chrono>
+#include <CL/cl.h>
+
+struct BufferPoolStats {
+  BufferPoolStats()
+      : requests(0), hits(0), allocations(0), trimmed(0), bytesCached(0), bytesLive(0),
+        peakBytesLive(0) {
+  }
+  unsigned int requests;     //Acquire calls
+  unsigned int hits;         //served from a free list
+  unsigned int allocations;  //clCreateBuffer calls
+  unsigned int trimmed;      //idle buffers released to the driver
+  size_t bytesCached;        //capacity sitting in the free lists
+  size_t bytesLive;          //capacity handed out in leases
+  size_t peakBytesLive;
+};
+
+class BufferPool;
+
+//A pooled cl_mem, handed back to its pool when the lease goes away.
+//Movable, not copyable. The buffer may be larger than requested (its
+//size class) and holds whatever the previous user left in it.
+class BufferLease {
+  public:
+    BufferLease() : pool(NULL), mem(NULL), size(0), capacity(0), flags(0) {}
+    BufferLease(BufferLease &&other);
+    BufferLease &operator=(BufferLease &&other);
+    ~BufferLease() { Release(); }
+
+    cl_mem Get() const { return mem; }
+    size_t Size() const { return size; }
+    size_t Capacity() const { return capacity; }
+    bool Valid() const { return mem != NULL; }
+    //Return the buffer to the pool now
+    void Release();
+
+  private:
+    friend class BufferPool;
+    BufferLease(const BufferLease &);
+    BufferLease &operator=(const BufferLease &);
+
+    BufferPool *pool;
+    cl_mem mem;
+    size_t size;
+    size_t capacity;
+    cl_mem_flags flags;
+};
+
+//cl_mem buffers of one context kept for reuse, in power-of-two size
+//classes with one free list per (flags, class). Buffers unused for
+//idleMs are released on the next Acquire or Trim. Thread-safe.
+class BufferPool {
+  public:
+    BufferPool() : idleMs(5000), minClass(256), maxClass(0), context(NULL) {}
+    ~BufferPool() { Clear(); }
+
+    double idleMs;      //release free buffers idle for longer than this
+    size_t minClass;    //smallest size class in bytes
+    size_t maxClass;    //largest, CL_DEVICE_MAX_MEM_ALLOC_SIZE from SetContext; 0 for no limit
+
+    void SetContext(cl_context ctx);
+    //flags may not contain CL_MEM_USE_HOST_PTR or CL_MEM_COPY_HOST_PTR
+    BufferLease Acquire(size_t size, cl_mem_flags flags = CL_MEM_READ_WRITE);
+    void Trim();
+    //Release every free buffer; leases still out are released on return
+    void Clear();
+    BufferPoolStats Stats();
+    void DisplayStats();
+    //Smallest power of two >= size, at least minClass. Sizes whose class
+    //would pass maxClass (or overflow) are their own, unpooled, class.
+    static size_t SizeClass(size_t size, size_t minClass, size_t maxClass = 0);
+
+  private:
+    friend class BufferLease;
+    typedef std::chrono::steady_clock Clock;
+    struct FreeBuffer {
+      cl_mem mem;
+      Clock::time_point since;
+    };
+    typedef std::pair<cl_mem_flags, size_t> ClassKey;
+
+    void Return(cl_mem mem, size_t capacity, cl_mem_flags flags);
+    void TrimLocked(Clock::time_point now);
+
+    cl_context context;
+    std::map<ClassKey, std::vector<FreeBuffer> > freeLists;
+    BufferPoolStats stats;
+    Clock::time_point lastTrim;
+    std::mutex mutex;
+};
+
+#endif //BUFFER_POOL_HPP
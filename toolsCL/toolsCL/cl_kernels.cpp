@@ -1,12 +1,589 @@
 // AUTOMATICALLY GENERATED FILE, DO NOT EDIT
 #include "cl_kernels.hpp"
-#include <sstream>
 #include <string>
-std::string header = "#ifndef __OPENCL_VERSION__\n#define __kernel\n#define __global\n#define __constant\n#define __local\n#define get_global_id(x) 0\n#define get_global_size(x) 0\n#define get_local_id(x) 0\n#define get_local_size(x) 0\n#define FLT_MAX 0\n#define FLT_MIN 0\n#define cl_khr_fp64\n#define cl_amd_fp64\n#define DOUBLE_SUPPORT_AVAILABLE\n#define CLK_LOCAL_MEM_FENCE\n#define Dtype float\n#define barrier(x)\n#define atomic_cmpxchg(x, y, z) x\n#endif\n\n#define CONCAT(A,B) A##_##B\n#define TEMPLATE(name,type) CONCAT(name,type)\n\n#define TYPE_FLOAT 1\n#define TYPE_DOUBLE 2\n\n#if defined(cl_khr_fp64)\n#pragma OPENCL EXTENSION cl_khr_fp64 : enable\n#define DOUBLE_SUPPORT_AVAILABLE\n#elif defined(cl_amd_fp64)\n#pragma OPENCL EXTENSION cl_amd_fp64 : enable\n#define DOUBLE_SUPPORT_AVAILABLE\n#endif\n\n#if defined(cl_khr_int64_base_atomics)\n#pragma OPENCL EXTENSION cl_khr_int64_base_atomics : enable\n#define ATOMICS_64_AVAILABLE\n#endif";  // NOLINT
-std::string mul2 = "\n__kernel void mul2(__global float* input, \n					__global float* output)\n{\n	unsigned int id = get_global_id(0);\n	output[id] = input[id] * 2;\n}";  // NOLINT
-void RegisterKernels(std::string &strSource) {
-  std::stringstream ss;
-  ss << header << "\n\n";  // NOLINT
-  ss << mul2 << "\n\n";  // NOLINT
-  strSource = ss.str();
+static constexpr char kernel_header_source[] =
+  "#ifndef __OPENCL_VERSION__\n"
+  "#define __kernel\n"
+  "#define __global\n"
+  "#define __constant\n"
+  "#define __local\n"
+  "#define get_global_id(x) 0\n"
+  "#define get_global_size(x) 0\n"
+  "#define get_local_id(x) 0\n"
+  "#define get_local_size(x) 0\n"
+  "#define FLT_MAX 0\n"
+  "#define FLT_MIN 0\n"
+  "#define cl_khr_fp64\n"
+  "#define cl_amd_fp64\n"
+  "#define DOUBLE_SUPPORT_AVAILABLE\n"
+  "#define CLK_LOCAL_MEM_FENCE\n"
+  "#define Dtype float\n"
+  "#define barrier(x)\n"
+  "#define atomic_cmpxchg(x, y, z) x\n"
+  "#endif\n"
+  "\n"
+  "#define CONCAT(A,B) A##_##B\n"
+  "#define TEMPLATE(name,type) CONCAT(name,type)\n"
+  "\n"
+  "// Templated kernel files are built once per element type, with Dtype\n"
+  "// and TYPE set to one of these (kernel_types.cpp):\n"
+  "//   __kernel void TEMPLATE(mul2,Dtype)(...)  ->  mul2_float, mul2_uchar, ...\n"
+  "#define TYPE_FLOAT 1\n"
+  "#define TYPE_DOUBLE 2\n"
+  "#define TYPE_INT 3\n"
+  "#define TYPE_SHORT 4\n"
+  "#define TYPE_UCHAR 5\n"
+  "\n"
+  "#if defined(cl_khr_fp64)\n"
+  "#pragma OPENCL EXTENSION cl_khr_fp64 : enable\n"
+  "#define DOUBLE_SUPPORT_AVAILABLE\n"
+  "#elif defined(cl_amd_fp64)\n"
+  "#pragma OPENCL EXTENSION cl_amd_fp64 : enable\n"
+  "#define DOUBLE_SUPPORT_AVAILABLE\n"
+  "#endif\n"
+  "\n"
+  "#if defined(cl_khr_int64_base_atomics)\n"
+  "#pragma OPENCL EXTENSION cl_khr_int64_base_atomics : enable\n"
+  "#define ATOMICS_64_AVAILABLE\n"
+  "#endif\n"
+  "\n\n"
+  "";  // NOLINT
+constexpr KernelSource kernelHeader = { "header", kernel_header_source, sizeof(kernel_header_source) - 1, nullptr, 0 };
+static constexpr char ImageFilter2D_source[] =
+  "\n"
+  "// Gaussian filter of image. Any image read_imagef accepts: RGBA8,\n"
+  "// CL_FLOAT, or CL_HALF_FLOAT for half the bytes (half_storage.hpp)\n"
+  "\n"
+  "__kernel void gaussian_filter(__read_only image2d_t srcImg,\n"
+  "                              __write_only image2d_t dstImg,\n"
+  "                              sampler_t sampler,\n"
+  "                              int width, int height)\n"
+  "{\n"
+  "    // Gaussian Kernel is:\n"
+  "    // 1  2  1\n"
+  "    // 2  4  2\n"
+  "    // 1  2  1\n"
+  "    float kernelWeights[9] = { 1.0f, 2.0f, 1.0f,\n"
+  "                               2.0f, 4.0f, 2.0f,\n"
+  "                               1.0f, 2.0f, 1.0f };\n"
+  "\n"
+  "    int2 startImageCoord = (int2) (get_global_id(0) - 1, get_global_id(1) - 1);\n"
+  "    int2 endImageCoord   = (int2) (get_global_id(0) + 1, get_global_id(1) + 1);\n"
+  "    int2 outImageCoord = (int2) (get_global_id(0), get_global_id(1));\n"
+  "\n"
+  "    if (outImageCoord.x < width && outImageCoord.y < height)\n"
+  "    {\n"
+  "        int weight = 0;\n"
+  "        float4 outColor = (float4)(0.0f, 0.0f, 0.0f, 0.0f);\n"
+  "        for( int y = startImageCoord.y; y <= endImageCoord.y; y++)\n"
+  "        {\n"
+  "            for( int x = startImageCoord.x; x <= endImageCoord.x; x++)\n"
+  "            {\n"
+  "				//read_imagef return vector [R,G,B,A]\n"
+  "                outColor += (read_imagef(srcImg, sampler, (int2)(x, y)) * (kernelWeights[weight] / 16.0f));\n"
+  "				//fprintf(\"%f\", outColor);\n"
+  "                weight += 1;\n"
+  "            }\n"
+  "        }\n"
+  "\n"
+  "        // Write the output value to image\n"
+  "        write_imagef(dstImg, outImageCoord, outColor);\n"
+  "    }\n"
+  "}\n"
+  "";  // NOLINT
+static constexpr const char *ImageFilter2D_kernels[] = { "gaussian_filter" };
+static constexpr char convolution_source[] =
+  "// 2D convolution of single-channel float images (row pitch == width),\n"
+  "// applied as a correlation with clamp-to-edge borders.\n"
+  "//\n"
+  "// The specialized kernels only exist when the file is built as a variant\n"
+  "// (Device::GetProgramVariant) with:\n"
+  "//   -DKW=<mask width> -DKH=<mask height>   odd sizes, the loops unroll fully\n"
+  "//   -DTILE_W=<w> -DTILE_H=<h>              work-group size\n"
+  "//   -DVARIANT=<suffix>                     e.g. 3x3, names convolve2d_3x3\n"
+  "//   -DSEPARABLE                            KW row taps, then KH column taps\n"
+  "// convolve_generic takes the mask size at run time, for comparison.\n"
+  "\n"
+  "#define CLAMPED(src, x, y, width, height) \\\n"
+  "    src[clamp((y), 0, (height) - 1) * (width) + clamp((x), 0, (width) - 1)]\n"
+  "\n"
+  "#ifdef KW\n"
+  "\n"
+  "#ifdef SEPARABLE\n"
+  "\n"
+  "// mask[0..KW-1]\n"
+  "__kernel __attribute__((reqd_work_group_size(TILE_W, TILE_H, 1)))\n"
+  "void TEMPLATE(convolve_rows,VARIANT)(__global const float *src, __global float *dst,\n"
+  "                                      __constant float *mask, int width, int height)\n"
+  "{\n"
+  "    __local float tile[TILE_H][TILE_W + KW - 1];\n"
+  "    int lx = get_local_id(0);\n"
+  "    int ly = get_local_id(1);\n"
+  "    int x0 = get_group_id(0) * TILE_W - KW / 2;\n"
+  "    int y = get_global_id(1);\n"
+  "    for (int i = lx; i < TILE_W + KW - 1; i += TILE_W)\n"
+  "        tile[ly][i] = CLAMPED(src, x0 + i, y, width, height);\n"
+  "    barrier(CLK_LOCAL_MEM_FENCE);\n"
+  "\n"
+  "    int x = get_global_id(0);\n"
+  "    if (x < width && y < height)\n"
+  "    {\n"
+  "        float sum = 0.0f;\n"
+  "#pragma unroll\n"
+  "        for (int k = 0; k < KW; k++)\n"
+  "            sum += tile[ly][lx + k] * mask[k];\n"
+  "        dst[y * width + x] = sum;\n"
+  "    }\n"
+  "}\n"
+  "\n"
+  "// mask[KW..KW+KH-1]\n"
+  "__kernel __attribute__((reqd_work_group_size(TILE_W, TILE_H, 1)))\n"
+  "void TEMPLATE(convolve_cols,VARIANT)(__global const float *src, __global float *dst,\n"
+  "                                      __constant float *mask, int width, int height)\n"
+  "{\n"
+  "    __local float tile[TILE_H + KH - 1][TILE_W];\n"
+  "    int lx = get_local_id(0);\n"
+  "    int ly = get_local_id(1);\n"
+  "    int x = get_global_id(0);\n"
+  "    int y0 = get_group_id(1) * TILE_H - KH / 2;\n"
+  "    for (int j = ly; j < TILE_H + KH - 1; j += TILE_H)\n"
+  "        tile[j][lx] = CLAMPED(src, x, y0 + j, width, height);\n"
+  "    barrier(CLK_LOCAL_MEM_FENCE);\n"
+  "\n"
+  "    int y = get_global_id(1);\n"
+  "    if (x < width && y < height)\n"
+  "    {\n"
+  "        float sum = 0.0f;\n"
+  "#pragma unroll\n"
+  "        for (int k = 0; k < KH; k++)\n"
+  "            sum += tile[ly + k][lx] * mask[KW + k];\n"
+  "        dst[y * width + x] = sum;\n"
+  "    }\n"
+  "}\n"
+  "\n"
+  "#else\n"
+  "\n"
+  "// mask: KH rows of KW\n"
+  "__kernel __attribute__((reqd_work_group_size(TILE_W, TILE_H, 1)))\n"
+  "void TEMPLATE(convolve2d,VARIANT)(__global const float *src, __global float *dst,\n"
+  "                                   __constant float *mask, int width, int height)\n"
+  "{\n"
+  "    __local float tile[TILE_H + KH - 1][TILE_W + KW - 1];\n"
+  "    int lx = get_local_id(0);\n"
+  "    int ly = get_local_id(1);\n"
+  "    int x0 = get_group_id(0) * TILE_W - KW / 2;\n"
+  "    int y0 = get_group_id(1) * TILE_H - KH / 2;\n"
+  "    for (int j = ly; j < TILE_H + KH - 1; j += TILE_H)\n"
+  "        for (int i = lx; i < TILE_W + KW - 1; i += TILE_W)\n"
+  "            tile[j][i] = CLAMPED(src, x0 + i, y0 + j, width, height);\n"
+  "    barrier(CLK_LOCAL_MEM_FENCE);\n"
+  "\n"
+  "    int x = get_global_id(0);\n"
+  "    int y = get_global_id(1);\n"
+  "    if (x < width && y < height)\n"
+  "    {\n"
+  "        float sum = 0.0f;\n"
+  "#pragma unroll\n"
+  "        for (int j = 0; j < KH; j++)\n"
+  "        {\n"
+  "#pragma unroll\n"
+  "            for (int i = 0; i < KW; i++)\n"
+  "                sum += tile[ly + j][lx + i] * mask[j * KW + i];\n"
+  "        }\n"
+  "        dst[y * width + x] = sum;\n"
+  "    }\n"
+  "}\n"
+  "\n"
+  "#endif // SEPARABLE\n"
+  "\n"
+  "#endif // KW\n"
+  "\n"
+  "__kernel void convolve_generic(__global const float *src, __global float *dst,\n"
+  "                               __constant float *mask, int kw, int kh,\n"
+  "                               int width, int height)\n"
+  "{\n"
+  "    int x = get_global_id(0);\n"
+  "    int y = get_global_id(1);\n"
+  "    if (x >= width || y >= height)\n"
+  "        return;\n"
+  "    float sum = 0.0f;\n"
+  "    for (int j = 0; j < kh; j++)\n"
+  "        for (int i = 0; i < kw; i++)\n"
+  "            sum += CLAMPED(src, x + i - kw / 2, y + j - kh / 2, width, height) * mask[j * kw + i];\n"
+  "    dst[y * width + x] = sum;\n"
+  "}\n"
+  "";  // NOLINT
+static constexpr const char *convolution_kernels[] = { "convolve_generic" };
+static constexpr char elementwise_source[] =
+  "// Elementwise kernels for any length: a grid-stride loop over W-wide\n"
+  "// vectors (vloadW/vstoreW), then a grid-stride loop over the n % W tail.\n"
+  "// The grid is sized to the device, not to n. Built per element type,\n"
+  "// with widths 1, 4 and 8. Host side: elementwise.hpp.\n"
+  "\n"
+  "#ifndef GRID_STRIDE\n"
+  "#define GRID_STRIDE(i, count) \\\n"
+  "    for (uint i = get_global_id(0); i < (count); i += get_global_size(0))\n"
+  "#define GRID_TAIL(i, W, n) \\\n"
+  "    for (uint i = (n) / (W) * (W) + get_global_id(0); i < (n); i += get_global_size(0))\n"
+  "#endif\n"
+  "\n"
+  "// out = in * alpha\n"
+  "\n"
+  "__kernel void TEMPLATE(scale_v1,Dtype)(__global const Dtype *in, __global Dtype *out,\n"
+  "                                       Dtype alpha, uint n)\n"
+  "{\n"
+  "    GRID_STRIDE(i, n)\n"
+  "        out[i] = in[i] * alpha;\n"
+  "}\n"
+  "\n"
+  "__kernel void TEMPLATE(scale_v4,Dtype)(__global const Dtype *in, __global Dtype *out,\n"
+  "                                       Dtype alpha, uint n)\n"
+  "{\n"
+  "    GRID_STRIDE(v, n / 4)\n"
+  "        vstore4(vload4(v, in) * alpha, v, out);\n"
+  "    GRID_TAIL(i, 4, n)\n"
+  "        out[i] = in[i] * alpha;\n"
+  "}\n"
+  "\n"
+  "__kernel void TEMPLATE(scale_v8,Dtype)(__global const Dtype *in, __global Dtype *out,\n"
+  "                                       Dtype alpha, uint n)\n"
+  "{\n"
+  "    GRID_STRIDE(v, n / 8)\n"
+  "        vstore8(vload8(v, in) * alpha, v, out);\n"
+  "    GRID_TAIL(i, 8, n)\n"
+  "        out[i] = in[i] * alpha;\n"
+  "}\n"
+  "\n"
+  "// out = a + b\n"
+  "\n"
+  "__kernel void TEMPLATE(add_v1,Dtype)(__global const Dtype *a, __global const Dtype *b,\n"
+  "                                     __global Dtype *out, uint n)\n"
+  "{\n"
+  "    GRID_STRIDE(i, n)\n"
+  "        out[i] = a[i] + b[i];\n"
+  "}\n"
+  "\n"
+  "__kernel void TEMPLATE(add_v4,Dtype)(__global const Dtype *a, __global const Dtype *b,\n"
+  "                                     __global Dtype *out, uint n)\n"
+  "{\n"
+  "    GRID_STRIDE(v, n / 4)\n"
+  "        vstore4(vload4(v, a) + vload4(v, b), v, out);\n"
+  "    GRID_TAIL(i, 4, n)\n"
+  "        out[i] = a[i] + b[i];\n"
+  "}\n"
+  "\n"
+  "__kernel void TEMPLATE(add_v8,Dtype)(__global const Dtype *a, __global const Dtype *b,\n"
+  "                                     __global Dtype *out, uint n)\n"
+  "{\n"
+  "    GRID_STRIDE(v, n / 8)\n"
+  "        vstore8(vload8(v, a) + vload8(v, b), v, out);\n"
+  "    GRID_TAIL(i, 8, n)\n"
+  "        out[i] = a[i] + b[i];\n"
+  "}\n"
+  "\n"
+  "// y = alpha * x + y\n"
+  "\n"
+  "__kernel void TEMPLATE(axpy_v1,Dtype)(Dtype alpha, __global const Dtype *x, __global Dtype *y,\n"
+  "                                      uint n)\n"
+  "{\n"
+  "    GRID_STRIDE(i, n)\n"
+  "        y[i] = alpha * x[i] + y[i];\n"
+  "}\n"
+  "\n"
+  "__kernel void TEMPLATE(axpy_v4,Dtype)(Dtype alpha, __global const Dtype *x, __global Dtype *y,\n"
+  "                                      uint n)\n"
+  "{\n"
+  "    GRID_STRIDE(v, n / 4)\n"
+  "        vstore4(alpha * vload4(v, x) + vload4(v, y), v, y);\n"
+  "    GRID_TAIL(i, 4, n)\n"
+  "        y[i] = alpha * x[i] + y[i];\n"
+  "}\n"
+  "\n"
+  "__kernel void TEMPLATE(axpy_v8,Dtype)(Dtype alpha, __global const Dtype *x, __global Dtype *y,\n"
+  "                                      uint n)\n"
+  "{\n"
+  "    GRID_STRIDE(v, n / 8)\n"
+  "        vstore8(alpha * vload8(v, x) + vload8(v, y), v, y);\n"
+  "    GRID_TAIL(i, 8, n)\n"
+  "        y[i] = alpha * x[i] + y[i];\n"
+  "}\n"
+  "";  // NOLINT
+static constexpr const char *elementwise_kernels[] = { "scale_v1_float", "scale_v1_double", "scale_v1_int", "scale_v1_short", "scale_v1_uchar", "scale_v4_float", "scale_v4_double", "scale_v4_int", "scale_v4_short", "scale_v4_uchar", "scale_v8_float", "scale_v8_double", "scale_v8_int", "scale_v8_short", "scale_v8_uchar", "add_v1_float", "add_v1_double", "add_v1_int", "add_v1_short", "add_v1_uchar", "add_v4_float", "add_v4_double", "add_v4_int", "add_v4_short", "add_v4_uchar", "add_v8_float", "add_v8_double", "add_v8_int", "add_v8_short", "add_v8_uchar", "axpy_v1_float", "axpy_v1_double", "axpy_v1_int", "axpy_v1_short", "axpy_v1_uchar", "axpy_v4_float", "axpy_v4_double", "axpy_v4_int", "axpy_v4_short", "axpy_v4_uchar", "axpy_v8_float", "axpy_v8_double", "axpy_v8_int", "axpy_v8_short", "axpy_v8_uchar" };
+static constexpr char gaussian_separable_source[] =
+  "// Separable Gaussian filter of image: gaussian_rows then gaussian_cols.\n"
+  "// Each work-group stages its tile plus a radius-wide halo in __local\n"
+  "// memory, so every source pixel is read once per group instead of once\n"
+  "// per tap, and the 2*radius+1 normalized weights come from __constant.\n"
+  "\n"
+  "__constant sampler_t clampSampler = CLK_NORMALIZED_COORDS_FALSE |\n"
+  "                                    CLK_ADDRESS_CLAMP_TO_EDGE |\n"
+  "                                    CLK_FILTER_NEAREST;\n"
+  "\n"
+  "// tile: (local width + 2 * radius) * local height float4\n"
+  "__kernel void gaussian_rows(__read_only image2d_t srcImg,\n"
+  "                            __write_only image2d_t dstImg,\n"
+  "                            __constant float *weights, int radius,\n"
+  "                            int width, int height,\n"
+  "                            __local float4 *tile)\n"
+  "{\n"
+  "    int lx = get_local_id(0);\n"
+  "    int lw = get_local_size(0);\n"
+  "    int tileW = lw + 2 * radius;\n"
+  "    int x0 = get_group_id(0) * lw - radius;\n"
+  "    int y = get_global_id(1);\n"
+  "    __local float4 *row = tile + get_local_id(1) * tileW;\n"
+  "\n"
+  "    // the halo is read clamped, so the border repeats the edge pixel\n"
+  "    for (int i = lx; i < tileW; i += lw)\n"
+  "        row[i] = read_imagef(srcImg, clampSampler, (int2)(x0 + i, y));\n"
+  "    barrier(CLK_LOCAL_MEM_FENCE);\n"
+  "\n"
+  "    int x = get_global_id(0);\n"
+  "    if (x < width && y < height)\n"
+  "    {\n"
+  "        float4 sum = (float4)(0.0f, 0.0f, 0.0f, 0.0f);\n"
+  "        for (int k = 0; k <= 2 * radius; k++)\n"
+  "            sum += row[lx + k] * weights[k];\n"
+  "        write_imagef(dstImg, (int2)(x, y), sum);\n"
+  "    }\n"
+  "}\n"
+  "\n"
+  "// tile: local width * (local height + 2 * radius) float4\n"
+  "__kernel void gaussian_cols(__read_only image2d_t srcImg,\n"
+  "                            __write_only image2d_t dstImg,\n"
+  "                            __constant float *weights, int radius,\n"
+  "                            int width, int height,\n"
+  "                            __local float4 *tile)\n"
+  "{\n"
+  "    int lx = get_local_id(0);\n"
+  "    int ly = get_local_id(1);\n"
+  "    int lw = get_local_size(0);\n"
+  "    int lh = get_local_size(1);\n"
+  "    int tileH = lh + 2 * radius;\n"
+  "    int x = get_global_id(0);\n"
+  "    int y0 = get_group_id(1) * lh - radius;\n"
+  "\n"
+  "    for (int i = ly; i < tileH; i += lh)\n"
+  "        tile[i * lw + lx] = read_imagef(srcImg, clampSampler, (int2)(x, y0 + i));\n"
+  "    barrier(CLK_LOCAL_MEM_FENCE);\n"
+  "\n"
+  "    int y = get_global_id(1);\n"
+  "    if (x < width && y < height)\n"
+  "    {\n"
+  "        float4 sum = (float4)(0.0f, 0.0f, 0.0f, 0.0f);\n"
+  "        for (int k = 0; k <= 2 * radius; k++)\n"
+  "            sum += tile[(ly + k) * lw + lx] * weights[k];\n"
+  "        write_imagef(dstImg, (int2)(x, y), sum);\n"
+  "    }\n"
+  "}\n"
+  "";  // NOLINT
+static constexpr const char *gaussian_separable_kernels[] = { "gaussian_rows", "gaussian_cols" };
+static constexpr char half_storage_source[] =
+  "// fp16 storage, fp32 arithmetic: vload_half/vstore_half are core OpenCL\n"
+  "// and need no cl_khr_fp16. Half the bytes of the float kernels for the\n"
+  "// bandwidth-bound ones. Host side: half_storage.hpp.\n"
+  "\n"
+  "__kernel void mul2_half(__global const half* input, \n"
+  "					__global half* output)\n"
+  "{\n"
+  "	unsigned int id = get_global_id(0);\n"
+  "	vstore_half_rte(vload_half(id, input) * 2.0f, id, output);\n"
+  "}\n"
+  "";  // NOLINT
+static constexpr const char *half_storage_kernels[] = { "mul2_half" };
+static constexpr char mul2_source[] =
+  "// Built per element type: mul2_float, mul2_double, mul2_int, mul2_short,\n"
+  "// mul2_uchar. Integer results wrap like their C counterparts.\n"
+  "__kernel void TEMPLATE(mul2,Dtype)(__global const Dtype* input, \n"
+  "					__global Dtype* output)\n"
+  "{\n"
+  "	unsigned int id = get_global_id(0);\n"
+  "	output[id] = input[id] * (Dtype)2;\n"
+  "}\n"
+  "";  // NOLINT
+static constexpr const char *mul2_kernels[] = { "mul2_float", "mul2_double", "mul2_int", "mul2_short", "mul2_uchar" };
+static constexpr char reduce_source[] =
+  "// Reductions of n elements to one value. Built by Reduction\n"
+  "// (reduction.hpp) through Device::GetProgramVariant, with a prelude that\n"
+  "// defines:\n"
+  "//   Dtype, Atype, Atype4, convert_Atype4  input and accumulator types\n"
+  "//   ATYPE_MIN, ATYPE_MAX                  limits of Atype\n"
+  "//   REDUCE_OP(a,b), REDUCE_IDENTITY       associative and commutative op\n"
+  "//   SUBGROUP_REDUCE                       sub_group_reduce_*, optional\n"
+  "//   ATOMIC_FINISH                         atomic_* into out[0], optional\n"
+  "// or, for argmin/argmax:\n"
+  "//   ARG_BETTER(a,b), ARG_WORST            order of the values, start value\n"
+  "// Every work-group folds its grid-stride share of the input, then its\n"
+  "// work-items through __local memory, into one partial; the partials are\n"
+  "// reduced by a further pass, or atomically into out[0].\n"
+  "\n"
+  "#ifdef REDUCE_OP\n"
+  "\n"
+  "// n elements of in into acc, four at a time, then the tail\n"
+  "#define ACCUMULATE(acc, in, n) \\\n"
+  "    for (uint v = get_global_id(0); v < (n) / 4; v += get_global_size(0)) { \\\n"
+  "        Atype4 x = convert_Atype4(vload4(v, in)); \\\n"
+  "        acc = REDUCE_OP(acc, REDUCE_OP(REDUCE_OP(x.s0, x.s1), REDUCE_OP(x.s2, x.s3))); \\\n"
+  "    } \\\n"
+  "    for (uint i = (n) / 4 * 4 + get_global_id(0); i < (n); i += get_global_size(0)) \\\n"
+  "        acc = REDUCE_OP(acc, (Atype) in[i]);\n"
+  "\n"
+  "// The values of the work-group folded into one\n"
+  "Atype reduce_group(Atype acc, __local Atype *scratch)\n"
+  "{\n"
+  "    uint lid = get_local_id(0);\n"
+  "#ifdef SUBGROUP_REDUCE\n"
+  "    acc = SUBGROUP_REDUCE(acc);\n"
+  "    if (get_sub_group_local_id() == 0)\n"
+  "        scratch[get_sub_group_id()] = acc;\n"
+  "    uint active = get_num_sub_groups();\n"
+  "#else\n"
+  "    scratch[lid] = acc;\n"
+  "    uint active = get_local_size(0);\n"
+  "#endif\n"
+  "    barrier(CLK_LOCAL_MEM_FENCE);\n"
+  "    // fold the upper part of the active values onto the lower, any count\n"
+  "    while (active > 1) {\n"
+  "        uint kept = (active + 1) / 2;\n"
+  "        if (lid < active - kept)\n"
+  "            scratch[lid] = REDUCE_OP(scratch[lid], scratch[lid + kept]);\n"
+  "        barrier(CLK_LOCAL_MEM_FENCE);\n"
+  "        active = kept;\n"
+  "    }\n"
+  "    return scratch[0];\n"
+  "}\n"
+  "\n"
+  "// scratch: local size Atype\n"
+  "__kernel void TEMPLATE(reduce_local,Atype)(__global const Dtype *in, uint n,\n"
+  "                                           __global Atype *out, __local Atype *scratch)\n"
+  "{\n"
+  "    Atype acc = REDUCE_IDENTITY;\n"
+  "    ACCUMULATE(acc, in, n)\n"
+  "    acc = reduce_group(acc, scratch);\n"
+  "    if (get_local_id(0) == 0) {\n"
+  "#ifdef ATOMIC_FINISH\n"
+  "        ATOMIC_FINISH(out, acc);\n"
+  "#else\n"
+  "        out[get_group_id(0)] = acc;\n"
+  "#endif\n"
+  "    }\n"
+  "}\n"
+  "\n"
+  "// The partials of a previous pass\n"
+  "__kernel void TEMPLATE(reduce_partials,Atype)(__global const Atype *in, uint n,\n"
+  "                                              __global Atype *out, __local Atype *scratch)\n"
+  "{\n"
+  "    Atype acc = REDUCE_IDENTITY;\n"
+  "    ACCUMULATE(acc, in, n)\n"
+  "    acc = reduce_group(acc, scratch);\n"
+  "    if (get_local_id(0) == 0)\n"
+  "        out[get_group_id(0)] = acc;\n"
+  "}\n"
+  "\n"
+  "#endif // REDUCE_OP\n"
+  "\n"
+  "#ifdef ARG_BETTER\n"
+  "\n"
+  "// (vb, ib) replaces (va, ia): a better value, or the same at a lower index\n"
+  "#define ARG_TAKE(va, ia, vb, ib) (ARG_BETTER(vb, va) || ((vb) == (va) && (ib) < (ia)))\n"
+  "\n"
+  "void argreduce_group(Atype *value, uint *index, __local Atype *values, __local uint *indices)\n"
+  "{\n"
+  "    uint lid = get_local_id(0);\n"
+  "    values[lid] = *value;\n"
+  "    indices[lid] = *index;\n"
+  "    barrier(CLK_LOCAL_MEM_FENCE);\n"
+  "    uint active = get_local_size(0);\n"
+  "    while (active > 1) {\n"
+  "        uint kept = (active + 1) / 2;\n"
+  "        if (lid < active - kept && ARG_TAKE(values[lid], indices[lid], values[lid + kept], indices[lid + kept])) {\n"
+  "            values[lid] = values[lid + kept];\n"
+  "            indices[lid] = indices[lid + kept];\n"
+  "        }\n"
+  "        barrier(CLK_LOCAL_MEM_FENCE);\n"
+  "        active = kept;\n"
+  "    }\n"
+  "    *value = values[0];\n"
+  "    *index = indices[0];\n"
+  "}\n"
+  "\n"
+  "// values, indices: local size each\n"
+  "__kernel void TEMPLATE(argreduce_local,Atype)(__global const Dtype *in, uint n,\n"
+  "                                              __global Atype *outValue, __global uint *outIndex,\n"
+  "                                              __local Atype *values, __local uint *indices)\n"
+  "{\n"
+  "    Atype value = ARG_WORST;\n"
+  "    uint index = UINT_MAX;\n"
+  "    for (uint i = get_global_id(0); i < n; i += get_global_size(0)) {\n"
+  "        Atype x = (Atype) in[i];\n"
+  "        if (ARG_TAKE(value, index, x, i)) {\n"
+  "            value = x;\n"
+  "            index = i;\n"
+  "        }\n"
+  "    }\n"
+  "    argreduce_group(&value, &index, values, indices);\n"
+  "    if (get_local_id(0) == 0) {\n"
+  "        outValue[get_group_id(0)] = value;\n"
+  "        outIndex[get_group_id(0)] = index;\n"
+  "    }\n"
+  "}\n"
+  "\n"
+  "// The value and index partials of a previous pass\n"
+  "__kernel void TEMPLATE(argreduce_partials,Atype)(__global const Atype *in, __global const uint *inIndex,\n"
+  "                                                 uint n, __global Atype *outValue, __global uint *outIndex,\n"
+  "                                                 __local Atype *values, __local uint *indices)\n"
+  "{\n"
+  "    Atype value = ARG_WORST;\n"
+  "    uint index = UINT_MAX;\n"
+  "    for (uint i = get_global_id(0); i < n; i += get_global_size(0)) {\n"
+  "        if (ARG_TAKE(value, index, in[i], inIndex[i])) {\n"
+  "            value = in[i];\n"
+  "            index = inIndex[i];\n"
+  "        }\n"
+  "    }\n"
+  "    argreduce_group(&value, &index, values, indices);\n"
+  "    if (get_local_id(0) == 0) {\n"
+  "        outValue[get_group_id(0)] = value;\n"
+  "        outIndex[get_group_id(0)] = index;\n"
+  "    }\n"
+  "}\n"
+  "\n"
+  "#endif // ARG_BETTER\n"
+  "";  // NOLINT
+constexpr KernelSource kernelSources[] = {
+  { "ImageFilter2D.cl", ImageFilter2D_source, sizeof(ImageFilter2D_source) - 1, ImageFilter2D_kernels, 1 },
+  { "convolution.cl", convolution_source, sizeof(convolution_source) - 1, convolution_kernels, 1 },
+  { "elementwise.cl", elementwise_source, sizeof(elementwise_source) - 1, elementwise_kernels, 45 },
+  { "gaussian_separable.cl", gaussian_separable_source, sizeof(gaussian_separable_source) - 1, gaussian_separable_kernels, 2 },
+  { "half_storage.cl", half_storage_source, sizeof(half_storage_source) - 1, half_storage_kernels, 1 },
+  { "mul2.cl", mul2_source, sizeof(mul2_source) - 1, mul2_kernels, 5 },
+  { "reduce.cl", reduce_source, sizeof(reduce_source) - 1, nullptr, 0 },
+  { nullptr, nullptr, 0, nullptr, 0 }
+};
+constexpr size_t numKernelSources = 7;
+const KernelSource *FindKernelSource(const std::string &file) {
+  for (size_t i = 0; i < numKernelSources; i++) {
+    if (file == kernelSources[i].file)
+      return &kernelSources[i];
+  }
+  return NULL;
+}
+const KernelSource *FindKernelOwner(const std::string &kernel) {
+  for (size_t i = 0; i < numKernelSources; i++) {
+    for (size_t k = 0; k < kernelSources[i].numKernels; k++) {
+      if (kernel == kernelSources[i].kernels[k])
+        return &kernelSources[i];
+    }
+  }
+  return NULL;
+}
+static const KernelBinary kernelBinaries[] = {
+  { NULL, NULL, NULL, NULL, 0 }
+};
+const KernelBinary *FindKernelBinary(const std::string &device, const std::string &driver, const std::string &file) {
+  for (const KernelBinary *b = kernelBinaries; b->data != NULL; b++) {
+    if (device == b->device && driver == b->driver && file == b->file)
+      return b;
+  }
+  return NULL;
 }
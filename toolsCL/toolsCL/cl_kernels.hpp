@@ -1,7 +1,31 @@
 // AUTOMATICALLY GENERATED FILE, DO NOT EDIT
 #ifndef CL_KERNELS_HPP_
 #define CL_KERNELS_HPP_
-#include <iostream>
 #include <string>
-void RegisterKernels(std::string &strSource);
+#include <stddef.h>
+
+// One embedded kernel file. The table is constant-initialized: no
+// static constructors and no copy until a file is actually built.
+struct KernelSource {
+  const char *file;            // e.g. "mul2.cl"
+  const char *source;
+  size_t length;
+  const char *const *kernels;  // __kernel names declared in the file
+  size_t numKernels;
+};
+extern const KernelSource kernelHeader;  // cl_headers, joined
+extern const KernelSource kernelSources[];
+extern const size_t numKernelSources;
+const KernelSource *FindKernelSource(const std::string &file);
+const KernelSource *FindKernelOwner(const std::string &kernel);
+
+// Kernel file compiled ahead of time for one device and driver
+struct KernelBinary {
+  const char *device;  // CL_DEVICE_NAME, or "spir" for portable SPIR
+  const char *driver;  // CL_DRIVER_VERSION, empty for SPIR
+  const char *file;
+  const unsigned char *data;
+  size_t size;
+};
+const KernelBinary *FindKernelBinary(const std::string &device, const std::string &driver, const std::string &file);
 #endif//#ifndef CL_KERNELS_HPP_
@@ -0,0 +1,140 @@
+#include "convolution.hpp"
+#include "device.hpp"
+#include "gaussian.hpp"
+#include <sstream>
+
+ConvolutionMask ConvolutionMask::Custom(int width, int height, const float *values) {
+  ConvolutionMask mask;
+  mask.width = width;
+  mask.height = height;
+  mask.values.assign(values, values + width * height);
+  return mask;
+}
+
+ConvolutionMask ConvolutionMask::Separable(const std::vector<float> &row, const std::vector<float> &col) {
+  ConvolutionMask mask;
+  mask.width = (int) row.size();
+  mask.height = (int) col.size();
+  mask.row = row;
+  mask.col = col;
+  for (size_t j = 0; j < col.size(); j++)
+    for (size_t i = 0; i < row.size(); i++)
+      mask.values.push_back(col[j] * row[i]);
+  return mask;
+}
+
+ConvolutionMask ConvolutionMask::Box(int radius) {
+  std::vector<float> taps(2 * radius + 1, 1.0f / (2 * radius + 1));
+  return Separable(taps, taps);
+}
+
+ConvolutionMask ConvolutionMask::Gaussian(int radius, float sigma) {
+  std::vector<float> taps;
+  SeparableGaussian::Weights(radius, sigma, taps);
+  return Separable(taps, taps);
+}
+
+ConvolutionMask ConvolutionMask::SobelX() {
+  const float derivative[] = { -1, 0, 1 }, smooth[] = { 1, 2, 1 };
+  return Separable(std::vector<float>(derivative, derivative + 3), std::vector<float>(smooth, smooth + 3));
+}
+
+ConvolutionMask ConvolutionMask::SobelY() {
+  const float derivative[] = { -1, 0, 1 }, smooth[] = { 1, 2, 1 };
+  return Separable(std::vector<float>(smooth, smooth + 3), std::vector<float>(derivative, derivative + 3));
+}
+
+ConvolutionMask ConvolutionMask::Laplacian() {
+  const float values[] = { 0, 1, 0, 1, -4, 1, 0, 1, 0 };
+  return Custom(3, 3, values);
+}
+
+static cl_mem ConstantBuffer(cl_context context, const std::vector<float> &data) {
+  cl_int err = CL_SUCCESS;
+  cl_mem mem = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+      sizeof(float) * data.size(), (void *) &data[0], &err);
+  OCL_CHECK(err, "Convolution: mask buffer");
+  return mem;
+}
+
+Convolution::Convolution(Device &device, const ConvolutionMask &mask, size_t tileWidth, size_t tileHeight)
+    : tileWidth(tileWidth), tileHeight(tileHeight), device(device), mask(mask), first(NULL), second(NULL),
+      taps(NULL), values(NULL) {
+  if (mask.width % 2 == 0 || mask.height % 2 == 0 || mask.values.empty()) {
+    std::cout << "Err: Convolution needs an odd mask size, got " << mask.width << "x" << mask.height
+        << std::endl;
+    return;
+  }
+  std::ostringstream variant, opts;
+  variant << mask.width << "x" << mask.height;
+  opts << "-DKW=" << mask.width << " -DKH=" << mask.height << " -DTILE_W=" << tileWidth
+      << " -DTILE_H=" << tileHeight << " -DVARIANT=" << variant.str();
+  if (mask.IsSeparable())
+    opts << " -DSEPARABLE";
+  options = opts.str();
+
+  cl_program program = device.GetProgramVariant("convolution.cl", options);
+  if (program == NULL)
+    return;
+  cl_int err = CL_SUCCESS;
+  if (mask.IsSeparable()) {
+    first = clCreateKernel(program, ("convolve_rows_" + variant.str()).c_str(), &err);
+    OCL_CHECK(err, "Convolution: convolve_rows");
+    second = clCreateKernel(program, ("convolve_cols_" + variant.str()).c_str(), &err);
+    OCL_CHECK(err, "Convolution: convolve_cols");
+    std::vector<float> rowCol(mask.row);
+    rowCol.insert(rowCol.end(), mask.col.begin(), mask.col.end());
+    taps = ConstantBuffer(device.Context, rowCol);
+  } else {
+    first = clCreateKernel(program, ("convolve2d_" + variant.str()).c_str(), &err);
+    OCL_CHECK(err, "Convolution: convolve2d");
+    taps = ConstantBuffer(device.Context, mask.values);
+  }
+  values = ConstantBuffer(device.Context, mask.values);
+}
+
+Convolution::~Convolution() {
+  if (first != NULL) {
+    ForgetKernelArgs(device.generation, first);
+    clReleaseKernel(first);
+  }
+  if (second != NULL) {
+    ForgetKernelArgs(device.generation, second);
+    clReleaseKernel(second);
+  }
+  if (taps != NULL)
+    clReleaseMemObject(taps);
+  if (values != NULL)
+    clReleaseMemObject(values);
+}
+
+cl_int Convolution::Run(cl_mem src, cl_mem dst, int width, int height) {
+  if (first == NULL || (mask.IsSeparable() && second == NULL))
+    return CL_INVALID_KERNEL;
+  size_t w = ((width + tileWidth - 1) / tileWidth) * tileWidth;
+  size_t h = ((height + tileHeight - 1) / tileHeight) * tileHeight;
+  NDRange range = NDRange(w, h).Local(tileWidth, tileHeight);
+  if (!mask.IsSeparable())
+    return device.Launch(first, range, src, dst, taps, (cl_int) width, (cl_int) height);
+
+  size_t bytes = sizeof(float) * width * height;
+  if (scratch.Size() != bytes)
+    scratch = device.Buffers.Acquire(bytes, CL_MEM_READ_WRITE);
+  cl_mem tmp = scratch.Get();
+  if (tmp == NULL)
+    return CL_MEM_OBJECT_ALLOCATION_FAILURE;
+  cl_int err = device.Launch(first, range, src, tmp, taps, (cl_int) width, (cl_int) height);
+  if (err != CL_SUCCESS)
+    return err;
+  return device.Launch(second, range, tmp, dst, taps, (cl_int) width, (cl_int) height);
+}
+
+cl_int Convolution::RunGeneric(cl_mem src, cl_mem dst, int width, int height) {
+  cl_kernel generic = device.GetKernel("convolve_generic");
+  if (generic == NULL || values == NULL)
+    return CL_INVALID_KERNEL;
+  size_t w = ((width + tileWidth - 1) / tileWidth) * tileWidth;
+  size_t h = ((height + tileHeight - 1) / tileHeight) * tileHeight;
+  return device.Launch(generic, NDRange(w, h).Local(tileWidth, tileHeight), src, dst, values,
+      (cl_int) mask.width, (cl_int) mask.height, (cl_int) width, (cl_int) height);
+}
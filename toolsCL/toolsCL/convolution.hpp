@@ -0,0 +1,66 @@
+#ifndef CONVOLUTION_HPP
+#define CONVOLUTION_HPP
+#include <string>
+#include <vector>
+#include <CL/cl.h>
+#include "buffer_pool.hpp"
+
+class Device;
+
+//Mask of a 2D convolution, odd sizes. Separable masks also keep their
+//row and column factors, which Convolution runs as two passes.
+struct ConvolutionMask {
+  ConvolutionMask() : width(0), height(0) {}
+  int width;
+  int height;
+  std::vector<float> values;  //height rows of width
+  std::vector<float> row;     //width taps, empty when not separable
+  std::vector<float> col;     //height taps
+
+  bool IsSeparable() const { return !row.empty(); }
+  static ConvolutionMask Custom(int width, int height, const float *values);
+  static ConvolutionMask Separable(const std::vector<float> &row, const std::vector<float> &col);
+  static ConvolutionMask Box(int radius);
+  static ConvolutionMask Gaussian(int radius, float sigma = 0);
+  static ConvolutionMask SobelX();
+  static ConvolutionMask SobelY();
+  static ConvolutionMask Laplacian();
+};
+
+//A convolution compiled for its mask: kernelGen/cl_kernels/convolution.cl
+//built with -D options for the mask size and separability, so the tap
+//loops unroll and the tile is sized at compile time. The program variant
+//is cached by the Device under its option string, so every Convolution
+//of the same shape shares one build. Images are float buffers of
+//width * height. Run from the thread that owns the Convolution.
+class Convolution {
+  public:
+    //tileWidth x tileHeight is the work-group size, compiled into the variant
+    Convolution(Device &device, const ConvolutionMask &mask, size_t tileWidth = 16, size_t tileHeight = 16);
+    ~Convolution();
+
+    cl_int Run(cl_mem src, cl_mem dst, int width, int height);
+    //The same mask through the runtime-sized convolve_generic
+    cl_int RunGeneric(cl_mem src, cl_mem dst, int width, int height);
+    const std::string &Options() const { return options; }
+    bool Valid() const { return first != NULL; }
+    size_t TileWidth() const { return tileWidth; }
+    size_t TileHeight() const { return tileHeight; }
+
+  private:
+    Convolution(const Convolution &);
+    Convolution &operator=(const Convolution &);
+
+    size_t tileWidth;   //fixed at construction, part of the variant
+    size_t tileHeight;
+    Device &device;
+    ConvolutionMask mask;
+    std::string options;
+    cl_kernel first;    //convolve2d, or convolve_rows of a separable mask
+    cl_kernel second;   //convolve_cols
+    cl_mem taps;        //mask values, or row then col taps
+    cl_mem values;      //full mask for convolve_generic
+    BufferLease scratch;
+};
+
+#endif //CONVOLUTION_HPP
@@ -4,107 +4,216 @@
 #include <iostream>
 #include <ostream>
 #include <malloc.h>
+#include <string.h>
+#include <ctype.h>
+#include <algorithm>
+#include <atomic>
 #include "dirent.h"
 #include "cl_kernels.hpp"
+#include "timer.hpp"
+#include "thread_pool.hpp"
 
 Device::~Device() {
   ReleaseKernels();
   free((void*) platformIDs);
   free (DeviceIDs);
-  clReleaseProgram (Program);
-  clReleaseCommandQueue (CommandQueue);
-  clReleaseCommandQueue (CommandQueue_helper);
-  clReleaseContext (Context);
+  for (size_t i = 0; i < Programs.size(); i++) {
+    if (Programs[i].program != NULL)
+      clReleaseProgram (Programs[i].program);
+  }
+  std::map<std::string, cl_program>::iterator variant;
+  for (variant = Variants.begin(); variant != Variants.end(); variant++)
+    clReleaseProgram (variant->second);
+  Cache.DisplayStats();
+  Buffers.DisplayStats();
+  Buffers.Clear();
+  Staging.Release();
+  if (Prof.enabled)
+    Prof.Report();
+  if (!tracePath.empty())
+    Prof.WriteTrace(tracePath);
+  for (size_t i = 1; i < Queues.size(); i++)
+    clReleaseCommandQueue (Queues[i]);
+  if (CommandQueue != NULL)
+    clReleaseCommandQueue (CommandQueue);
+  if (CommandQueue_helper != NULL)
+    clReleaseCommandQueue (CommandQueue_helper);
+  if (Context != NULL)
+    clReleaseContext (Context);
+#ifdef CL_VERSION_1_2
+  if (subDevices) {
+    for (cl_uint i = 0; i < numContextDevices; i++)
+      clReleaseDevice (pDevices[i]);
+  }
+#endif
+  free (pDevices);
   std::cout << "device destructor" << std::endl;
 }
 
+//Pick a device among all platforms: deviceId indexes Candidates, -1
+//lets the selection policy choose
 cl_int Device::Init(int deviceId) {
+  if (!PickDevice(deviceId))
+    return 0;
+  std::vector<cl_device_id> devices(1, Selected.device);
+  CreateContext(devices);
+  return 0;
+}
 
-  DisplayPlatformInfo();
+//One context over the picked device and every other device of its
+//platform, best ranked first. maxDevices 0 takes them all.
+cl_int Device::InitMulti(cl_uint maxDevices) {
+  if (!PickDevice(-1))
+    return 0;
+  std::vector<DeviceCandidate> same;
+  for (size_t i = 0; i < Candidates.size(); i++) {
+    if (Candidates[i].platform == Selected.platform && Candidates[i].device != Selected.device)
+      same.push_back(Candidates[i]);
+  }
+  std::stable_sort(same.begin(), same.end(),
+      [](const DeviceCandidate &a, const DeviceCandidate &b) { return a.score > b.score; });
 
-  clGetPlatformIDs(0, NULL, &numPlatforms);
-  cl_platform_id *PlatformIDs = new cl_platform_id[numPlatforms];
-  clGetPlatformIDs(numPlatforms, PlatformIDs, NULL);
+  std::vector<cl_device_id> devices(1, Selected.device);
+  for (size_t i = 0; i < same.size() && (maxDevices == 0 || devices.size() < maxDevices); i++)
+    devices.push_back(same[i].device);
+  CreateContext(devices);
+  return 0;
+}
 
-  size_t nameLen;
-  cl_int res = clGetPlatformInfo(PlatformIDs[0], CL_PLATFORM_NAME, 64,
-      platformName, &nameLen);
-  if (res != CL_SUCCESS) {
-    fprintf(stderr, "Err: Failed to Get Platform Info\n");
+//Split the picked device into parts sub-devices of equal compute units
+//and use them as separate devices (OpenCL 1.2, e.g. a CPU under POCL).
+//Built against older headers it uses the device whole, like Init.
+cl_int Device::InitSubDevices(cl_uint parts, int deviceId) {
+  if (!PickDevice(deviceId))
+    return 0;
+#ifndef CL_VERSION_1_2
+  std::cout << "Err: sub-devices need OpenCL 1.2 headers, using " << Selected.deviceName << " whole" << std::endl;
+  std::vector<cl_device_id> whole(1, Selected.device);
+  CreateContext(whole);
+  return 0;
+#else
+  cl_uint units = Selected.computeUnits / (parts > 0 ? parts : 1);
+  cl_device_partition_property props[] = { CL_DEVICE_PARTITION_EQUALLY,
+      (cl_device_partition_property) (units > 0 ? units : 1), 0 };
+  cl_uint count = 0;
+  cl_int err = clCreateSubDevices(Selected.device, props, 0, NULL, &count);
+  if (err != CL_SUCCESS || count == 0) {
+    std::cout << "Err: " << Selected.deviceName << " cannot be partitioned ( Err = "
+        << err << " ), using it whole" << std::endl;
+    std::vector<cl_device_id> devices(1, Selected.device);
+    CreateContext(devices);
     return 0;
   }
-  platformName[nameLen] = 0;
+  std::vector<cl_device_id> devices(count);
+  clCreateSubDevices(Selected.device, props, count, &devices[0], NULL);
+  //leftover compute units may form extra sub-devices
+  while (devices.size() > parts) {
+    clReleaseDevice(devices.back());
+    devices.pop_back();
+  }
+  subDevices = true;
+  std::cout << "Partitioned " << Selected.deviceName << " into " << devices.size()
+      << " sub-devices of " << units << " compute units" << std::endl;
+  CreateContext(devices);
+  return 0;
+#endif
+}
+
+bool Device::PickDevice(int deviceId) {
+  DisplayPlatformInfo();
+  if (numPlatforms == 0)
+    return false;
 
   GetDeviceInfo();
-  cl_uint uiNumDevices;
-  cl_bool unified_memory = false;
-  clGetDeviceIDs(PlatformIDs[0], CL_DEVICE_TYPE_ALL, 0, NULL, &numDevices);
-  uiNumDevices = numDevices;
-  if (0 == uiNumDevices) {
-	  std::cout << "Err: No GPU devices" << std::endl;
-	  return 0;
-  } else {
-    pDevices = (cl_device_id *) malloc(uiNumDevices * sizeof(cl_device_id));
-    OCL_CHECK(
-        clGetDeviceIDs(PlatformIDs[0], CL_DEVICE_TYPE_GPU, uiNumDevices,
-            pDevices, &uiNumDevices), "clGetDeviceIDs");
-    if (deviceId == -1) {
-      int i;
-      for (i = 0; i < (int) uiNumDevices; i++) {
-		clGetDeviceInfo(pDevices[i], CL_DEVICE_HOST_UNIFIED_MEMORY, sizeof(cl_bool), &unified_memory, NULL);
-		if (!unified_memory) { //skip iGPU
-			//we pick the first dGPU we found
-			pDevices[0] = pDevices[i];
-			device_id = i;
-			std::cout << "Picked default device type : dGPU " << device_id << std::endl;
-			break;
-		}
-      }
-      if (i == uiNumDevices) {
-		  std::cout << "Cannot find any dGPU! " << std::endl;
-		  //return 0;
-      }
-    } else if (deviceId >= 0 && deviceId < uiNumDevices) {
-		pDevices[0] = pDevices[deviceId];
-		device_id = deviceId;
-		std::cout << "Picked device type : GPU " << device_id << std::endl;
-    } else {
-		std::cout << "  Invalid GPU deviceId! " << std::endl;
+  RankDevices();
+  if (Candidates.empty()) {
+	  std::cout << "Err: No OpenCL devices" << std::endl;
+	  return false;
+  }
+
+  if (deviceId == -1) {
+    device_id = SelectDevice(Candidates, devicePolicy, deviceNamePattern);
+    if (device_id < 0) {
+      std::cout << "Err: No device matches the selection policy" << std::endl;
+      return false;
     }
+  } else if (deviceId >= 0 && deviceId < (int) Candidates.size()) {
+    device_id = deviceId;
+  } else {
+    std::cout << "  Invalid deviceId! " << std::endl;
+    return false;
   }
+  Selected = Candidates[device_id];
+  DisplayCandidates(Candidates, device_id);
+  std::cout << "Picked device " << device_id << " : " << Selected.deviceName << std::endl;
+
+  strncpy(platformName, Selected.platformName.c_str(), sizeof(platformName) - 1);
+  platformName[sizeof(platformName) - 1] = 0;
+  return true;
+}
+
+//Context over devices, a queue per device and the kernel files.
+//CommandQueue and CommandQueue_helper both run on devices[0].
+bool Device::CreateContext(const std::vector<cl_device_id> &devices) {
+  free (pDevices);
+  numContextDevices = (cl_uint) devices.size();
+  pDevices = (cl_device_id *) malloc(sizeof(cl_device_id) * numContextDevices);
+  for (cl_uint i = 0; i < numContextDevices; i++)
+    pDevices[i] = devices[i];
 
-  Context = clCreateContext(NULL, 1, pDevices, NULL, NULL, NULL);
+  cl_context_properties props[] = { CL_CONTEXT_PLATFORM, (cl_context_properties) Selected.platform, 0 };
+  Context = clCreateContext(props, numContextDevices, pDevices, NULL, NULL, NULL);
   if (NULL == Context) {
     fprintf(stderr, "Err: Failed to Create Context\n");
-    return 0;
+    return false;
   }
+  Buffers.SetContext(Context);
   CommandQueue = clCreateCommandQueue(Context, pDevices[0],
       CL_QUEUE_PROFILING_ENABLE, NULL);
   CommandQueue_helper = clCreateCommandQueue(Context, pDevices[0],
       CL_QUEUE_PROFILING_ENABLE, NULL);
   if (NULL == CommandQueue || NULL == CommandQueue_helper) {
     fprintf(stderr, "Err: Failed to Create Commandqueue\n");
-    return 0;
+    return false;
+  }
+  Queues.push_back(CommandQueue);
+  Prof.NameQueue(CommandQueue, "CommandQueue");
+  Prof.NameQueue(CommandQueue_helper, "CommandQueue_helper");
+  Staging.SetContext(Context, CommandQueue_helper, &Prof);
+  Tuner.profiler = &Prof;
+  for (cl_uint i = 1; i < numContextDevices; i++) {
+    cl_command_queue queue = clCreateCommandQueue(Context, pDevices[i],
+        CL_QUEUE_PROFILING_ENABLE, NULL);
+    if (NULL == queue) {
+      fprintf(stderr, "Err: Failed to Create Commandqueue\n");
+      return false;
+    }
+    Queues.push_back(queue);
+    Prof.NameQueue(queue, "Queues[" + std::to_string(i) + "] " + GetDeviceString(pDevices[i], CL_DEVICE_NAME));
+  }
+  if (numContextDevices > 1) {
+    std::cout << "Context over " << numContextDevices << " devices:" << std::endl;
+    for (cl_uint i = 0; i < numContextDevices; i++)
+      std::cout << "\t" << i << "\t" << GetDeviceString(pDevices[i], CL_DEVICE_NAME) << std::endl;
+    //cached and embedded binaries hold a single device
+    Cache.enabled = false;
   }
-  BuildProgram (oclKernelPath);
 
-  return 0;
+  BuildProgram (oclKernelPath);
+  if (buildMode != BUILD_LAZY)
+    BuildAllPrograms();
+  return true;
 }
 
-void Device::BuildProgram(std::string kernel_dir) 
+//List the *.cl files of a directory in name order
+static bool ListKernelFiles(std::string dir, std::vector<std::string> &files)
 {
-	const char *pSource;
-#ifdef RUN_Android
-	std::string strSource = "";
-	RegisterKernels(strSource);
-	pSource = strSource.c_str();
-#else
-  std::string strSource = "";
   DIR *ocl_dir;
   struct dirent *dirp;
-  if ((ocl_dir = opendir(kernel_dir.c_str())) == NULL) 
+  if ((ocl_dir = opendir(dir.c_str())) == NULL) 
   {
     fprintf(stderr, "Err: Open ocl dir failed!\n");
+    return false;
   }
   while ((dirp = readdir(ocl_dir)) != NULL) 
   {
@@ -114,53 +223,603 @@ void Device::BuildProgram(std::string kernel_dir)
     std::string file_name = std::string(dirp->d_name);
     //Skip non *.cl files
     size_t last_dot_pos = file_name.find_last_of(".");
-    if (file_name.substr(last_dot_pos + 1) != "cl")
+    if (last_dot_pos == std::string::npos || file_name.substr(last_dot_pos + 1) != "cl")
       continue;
+    files.push_back(file_name);
+  } 
+  closedir(ocl_dir);
+  std::sort(files.begin(), files.end());
+  return true;
+}
 
-    std::string ocl_kernel_full_path = kernel_dir + file_name;
+//Index the kernel files: every file becomes its own program unit and is
+//only compiled when one of its kernels is requested by GetKernel
+void Device::BuildProgram(std::string kernel_dir) 
+{
+  HostSpan span(Prof, "BuildProgram index");
+#ifdef RUN_Android
+	//the sources stay in the generated table until their unit is built
+	HeaderSource.assign(kernelHeader.source, kernelHeader.length);
+	for (size_t i = 0; i < numKernelSources; i++)
+		AddEmbeddedUnit(kernelSources[i]);
+#else
+  std::string strHeader = "";
+  std::vector<std::string> headers;
+  ListKernelFiles(oclHeaderPath, headers);
+  for (size_t i = 0; i < headers.size(); i++) {
     std::string tmpSource = "";
-    ConvertToString(ocl_kernel_full_path.c_str(), tmpSource);
-    strSource += tmpSource;
-  } 
-  pSource = strSource.c_str();	
+    ConvertToString(oclHeaderPath + headers[i], tmpSource);
+    strHeader += tmpSource + "\n\n";
+  }
+  HeaderSource = strHeader;
+
+  std::vector<std::string> files;
+  if (!ListKernelFiles(kernel_dir, files))
+    return;
+  for (size_t i = 0; i < files.size(); i++) {
+    std::string tmpSource = "";
+    if (ConvertToString(kernel_dir + files[i], tmpSource) != 0)
+      continue;
+    AddProgramUnit(files[i], tmpSource);
+  }
+#endif
+  std::cout << "Indexed " << KernelIndex.size() << " kernels in "
+      << Programs.size() << " program units" << std::endl;
+}
+
+void Device::AddProgramUnit(std::string name, const std::string &strSource)
+{
+  ProgramUnit unit;
+  unit.name = name;
+  unit.source = strSource;
+  Programs.push_back(unit);
+
+  std::vector<std::string> names;
+  ScanKernelNames(strSource, names);
+  IndexKernelNames(names);
+}
+
+void Device::AddEmbeddedUnit(const KernelSource &src)
+{
+  ProgramUnit unit;
+  unit.name = src.file;
+  unit.embedded = &src;
+  Programs.push_back(unit);
+
+  std::vector<std::string> names(src.kernels, src.kernels + src.numKernels);
+  IndexKernelNames(names);
+}
+
+//Map the kernel names to the last added unit
+void Device::IndexKernelNames(const std::vector<std::string> &names)
+{
+  const std::string &name = Programs.back().name;
+  for (size_t i = 0; i < names.size(); i++) {
+    if (KernelIndex.find(names[i]) != KernelIndex.end()) {
+      std::cout << "Err: kernel " << names[i] << " defined in both "
+          << Programs[KernelIndex[names[i]]].name << " and " << name << std::endl;
+      continue;
+    }
+    KernelIndex[names[i]] = Programs.size() - 1;
+  }
+}
+
+//Cheap scan for "__kernel ... void name(" declarations. Comments,
+//strings and preprocessor lines are skipped. TEMPLATE(name,Dtype) names
+//one kernel per element type and marks the file typed; other names
+//built by macros are picked up from CL_PROGRAM_KERNEL_NAMES once their
+//unit is built.
+void Device::ScanKernelNames(const std::string &strSource, std::vector<std::string> &names, bool *typed)
+{
+  enum { SEEK_KERNEL, SEEK_VOID, SEEK_NAME } state = SEEK_KERNEL;
+  bool lineStart = true;
+  size_t i = 0, n = strSource.size();
+  while (i < n) {
+    char c = strSource[i];
+    if (c == '\n') {
+      lineStart = true;
+      i++;
+    } else if (c == ' ' || c == '\t' || c == '\r') {
+      i++;
+    } else if (c == '/' && i + 1 < n && strSource[i + 1] == '/') {
+      while (i < n && strSource[i] != '\n') i++;
+    } else if (c == '/' && i + 1 < n && strSource[i + 1] == '*') {
+      size_t end = strSource.find("*/", i + 2);
+      i = (end == std::string::npos) ? n : end + 2;
+    } else if (c == '#' && lineStart) {
+      //skip the directive, including continuation lines
+      while (i < n && !(strSource[i] == '\n' && strSource[i - 1] != '\\')) i++;
+    } else if (c == '"') {
+      for (i++; i < n && strSource[i] != '"'; i++)
+        if (strSource[i] == '\\') i++;
+      i++;
+    } else if (isalpha((unsigned char) c) || c == '_') {
+      size_t begin = i;
+      while (i < n && (isalnum((unsigned char) strSource[i]) || strSource[i] == '_')) i++;
+      std::string token = strSource.substr(begin, i - begin);
+      lineStart = false;
+      if (token == "__kernel" || token == "kernel") {
+        state = SEEK_VOID;
+      } else if (state == SEEK_VOID && token == "void") {
+        state = SEEK_NAME;
+      } else if (state == SEEK_NAME) {
+        size_t next = strSource.find_first_not_of(" \t\r\n", i);
+        if (next != std::string::npos && strSource[next] == '(') {
+          //"NAME(a,b)(" is a name built by a macro such as TEMPLATE
+          size_t close = strSource.find(')', next);
+          size_t after = (close == std::string::npos) ? close :
+              strSource.find_first_not_of(" \t\r\n", close + 1);
+          if (after == std::string::npos || strSource[after] != '(') {
+            names.push_back(token);
+          } else if (token == "TEMPLATE") {
+            //TEMPLATE(name,Dtype): one kernel per element type
+            std::string args = strSource.substr(next + 1, close - next - 1);
+            args.erase(std::remove_if(args.begin(), args.end(), ::isspace), args.end());
+            size_t comma = args.find(',');
+            if (comma != std::string::npos && args.substr(comma + 1) == "Dtype") {
+              for (size_t t = 0; t < numKernelTypes; t++)
+                names.push_back(args.substr(0, comma) + "_" + kernelTypes[t].name);
+              if (typed != NULL)
+                *typed = true;
+            }
+          }
+        }
+        state = SEEK_KERNEL;
+      }
+    } else {
+      lineStart = false;
+      //attributes may sit between __kernel and void, anything else ends the match
+      if (state == SEEK_NAME || (state == SEEK_VOID && c == ';'))
+        state = SEEK_KERNEL;
+      i++;
+    }
+  }
+}
+
+//Source text of a unit, without the headers
+std::string Device::UnitSource(size_t unit)
+{
+  const ProgramUnit &pu = Programs[unit];
+  if (pu.embedded != NULL)
+    return std::string(pu.embedded->source, pu.embedded->length);
+  return pu.source;
+}
+
+//Source text of a unit as it is compiled: templated files once per
+//element type, see kernel_types.hpp
+std::string Device::CompiledSource(size_t unit)
+{
+  std::string source = UnitSource(unit);
+  std::vector<std::string> names;
+  bool typed = false;
+  ScanKernelNames(source, names, &typed);
+  return typed ? InstantiateTypes(source) : source;
+}
+
+//Build a kernel file (unit name, e.g. "convolution.cl") with extra options,
+//once per option string. A file specialized by -D values yields one
+//variant per value set; the caller creates its kernels with clCreateKernel.
+//prelude goes between the headers and the file, for definitions -D
+//cannot carry, such as function-like macros.
+cl_program Device::GetProgramVariant(const std::string &unitName, const std::string &options,
+    const std::string &prelude)
+{
+  std::lock_guard<std::mutex> guard(kernelMutex);
+  std::string name = unitName + " " + options;
+  std::string key = prelude.empty() ? name : name + "\n" + prelude;
+  std::map<std::string, cl_program>::iterator it = Variants.find(key);
+  if (it != Variants.end())
+    return it->second;
+  size_t unit = 0;
+  while (unit < Programs.size() && Programs[unit].name != unitName)
+    unit++;
+  if (unit == Programs.size()) {
+    std::cout << "Err: no kernel file " << unitName << std::endl;
+    return NULL;
+  }
+  HostSpan span(Prof, "BuildProgram " + name);
+  cl_program program = CreateProgram(HeaderSource + prelude + CompiledSource(unit), name, options);
+  if (program != NULL)
+    Variants[key] = program;
+  return program;
+}
+
+//Build source generated at run time, once per distinct source text.
+//name only labels the build in messages and traces.
+cl_program Device::GetGeneratedProgram(const std::string &name, const std::string &source)
+{
+  std::lock_guard<std::mutex> guard(kernelMutex);
+  std::map<std::string, cl_program>::iterator it = Variants.find(source);
+  if (it != Variants.end())
+    return it->second;
+  HostSpan span(Prof, "BuildProgram " + name);
+  cl_program program = CreateProgram(HeaderSource + source, name);
+  if (program != NULL)
+    Variants[source] = program;
+  return program;
+}
+
+//Return the program that defines kernel_name, building its unit on first use
+cl_program Device::GetProgram(std::string kernel_name)
+{
+  std::map<std::string, size_t>::iterator it = KernelIndex.find(kernel_name);
+  if (it != KernelIndex.end())
+    return BuildProgramUnit(it->second);
+
+  //not found by the scan: build the remaining units until one defines it
+  for (size_t i = 0; i < Programs.size(); i++) {
+    if (Programs[i].built)
+      continue;
+    BuildProgramUnit(i);
+    it = KernelIndex.find(kernel_name);
+    if (it != KernelIndex.end())
+      return Programs[it->second].program;
+  }
+  return NULL;
+}
+
+cl_program Device::BuildProgramUnit(size_t unit)
+{
+  ProgramUnit &pu = Programs[unit];
+  if (pu.built)
+    return pu.program;
+  pu.built = true;
+  HostSpan span(Prof, "BuildProgram " + pu.name);
+  Timer timer;
+#ifdef RUN_Android
+  if (numContextDevices == 1)
+    pu.program = LoadEmbeddedBinary(pu.name);
+  if (pu.program == NULL)
+    pu.program = CreateProgram(HeaderSource + CompiledSource(unit), pu.name);
+#else
+  pu.program = CreateProgram(HeaderSource + CompiledSource(unit), pu.name);
 #endif
+  pu.compileMs = timer.MilliSeconds();
+  if (pu.program == NULL)
+    return NULL;
+
+  IndexProgramKernels(pu.program, unit);
+  return pu.program;
+}
+
+//Register the kernels of a built program, including the names the
+//scan could not see
+void Device::IndexProgramKernels(cl_program program, size_t unit)
+{
+  size_t size = 0;
+  if (clGetProgramInfo(program, CL_PROGRAM_KERNEL_NAMES, 0, NULL, &size) != CL_SUCCESS || size <= 1)
+    return;
+  std::string kernel_names(size, '\0');
+  clGetProgramInfo(program, CL_PROGRAM_KERNEL_NAMES, size, &kernel_names[0], NULL);
+  kernel_names.resize(strlen(kernel_names.c_str()));
+  size_t begin = 0;
+  while (begin < kernel_names.size()) {
+    size_t end = kernel_names.find(';', begin);
+    if (end == std::string::npos)
+      end = kernel_names.size();
+    std::string name = kernel_names.substr(begin, end - begin);
+    if (!name.empty() && KernelIndex.find(name) == KernelIndex.end())
+      KernelIndex[name] = unit;
+    begin = end + 1;
+  }
+}
 
+//Build every unit up front, either one after another or compiled in
+//parallel and linked into a single program
+void Device::BuildAllPrograms()
+{
+  HostSpan span(Prof, "BuildAllPrograms");
+  Timer wall;
+  if (buildMode == BUILD_PARALLEL) {
+    if (BuildLinkedProgram())
+      return;
+    std::cout << "Parallel build unavailable, building serially" << std::endl;
+    wall.Start();
+  }
+
+  double total = 0;
+  for (size_t i = 0; i < Programs.size(); i++) {
+    BuildProgramUnit(i);
+    std::cout << "\t" << Programs[i].name << ":\t" << Programs[i].compileMs << " ms" << std::endl;
+    total += Programs[i].compileMs;
+  }
+  std::cout << "Serial build: " << Programs.size() << " files, wall " << wall.MilliSeconds()
+      << " ms (sum of files " << total << " ms)" << std::endl;
+}
+
+//Compile every kernel file separately on a host thread pool and link the
+//objects into one program. The headers are handed to clCompileProgram as
+//an input header instead of being pasted in front of each file.
+bool Device::BuildLinkedProgram()
+{
+  //separate compilation and linking are OpenCL 1.2 features; with older
+  //headers BuildAllPrograms falls back to BUILD_SERIAL
+#ifndef CL_VERSION_1_2
+  return false;
+#else
+  char version[64] = { 0 };
+  cl_bool linker = CL_FALSE;
+  clGetDeviceInfo(pDevices[0], CL_DEVICE_VERSION, sizeof(version) - 1, version, NULL);
+  clGetDeviceInfo(pDevices[0], CL_DEVICE_LINKER_AVAILABLE, sizeof(cl_bool), &linker, NULL);
+  int major = 0, minor = 0;
+  sscanf(version, "OpenCL %d.%d", &major, &minor);
+  if (major * 10 + minor < 12 || !linker)
+    return false;
+
+  Timer wall;
+  const char *headerName = "header.cl";
+  std::string strLinked = HeaderSource;
+  for (size_t i = 0; i < Programs.size(); i++)
+    strLinked += CompiledSource(i);
+
+  //a cached linked binary skips the whole compile and link
+  std::string key = Cache.MakeKey(strLinked, buildOption + " -link", pDevices[0]);
+  cl_program linked = Cache.Load(Context, pDevices[0], key, buildOption);
+  std::vector<cl_int> status(Programs.size(), CL_SUCCESS);
+  double sum = 0;
+  if (linked == NULL) {
+    const char *pHeader = HeaderSource.c_str();
+    cl_program header = clCreateProgramWithSource(Context, 1, &pHeader, NULL, NULL);
+    if (header == NULL)
+      return false;
+
+    std::vector<std::string> sources(Programs.size());
+    std::vector<cl_program> objects(Programs.size(), (cl_program) NULL);
+    for (size_t i = 0; i < Programs.size(); i++) {
+      sources[i] = std::string("#include \"") + headerName + "\"\n#line 1\n" + CompiledSource(i);
+      const char *pSource = sources[i].c_str();
+      objects[i] = clCreateProgramWithSource(Context, 1, &pSource, NULL, NULL);
+    }
+
+    ThreadPool pool;
+    cl_uint numDevices = numContextDevices;
+    const cl_device_id *devices = pDevices;
+    std::string options = buildOption;
+    for (size_t i = 0; i < Programs.size(); i++) {
+      if (objects[i] == NULL) {
+        status[i] = CL_INVALID_PROGRAM;
+        continue;
+      }
+      cl_program object = objects[i];
+      cl_int *pStatus = &status[i];
+      double *pMs = &Programs[i].compileMs;
+      pool.Enqueue([=, &options]() {
+        Timer timer;
+        const char *includeName = headerName;
+        *pStatus = clCompileProgram(object, numDevices, devices, options.c_str(),
+            1, &header, &includeName, NULL, NULL);
+        *pMs = timer.MilliSeconds();
+      });
+    }
+    pool.Wait();
+    double compileWall = wall.MilliSeconds();
+
+    //a file that fails to compile is left out of the link
+    std::vector<cl_program> compiled;
+    for (size_t i = 0; i < Programs.size(); i++) {
+      if (status[i] == CL_SUCCESS) {
+        compiled.push_back(objects[i]);
+      } else if (objects[i] != NULL) {
+        ReportBuildFailure(objects[i], status[i], sources[i], Programs[i].name);
+      }
+      sum += Programs[i].compileMs;
+    }
+
+    Timer link;
+    cl_int err = CL_INVALID_VALUE;
+    if (!compiled.empty())
+      linked = clLinkProgram(Context, numContextDevices, pDevices, NULL, (cl_uint) compiled.size(),
+          &compiled[0], NULL, NULL, &err);
+    if (err != CL_SUCCESS) {
+      std::cout << "Err: Failed to link program ( Err = " << err << " )" << std::endl;
+      if (linked != NULL)
+        ReportBuildFailure(linked, err, strLinked, "linked");
+      linked = NULL;
+    }
+    std::cout << "Parallel build: compile wall " << compileWall << " ms on "
+        << pool.Size() << " threads, link " << link.MilliSeconds() << " ms" << std::endl;
+
+    for (size_t i = 0; i < objects.size(); i++) {
+      if (objects[i] != NULL)
+        clReleaseProgram(objects[i]);
+    }
+    clReleaseProgram(header);
+    Cache.RecordCompile(wall.MilliSeconds());
+    if (linked == NULL)
+      return false;
+    Cache.Store(linked, key);
+  }
+
+  size_t first = Programs.size();
+  for (size_t i = 0; i < Programs.size(); i++) {
+    Programs[i].built = true;
+    if (status[i] != CL_SUCCESS)
+      continue;
+    clRetainProgram(linked);
+    Programs[i].program = linked;
+    if (first == Programs.size())
+      first = i;
+    std::cout << "\t" << Programs[i].name << ":\t" << Programs[i].compileMs << " ms" << std::endl;
+  }
+  if (first < Programs.size())
+    IndexProgramKernels(linked, first);
+  clReleaseProgram(linked);
+
+  double total = wall.MilliSeconds();
+  std::cout << "Parallel build: " << Programs.size() << " files, wall " << total
+      << " ms vs serial " << sum << " ms";
+  if (total > 0 && sum > 0)
+    std::cout << " (" << sum / total << "x)";
+  std::cout << std::endl;
+  return true;
+#endif
+}
+
+//Load a kernel file from the binaries compiled ahead of time by
+//kernelGen/cl_kernels.sh: first a device binary for this exact device and
+//driver, then portable SPIR when the device accepts it
+cl_program Device::LoadEmbeddedBinary(const std::string &name)
+{
+  std::string deviceName = GetDeviceString(pDevices[0], CL_DEVICE_NAME);
+  std::string driver = GetDeviceString(pDevices[0], CL_DRIVER_VERSION);
+  std::string extensions = GetDeviceString(pDevices[0], CL_DEVICE_EXTENSIONS);
+
+  cl_int err = CL_SUCCESS;
+  const KernelBinary *binary = FindKernelBinary(deviceName, driver, name);
+  if (binary != NULL) {
+    cl_program program = ProgramCache::CreateFromBinary(Context, pDevices[0],
+        binary->data, binary->size, buildOption, &err);
+    if (program != NULL) {
+      std::cout << "Build Program " << name << " (embedded binary)" << std::endl;
+      return program;
+    }
+    std::cout << "Embedded binary for " << name << " rejected ( Err = " << err << " )" << std::endl;
+  }
+
+  binary = FindKernelBinary("spir", "", name);
+  if (binary != NULL && extensions.find("cl_khr_spir") != std::string::npos) {
+    cl_program program = ProgramCache::CreateFromBinary(Context, pDevices[0],
+        binary->data, binary->size, buildOption + " -x spir -spir-std=1.2", &err);
+    if (program != NULL) {
+      std::cout << "Build Program " << name << " (embedded SPIR)" << std::endl;
+      return program;
+    }
+    std::cout << "Embedded SPIR for " << name << " rejected ( Err = " << err << " )" << std::endl;
+  }
+  return NULL;
+}
+
+//Build every kernel file from source and write the device binaries for
+//kernelGen/cl_kernels.sh -b: <dir>/<device tag>/<file>.bin, plus the
+//sources they were built from and a device.txt naming device and driver
+bool Device::DumpBinaries(std::string dir)
+{
+  if (numContextDevices != 1) {
+    std::cout << "Err: DumpBinaries needs a single device context" << std::endl;
+    return false;
+  }
+  std::string deviceName = GetDeviceString(pDevices[0], CL_DEVICE_NAME);
+  std::string driver = GetDeviceString(pDevices[0], CL_DRIVER_VERSION);
+  std::string tag = deviceName + "_" + driver;
+  for (size_t i = 0; i < tag.size(); i++) {
+    if (!isalnum((unsigned char) tag[i]))
+      tag[i] = '_';
+  }
+  std::string path = dir + tag + "/";
+  ProgramCache::MakeDirectory(dir);
+  ProgramCache::MakeDirectory(path);
+
+  std::ofstream info((path + "device.txt").c_str());
+  if (!info.is_open()) {
+    std::cout << "Err: cannot write " << path << "device.txt" << std::endl;
+    return false;
+  }
+  info << deviceName << "\n" << driver << "\n";
+  info.close();
+  std::ofstream header((path + "header.src").c_str(), std::ios::out | std::ios::binary);
+  header << HeaderSource;
+  header.close();
+
+  bool ok = true;
+  for (size_t i = 0; i < Programs.size(); i++) {
+    cl_program program = CompileProgram(HeaderSource + CompiledSource(i), Programs[i].name);
+    if (program == NULL) {
+      ok = false;
+      continue;
+    }
+    size_t size = 0;
+    clGetProgramInfo(program, CL_PROGRAM_BINARY_SIZES, sizeof(size_t), &size, NULL);
+    std::vector<unsigned char> binary(size + 1);
+    unsigned char *pBinary = &binary[0];
+    clGetProgramInfo(program, CL_PROGRAM_BINARIES, sizeof(unsigned char *), &pBinary, NULL);
+    clReleaseProgram(program);
+
+    std::ofstream bin((path + Programs[i].name + ".bin").c_str(), std::ios::out | std::ios::binary);
+    bin.write((const char *) &binary[0], size);
+    bin.close();
+    std::ofstream src((path + Programs[i].name + ".src").c_str(), std::ios::out | std::ios::binary);
+    src << UnitSource(i);
+    src.close();
+    std::cout << "\t" << path << Programs[i].name << ".bin\t" << size << " bytes" << std::endl;
+  }
+  return ok;
+}
+
+//Load the program from the binary cache, or build it from source and
+//store the result for the next start
+cl_program Device::CreateProgram(const std::string &strSource, const std::string &name,
+    const std::string &extraOptions)
+{
+  std::string options = extraOptions.empty() ? buildOption : buildOption + " " + extraOptions;
+  std::string key = Cache.MakeKey(strSource, options, pDevices[0]);
+  cl_program program = Cache.Load(Context, pDevices[0], key, options);
+  if (program != NULL) {
+    std::cout << "Build Program " << name << " (cached " << key << ")" << std::endl;
+    return program;
+  }
+
+  Timer timer;
+  program = CompileProgram(strSource, name, extraOptions);
+  Cache.RecordCompile(timer.MilliSeconds());
+  if (program != NULL)
+    Cache.Store(program, key);
+  return program;
+}
+
+cl_program Device::CompileProgram(const std::string &strSource, const std::string &name,
+    const std::string &extraOptions)
+{
+  std::string options = extraOptions.empty() ? buildOption : buildOption + " " + extraOptions;
+  const char *pSource = strSource.c_str();
   size_t uiArrSourceSize[] = { 0 };
-  uiArrSourceSize[0] = strlen(pSource);
-  Program = NULL;
-  Program = clCreateProgramWithSource(Context, 1, &pSource, uiArrSourceSize, NULL);
+  uiArrSourceSize[0] = strSource.size();
+  cl_program program = NULL;
+  program = clCreateProgramWithSource(Context, 1, &pSource, uiArrSourceSize, NULL);
 
-  if (NULL == Program) {
+  if (NULL == program) {
     fprintf(stderr, "Err: Failed to create program\n");
+    return NULL;
   }
-  cl_int iStatus = clBuildProgram(Program, 1, pDevices, buildOption.c_str(), NULL, NULL);
-  std::cout << "Build Program";
+  cl_int iStatus = clBuildProgram(program, numContextDevices, pDevices, options.c_str(), NULL, NULL);
+  std::cout << "Build Program " << name << std::endl;
   if (CL_SUCCESS != iStatus) {
-    fprintf(stderr, "Err: Failed to build program\n");
+    ReportBuildFailure(program, iStatus, strSource, name);
+    clReleaseProgram (program);
+    return NULL;
+  }
+  return program;
+}
+
+void Device::ReportBuildFailure(cl_program program, cl_int iStatus,
+    const std::string &strSource, const std::string &name)
+{
+    fprintf(stderr, "Err: Failed to build program %s\n", name.c_str());
 	{
-		cl_build_status status;
-		clGetProgramBuildInfo(Program, *pDevices, CL_PROGRAM_BUILD_STATUS, sizeof(cl_build_status), &status, NULL);
-		std::cout << "Build Status = " << status << " ( Err = " << iStatus << " )" << std::endl;
-
-		char *build_log;
-		size_t ret_val_size; // don't use vcl_size_t here
-		iStatus = clGetProgramBuildInfo(Program, *pDevices, CL_PROGRAM_BUILD_LOG, 0, NULL, &ret_val_size);
-		build_log = new char[ret_val_size + 1];
-		iStatus = clGetProgramBuildInfo(Program, *pDevices, CL_PROGRAM_BUILD_LOG, ret_val_size, build_log, NULL);
-		build_log[ret_val_size] = '\0';
-		//std::cout << "Log: " << build_log << std::endl;
 		std::ofstream logfile("build_log.txt");
-		logfile << build_log;
+		for (cl_uint d = 0; d < numContextDevices; d++) {
+			cl_build_status status;
+			clGetProgramBuildInfo(program, pDevices[d], CL_PROGRAM_BUILD_STATUS, sizeof(cl_build_status), &status, NULL);
+			std::cout << "Build Status = " << status << " ( Err = " << iStatus << " )" << std::endl;
+
+			char *build_log;
+			size_t ret_val_size = 0; // don't use vcl_size_t here
+			clGetProgramBuildInfo(program, pDevices[d], CL_PROGRAM_BUILD_LOG, 0, NULL, &ret_val_size);
+			build_log = new char[ret_val_size + 1];
+			clGetProgramBuildInfo(program, pDevices[d], CL_PROGRAM_BUILD_LOG, ret_val_size, build_log, NULL);
+			build_log[ret_val_size] = '\0';
+			//std::cout << "Log: " << build_log << std::endl;
+			if (numContextDevices > 1)
+				logfile << "// " << GetDeviceString(pDevices[d], CL_DEVICE_NAME) << "\n";
+			logfile << build_log;
+			delete[] build_log;
+		}
 		logfile.close();
-		delete[] build_log;
 
 		//std::cout << "Sources: " << source << std::endl;
 		std::ofstream srcfile("build_source.txt");
-		srcfile << pSource;
+		srcfile << strSource;
 		srcfile.close();
 	}
-    clReleaseProgram (Program);
-  }
 }
 
 bool Device::SetKernelPath(std::string path){
@@ -168,11 +827,26 @@ bool Device::SetKernelPath(std::string path){
 	return true;
 }
 
+bool Device::SetHeaderPath(std::string path){
+	oclHeaderPath = path;
+	return true;
+}
+
 bool Device::SetBuildOption(std::string option){
 	buildOption = option;
 	return true;
 }
 
+bool Device::SetBuildMode(BuildMode mode){
+	buildMode = mode;
+	return true;
+}
+
+bool Device::SetCachePath(std::string path){
+	Cache.cachePath = path;
+	return true;
+}
+
 //Use to read OpenCL source code
 cl_int Device::ConvertToString(std::string pFileName, std::string &Str) {
   size_t uiSize = 0;
@@ -203,22 +877,106 @@ cl_int Device::ConvertToString(std::string pFileName, std::string &Str) {
   return -1;
 }
 
+//Kernels this thread got from GetKernel, per Device generation. Only the
+//owning thread touches it, so the lookup takes no lock.
+static thread_local std::map<unsigned long long, std::map<std::string, cl_kernel> > threadKernels;
+
+unsigned long long Device::NextGeneration() {
+  static std::atomic<unsigned long long> next(1);
+  return next++;
+}
+
 cl_kernel Device::GetKernel(std::string kernel_name) {
+  std::map<std::string, cl_kernel> &mine = threadKernels[generation];
+  std::map<std::string, cl_kernel>::iterator it = mine.find(kernel_name);
+  if (it != mine.end())
+    return it->second;
+  cl_kernel kernel = CreateKernelInstance(kernel_name);
+  if (kernel != NULL)
+    mine[kernel_name] = kernel;
+  return kernel;
+}
+
+//Slow path of GetKernel. Every thread gets a clone of the kernel's
+//template (OpenCL 2.1 devices) or a new kernel object of its program;
+//nobody sets arguments on the template, so cloning it never races.
+cl_kernel Device::CreateKernelInstance(const std::string &kernel_name) {
+  std::lock_guard<std::mutex> guard(kernelMutex);
+  HostSpan span(Prof, "GetKernel " + kernel_name);
+  cl_int _err = 0;
   std::map<std::string, cl_kernel>::iterator it = Kernels.find(kernel_name);
   if (it == Kernels.end()) {
-    cl_int _err = 0;
-    cl_kernel kernel = clCreateKernel(Program, kernel_name.c_str(), &_err);
+    cl_program program = GetProgram(kernel_name);
+    if (program == NULL) {
+      std::cout << "Err: no program provides kernel " << kernel_name << std::endl;
+      return NULL;
+    }
+    cl_kernel tmpl = clCreateKernel(program, kernel_name.c_str(), &_err);
     OCL_CHECK(_err, "GetKernel");
-    Kernels[kernel_name] = kernel;
+    if (tmpl == NULL)
+      return NULL;
+    it = Kernels.insert(std::make_pair(kernel_name, tmpl)).first;
   }
-  return Kernels[kernel_name];
+
+  cl_kernel kernel = NULL;
+#ifdef CL_VERSION_2_1
+  char version[64] = { 0 };
+  clGetDeviceInfo(pDevices[0], CL_DEVICE_VERSION, sizeof(version) - 1, version, NULL);
+  int major = 0, minor = 0;
+  sscanf(version, "OpenCL %d.%d", &major, &minor);
+  if (major * 10 + minor >= 21)
+    kernel = clCloneKernel(it->second, &_err);
+#endif
+  if (kernel == NULL) {
+    cl_program program = NULL;
+    clGetKernelInfo(it->second, CL_KERNEL_PROGRAM, sizeof(cl_program), &program, NULL);
+    kernel = clCreateKernel(program, kernel_name.c_str(), &_err);
+    OCL_CHECK(_err, "GetKernel");
+  }
+  if (kernel != NULL)
+    KernelInstances.push_back(kernel);
+  return kernel;
 }
 
+//The Tuner's lookup builds a key of device strings and the program hash,
+//so its answer is kept with the instance's arguments until the queue or
+//global size changes
+cl_int Device::LaunchTuned(cl_command_queue queue, cl_kernel kernel, const NDRange &range, bool tune) {
+  KernelArgState &state = GetKernelArgState(generation, kernel);
+  bool same = state.tunedQueue == queue && state.tunedDims == range.dims;
+  for (cl_uint d = 0; same && d < range.dims; d++)
+    same = state.tunedGlobal[d] == range.global[d];
+  if (!same) {
+    LocalSize local;
+    if (!Tuner.Lookup(queue, kernel, range.dims, range.global, local) && Tuner.autoTune && tune) {
+      cl_int err = Tuner.Tune(queue, kernel, range.dims, range.global, local);
+      if (err != CL_SUCCESS)
+        return err;
+    }
+    state.tunedQueue = queue;
+    state.tunedDims = range.dims;
+    for (cl_uint d = 0; d < 3; d++)
+      state.tunedGlobal[d] = range.global[d];
+    state.tunedLocal = local;
+  }
+  ProfileEvent pe(Prof, kernel);
+  return clEnqueueNDRangeKernel(queue, kernel, range.dims, NULL, range.global, state.tunedLocal.Get(),
+      0, NULL, pe.Out());
+}
+
+//Releases the instances of every thread; other threads' caches keep
+//entries under this generation, which no Device will look up again
 void Device::ReleaseKernels() {
+  std::lock_guard<std::mutex> guard(kernelMutex);
   std::map<std::string, cl_kernel>::iterator it;
   for (it = Kernels.begin(); it != Kernels.end(); it++) {
     clReleaseKernel(it->second);
   }
+  for (size_t i = 0; i < KernelInstances.size(); i++)
+    clReleaseKernel(KernelInstances[i]);
+  Kernels.clear();
+  KernelInstances.clear();
+  threadKernels.erase(generation);
 }
 
 void Device::DisplayPlatformInfo() {
@@ -230,6 +988,7 @@ void Device::DisplayPlatformInfo() {
     return;
   }
 
+  free((void*) platformIDs);
   platformIDs = (cl_platform_id *) malloc(
       sizeof(cl_platform_id) * numPlatforms);
   err = clGetPlatformIDs(numPlatforms, platformIDs, NULL);
@@ -273,29 +1032,53 @@ void Device::DisplayInfo(cl_platform_id id, cl_platform_info name,
   std::cout << "\t" << str << "\t" << info << std::endl;
 }
 
+std::string Device::GetDeviceString(cl_device_id id, cl_device_info name) {
+  size_t size = 0;
+  if (clGetDeviceInfo(id, name, 0, NULL, &size) != CL_SUCCESS || size == 0)
+    return "";
+  std::vector<char> info(size + 1, 0);
+  clGetDeviceInfo(id, name, size, &info[0], NULL);
+  return std::string(&info[0]);
+}
+
+std::string Device::GetPlatformString(cl_platform_id id, cl_platform_info name) {
+  size_t size = 0;
+  if (clGetPlatformInfo(id, name, 0, NULL, &size) != CL_SUCCESS || size == 0)
+    return "";
+  std::vector<char> info(size + 1, 0);
+  clGetPlatformInfo(id, name, size, &info[0], NULL);
+  return std::string(&info[0]);
+}
+
 void Device::GetDeviceInfo() {
-  cl_int err;
-  //by default, we select the first platform. can be extended for more platforms
-  //query GPU device for now
-  err = clGetDeviceIDs(platformIDs[0], CL_DEVICE_TYPE_GPU, 0, NULL,
-      &numDevices);
-  // we allow program run if no GPU is found. Just return. No error reported.
+  //every device of every platform, any type
+  numDevices = 0;
+  for (cl_uint p = 0; p < numPlatforms; p++) {
+    cl_uint count = 0;
+    if (clGetDeviceIDs(platformIDs[p], CL_DEVICE_TYPE_ALL, 0, NULL, &count) == CL_SUCCESS)
+      numDevices += count;
+  }
+  // we allow program run if no device is found. Just return. No error reported.
   if (numDevices < 1) {
-	  std::cout << "No GPU Devices found for platform " << platformIDs[0] << std::endl;
+	  std::cout << "No OpenCL Devices found" << std::endl;
     return;
   }
 
+  free (DeviceIDs);
   DeviceIDs = (cl_device_id *) malloc(sizeof(cl_device_id) * numDevices);
-  err = clGetDeviceIDs(platformIDs[0], CL_DEVICE_TYPE_GPU, numDevices,
-      DeviceIDs, NULL);
-  if (err != CL_SUCCESS) {
-	  std::cout << "Failed to find any GPU devices." << std::endl;
-    return;
+  cl_uint found = 0;
+  for (cl_uint p = 0; p < numPlatforms; p++) {
+    cl_uint count = 0;
+    if (clGetDeviceIDs(platformIDs[p], CL_DEVICE_TYPE_ALL, numDevices - found,
+        DeviceIDs + found, &count) == CL_SUCCESS)
+      found += count;
   }
+  numDevices = found;
 
   std::cout << "Number of devices found:" << numDevices << std::endl;
   for (cl_uint i = 0; i < numDevices; i++) {
 	std::cout << "\t" << "DeviceID" << ":\t" << DeviceIDs[i] << std::endl;
+    std::cout << "\t" << "Device name" << ":\t" << GetDeviceString(DeviceIDs[i], CL_DEVICE_NAME) << std::endl;
     DisplayDeviceInfo < cl_device_type
         > (DeviceIDs[i], CL_DEVICE_TYPE, "Device Type");
     DisplayDeviceInfo < cl_bool
@@ -332,21 +1115,42 @@ void Device::GetDeviceInfo() {
 
 void Device::DeviceQuery() {
   DisplayPlatformInfo();
+  if (numPlatforms == 0)
+    return;
 
-  clGetPlatformIDs(0, NULL, &numPlatforms);
-  cl_platform_id *PlatformIDs = new cl_platform_id[numPlatforms];
-  clGetPlatformIDs(numPlatforms, PlatformIDs, NULL);
+  GetDeviceInfo();
+  RankDevices();
+  DisplayCandidates(Candidates, SelectDevice(Candidates, devicePolicy, deviceNamePattern));
+}
 
-  size_t nameLen;
-  cl_int res = clGetPlatformInfo(PlatformIDs[0], CL_PLATFORM_NAME, 64,
-      platformName, &nameLen);
-  if (res != CL_SUCCESS) {
-    fprintf(stderr, "Err: Failed to Get Platform Info\n");
-    return;
+//Enumerate and score every device of every platform
+void Device::RankDevices() {
+  Candidates.clear();
+  EnumerateDevices(platformIDs, numPlatforms, Candidates);
+  if (probeDevices) {
+    for (size_t i = 0; i < Candidates.size(); i++) {
+      if (!ProbeDevice(Candidates[i]))
+        std::cout << "Probe failed on " << Candidates[i].deviceName << std::endl;
+    }
   }
-  platformName[nameLen] = 0;
+  ScoreDevices(Candidates);
+}
 
-  GetDeviceInfo();
+//True when every device of the context shares memory with the host
+bool Device::UnifiedMemory() {
+  for (cl_uint i = 0; i < numContextDevices; i++) {
+    cl_bool unified = CL_FALSE;
+    clGetDeviceInfo(pDevices[i], CL_DEVICE_HOST_UNIFIED_MEMORY, sizeof(cl_bool), &unified, NULL);
+    if (!unified)
+      return false;
+  }
+  return numContextDevices > 0;
+}
+
+bool Device::SetDevicePolicy(DevicePolicy policy, std::string name_pattern) {
+  devicePolicy = policy;
+  deviceNamePattern = name_pattern;
+  return true;
 }
 
 template <typename T>
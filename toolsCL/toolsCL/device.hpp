@@ -3,8 +3,20 @@
 #include <string>
 #include <fstream>
 #include <map>
+#include <vector>
+#include <climits>
+#include <mutex>
 #include <CL/cl.h>
 #include <iostream>
+#include "program_cache.hpp"
+#include "cl_kernels.hpp"
+#include "device_select.hpp"
+#include "buffer_pool.hpp"
+#include "staging_pool.hpp"
+#include "profiler.hpp"
+#include "autotuner.hpp"
+#include "launch.hpp"
+#include "kernel_types.hpp"
 
 #define OCL_CHECK(condition, content) \
 do {\
@@ -12,11 +24,34 @@ do {\
 	if (error != CL_SUCCESS) std::cout << "error: " << error << " [ " << content << " ]" << std::endl; \
 } while (0)
 
+//One compiled unit: a kernel file, built with the cl_headers prepended.
+//Units are built on the first GetKernel of one of their kernels.
+struct ProgramUnit {
+  ProgramUnit() : embedded(NULL), program(NULL), built(false), compileMs(0) {}
+  std::string name;
+  std::string source;
+  const KernelSource *embedded;  //RUN_Android: source stays in the generated table
+  cl_program program;
+  bool built;
+  double compileMs;
+};
+
+//How the kernel files are compiled
+enum BuildMode {
+  BUILD_LAZY,     //each file on the first GetKernel of one of its kernels
+  BUILD_SERIAL,   //every file up front, one after another
+  BUILD_PARALLEL  //every file up front on a thread pool, then linked
+};
 
 class Device {
   public:
     Device()
-        : numPlatforms(0), numDevices(0), device_id(INT_MIN), oclKernelPath("./kernelGen/cl_kernels/"), buildOption(" ") {
+        : numPlatforms(0), platformIDs(NULL), numDevices(0), DeviceIDs(NULL),
+          Context(NULL), CommandQueue(NULL), CommandQueue_helper(NULL), pDevices(NULL),
+          numContextDevices(0), subDevices(false), device_id(INT_MIN), oclKernelPath("./kernelGen/cl_kernels/"),
+          oclHeaderPath("./kernelGen/cl_headers/"), buildOption("-cl-kernel-arg-info"),
+          buildMode(BUILD_LAZY), devicePolicy(POLICY_FASTEST), probeDevices(false),
+          generation(NextGeneration()) {
     }
     ~Device();
     cl_uint numPlatforms;
@@ -29,26 +64,133 @@ class Device {
     cl_context Context;
     cl_command_queue CommandQueue;
     cl_command_queue CommandQueue_helper;
-    cl_program Program;
+    std::string HeaderSource;
+    std::vector<ProgramUnit> Programs;
+    std::map<std::string, size_t> KernelIndex;
+    std::map<std::string, cl_program> Variants;   //GetProgramVariant, keyed by file, options and prelude; GetGeneratedProgram, by source
     cl_device_id * pDevices;
+    cl_uint numContextDevices;              //devices in pDevices and Context
+    std::vector<cl_command_queue> Queues;   //one per device in pDevices, Queues[0] == CommandQueue
+    bool subDevices;                        //pDevices were created by InitSubDevices
     int device_id;
 	std::string oclKernelPath;
+	std::string oclHeaderPath;
 	std::string buildOption;
+	BuildMode buildMode;
+	DevicePolicy devicePolicy;
+	std::string deviceNamePattern;
+	bool probeDevices;
+	std::vector<DeviceCandidate> Candidates;  //every device of every platform, ranked
+	DeviceCandidate Selected;                 //the device behind pDevices[0]
 
-    std::map<std::string, cl_kernel> Kernels;
+    std::map<std::string, cl_kernel> Kernels;       //templates, arguments never set
+    std::vector<cl_kernel> KernelInstances;         //the instances GetKernel handed out
+    std::mutex kernelMutex;                         //guards the above and lazy builds
+    unsigned long long generation;                  //never reused, keys the per-thread kernels
+    ProgramCache Cache;
+    BufferPool Buffers;   //leases must be released before the Device goes away
+    StagingPool Staging;  //pinned transfers, Staging.Upload/Download
+    Profiler Prof;        //timings of the commands enqueued through the toolkit
+    std::string tracePath;
+    Autotuner Tuner;      //tuned local sizes, Tuner.Launch instead of clEnqueueNDRangeKernel
 
     cl_int Init(int device_id = -1);
+    cl_int InitMulti(cl_uint maxDevices = 0);
+    cl_int InitSubDevices(cl_uint parts, int device_id = -1);
+    bool PickDevice(int device_id);
+    bool CreateContext(const std::vector<cl_device_id> &devices);
     cl_int ConvertToString(std::string pFileName, std::string &Str);
+	//The calling thread's own instance: kernel arguments set by one thread
+	//never reach another thread's launches
 	cl_kernel GetKernel(std::string kernel_name);
+	//TEMPLATE(kernel_name,T) of a templated kernel file: GetKernel<cl_uchar>("mul2")
+	template <typename T>
+	cl_kernel GetKernel(const std::string &kernel_name) {
+	  return GetKernel(TemplateName<T>(kernel_name));
+	}
+	cl_kernel CreateKernelInstance(const std::string &kernel_name);
+	static unsigned long long NextGeneration();
+	//Set the arguments that changed since this instance's last launch and
+	//enqueue: Launch(kernel, NDRange(num), d_idata, d_odata). Without
+	//.Local() the local size is the Tuner's: looked up, or timed on the
+	//first launch of a global size (Tuner.autoTune), which reruns the kernel
+	//and so needs one that tolerates it
+	template <typename... Args>
+	cl_int Launch(cl_kernel kernel, const NDRange &range, const Args &... args) {
+	  return LaunchOn(CommandQueue, kernel, range, args...);
+	}
+	//Launch the T instantiation of a templated kernel:
+	//Run<cl_short>("mul2", NDRange(num), d_idata, d_odata)
+	template <typename T, typename... Args>
+	cl_int Run(const std::string &kernel_name, const NDRange &range, const Args &... args) {
+	  cl_kernel kernel = GetKernel<T>(kernel_name);
+	  if (kernel == NULL)
+	    return CL_INVALID_KERNEL_NAME;
+	  return Launch(kernel, range, args...);
+	}
+	//The argument half of Launch, for enqueues made elsewhere (Tuner.Launch)
+	template <typename... Args>
+	cl_int SetArgs(cl_kernel kernel, const Args &... args) {
+	  return SetKernelArgs(generation, kernel, args...);
+	}
+	template <typename... Args>
+	cl_int LaunchOn(cl_command_queue queue, cl_kernel kernel, const NDRange &range, const Args &... args) {
+	  if (!range.hasLocal) {
+	    cl_int err = SetArgs(kernel, args...);
+	    return err != CL_SUCCESS ? err : LaunchTuned(queue, kernel, range);
+	  }
+	  ProfileEvent pe(Prof, kernel);
+	  return LaunchKernel(queue, generation, kernel, range, pe.Out(), args...);
+	}
+	//Enqueue with the Tuner's local size, arguments already set. tune false
+	//only looks the size up, NULL when there is none: for kernels that
+	//must not be rerun
+	cl_int LaunchTuned(cl_command_queue queue, cl_kernel kernel, const NDRange &range, bool tune = true);
     void DisplayPlatformInfo();
     void DisplayInfo(cl_platform_id id, cl_platform_info name, std::string str);
+    static std::string GetDeviceString(cl_device_id id, cl_device_info name);
+    static std::string GetPlatformString(cl_platform_id id, cl_platform_info name);
 
 	int GetDevice() { return device_id; }
+	const DeviceCandidate &GetSelected() { return Selected; }
+	bool SetDevicePolicy(DevicePolicy policy, std::string name_pattern = "");
+	void EnableProbe(bool enable) { probeDevices = enable; }
+	bool UnifiedMemory();
+	void RankDevices();
     void GetDeviceInfo();
     void DeviceQuery();    
     void BuildProgram(std::string kernel_dir);
+    void AddProgramUnit(std::string name, const std::string &strSource);
+    void AddEmbeddedUnit(const KernelSource &src);
+    void IndexKernelNames(const std::vector<std::string> &names);
+    std::string UnitSource(size_t unit);
+    std::string CompiledSource(size_t unit);
+    cl_program GetProgram(std::string kernel_name);
+    cl_program BuildProgramUnit(size_t unit);
+    void IndexProgramKernels(cl_program program, size_t unit);
+    void BuildAllPrograms();
+    bool BuildLinkedProgram();
+    cl_program GetProgramVariant(const std::string &unitName, const std::string &options,
+        const std::string &prelude = "");
+    cl_program GetGeneratedProgram(const std::string &name, const std::string &source);
+    cl_program CreateProgram(const std::string &strSource, const std::string &name,
+        const std::string &extraOptions = "");
+    cl_program CompileProgram(const std::string &strSource, const std::string &name,
+        const std::string &extraOptions = "");
+    cl_program LoadEmbeddedBinary(const std::string &name);
+    bool DumpBinaries(std::string dir);
+    void ReportBuildFailure(cl_program program, cl_int iStatus, const std::string &strSource, const std::string &name);
+    static void ScanKernelNames(const std::string &strSource, std::vector<std::string> &names,
+        bool *typed = NULL);
 	bool SetKernelPath(std::string path);
+	bool SetHeaderPath(std::string path);
 	bool SetBuildOption(std::string option);
+	bool SetBuildMode(BuildMode mode);
+	bool SetCachePath(std::string path);
+	void EnableCache(bool enable) { Cache.enabled = enable; }
+	void EnableProfiling(bool enable) { Prof.enabled = enable; }
+	//Profile and write a Chrome trace to path when the Device goes away
+	void EnableTrace(std::string path) { Prof.enabled = true; tracePath = path; }
 
     template <typename T>
     void DisplayDeviceInfo(cl_device_id id, cl_device_info name, std::string str);
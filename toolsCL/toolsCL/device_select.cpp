@@ -0,0 +1,203 @@
+#include "device_select.hpp"
+#include "device.hpp"
+#include "timer.hpp"
+#include <stdio.h>
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <regex>
+
+#ifndef CL_DEVICE_NATIVE_VECTOR_WIDTH_FLOAT
+#define CL_DEVICE_NATIVE_VECTOR_WIDTH_FLOAT 0x1039
+#endif
+
+//Weights of the score components; the probe weights only count when
+//the probe ran
+static const double computeWeight = 0.50;
+static const double memoryWeight = 0.15;
+static const double discreteWeight = 0.10;
+static const double bandwidthWeight = 0.15;
+static const double latencyWeight = 0.10;
+
+void EnumerateDevices(cl_platform_id *platforms, cl_uint numPlatforms,
+    std::vector<DeviceCandidate> &candidates) {
+  for (cl_uint p = 0; p < numPlatforms; p++) {
+    cl_uint count = 0;
+    if (clGetDeviceIDs(platforms[p], CL_DEVICE_TYPE_ALL, 0, NULL, &count) != CL_SUCCESS || count == 0)
+      continue;
+    std::vector<cl_device_id> devices(count);
+    clGetDeviceIDs(platforms[p], CL_DEVICE_TYPE_ALL, count, &devices[0], NULL);
+
+    for (cl_uint d = 0; d < count; d++)
+      candidates.push_back(DescribeDevice(platforms[p], devices[d]));
+  }
+}
+
+//The static figures of one device
+DeviceCandidate DescribeDevice(cl_platform_id platform, cl_device_id device) {
+  DeviceCandidate c;
+  c.platform = platform;
+  c.device = device;
+  c.platformName = Device::GetPlatformString(platform, CL_PLATFORM_NAME);
+  c.deviceName = Device::GetDeviceString(device, CL_DEVICE_NAME);
+  clGetDeviceInfo(c.device, CL_DEVICE_TYPE, sizeof(cl_device_type), &c.type, NULL);
+  clGetDeviceInfo(c.device, CL_DEVICE_MAX_COMPUTE_UNITS, sizeof(cl_uint), &c.computeUnits, NULL);
+  clGetDeviceInfo(c.device, CL_DEVICE_MAX_CLOCK_FREQUENCY, sizeof(cl_uint), &c.clockMHz, NULL);
+  clGetDeviceInfo(c.device, CL_DEVICE_NATIVE_VECTOR_WIDTH_FLOAT, sizeof(cl_uint), &c.vectorWidth, NULL);
+  clGetDeviceInfo(c.device, CL_DEVICE_GLOBAL_MEM_SIZE, sizeof(cl_ulong), &c.globalMem, NULL);
+  clGetDeviceInfo(c.device, CL_DEVICE_HOST_UNIFIED_MEMORY, sizeof(cl_bool), &c.unifiedMemory, NULL);
+  if (c.vectorWidth == 0)
+    c.vectorWidth = 1;
+  return c;
+}
+
+//Quick measurement of host->device bandwidth and of the round trip of
+//an empty kernel, in a throw-away context
+bool ProbeDevice(DeviceCandidate &c) {
+  cl_int err = CL_SUCCESS;
+  cl_context_properties props[] = { CL_CONTEXT_PLATFORM, (cl_context_properties) c.platform, 0 };
+  cl_context context = clCreateContext(props, 1, &c.device, NULL, NULL, &err);
+  if (context == NULL)
+    return false;
+  cl_command_queue queue = clCreateCommandQueue(context, c.device, CL_QUEUE_PROFILING_ENABLE, &err);
+  const size_t bytes = 32 << 20;
+  cl_mem buffer = clCreateBuffer(context, CL_MEM_READ_WRITE, bytes, NULL, &err);
+  std::vector<char> host(bytes, 1);
+  const char *source = "__kernel void probe_noop(__global int *p) { }";
+  cl_program program = clCreateProgramWithSource(context, 1, &source, NULL, &err);
+  cl_kernel kernel = NULL;
+  if (program != NULL && clBuildProgram(program, 1, &c.device, "", NULL, NULL) == CL_SUCCESS)
+    kernel = clCreateKernel(program, "probe_noop", &err);
+
+  bool ok = queue != NULL && buffer != NULL && kernel != NULL;
+  if (ok) {
+    //bandwidth: best of three timed writes
+    double best = 0;
+    for (int i = 0; i < 3; i++) {
+      cl_event event = NULL;
+      clEnqueueWriteBuffer(queue, buffer, CL_TRUE, 0, bytes, &host[0], 0, NULL, &event);
+      cl_ulong start = 0, end = 0;
+      clGetEventProfilingInfo(event, CL_PROFILING_COMMAND_START, sizeof(cl_ulong), &start, NULL);
+      clGetEventProfilingInfo(event, CL_PROFILING_COMMAND_END, sizeof(cl_ulong), &end, NULL);
+      clReleaseEvent(event);
+      if (end > start)
+        best = std::max(best, (double) bytes / (double) (end - start));
+    }
+    c.bandwidthGBs = best;  //bytes per ns == GB/s
+
+    //latency: host view of enqueue + finish of an empty launch
+    size_t global = 1;
+    clSetKernelArg(kernel, 0, sizeof(cl_mem), &buffer);
+    clEnqueueNDRangeKernel(queue, kernel, 1, NULL, &global, NULL, 0, NULL, NULL);
+    clFinish(queue);
+    const int launches = 20;
+    Timer timer;
+    for (int i = 0; i < launches; i++) {
+      clEnqueueNDRangeKernel(queue, kernel, 1, NULL, &global, NULL, 0, NULL, NULL);
+      clFinish(queue);
+    }
+    c.launchUs = timer.MilliSeconds() * 1000.0 / launches;
+  }
+
+  if (kernel != NULL) clReleaseKernel(kernel);
+  if (program != NULL) clReleaseProgram(program);
+  if (buffer != NULL) clReleaseMemObject(buffer);
+  if (queue != NULL) clReleaseCommandQueue(queue);
+  clReleaseContext(context);
+  return ok;
+}
+
+//Rough peak throughput: compute units x clock x float lanes per unit.
+//A GPU compute unit is counted as 32 lanes wide, a CPU core as its
+//native vector width.
+double ComputeEstimate(const DeviceCandidate &c) {
+  double lanes = (c.type & CL_DEVICE_TYPE_GPU) ? 32.0 : (double) c.vectorWidth;
+  return c.computeUnits * (c.clockMHz / 1000.0) * lanes;
+}
+
+void ScoreDevices(std::vector<DeviceCandidate> &candidates) {
+  double maxCompute = 0, maxMemory = 0, maxBandwidth = 0, minLatency = 0;
+  for (size_t i = 0; i < candidates.size(); i++) {
+    const DeviceCandidate &c = candidates[i];
+    maxCompute = std::max(maxCompute, ComputeEstimate(c));
+    maxMemory = std::max(maxMemory, (double) c.globalMem);
+    maxBandwidth = std::max(maxBandwidth, c.bandwidthGBs);
+    if (c.launchUs > 0 && (minLatency == 0 || c.launchUs < minLatency))
+      minLatency = c.launchUs;
+  }
+
+  for (size_t i = 0; i < candidates.size(); i++) {
+    DeviceCandidate &c = candidates[i];
+    c.computeScore = maxCompute > 0 ? ComputeEstimate(c) / maxCompute : 0;
+    c.memoryScore = maxMemory > 0 ? c.globalMem / maxMemory : 0;
+    //a discrete device has its own memory bus
+    c.discreteScore = c.unifiedMemory ? 0.0 : 1.0;
+    c.bandwidthScore = maxBandwidth > 0 ? c.bandwidthGBs / maxBandwidth : 0;
+    c.latencyScore = c.launchUs > 0 ? minLatency / c.launchUs : 0;
+
+    double weight = computeWeight + memoryWeight + discreteWeight;
+    double score = computeWeight * c.computeScore + memoryWeight * c.memoryScore
+        + discreteWeight * c.discreteScore;
+    if (maxBandwidth > 0) {
+      weight += bandwidthWeight + latencyWeight;
+      score += bandwidthWeight * c.bandwidthScore + latencyWeight * c.latencyScore;
+    }
+    c.score = score / weight;
+  }
+}
+
+//Index of the best candidate under the policy, -1 if none qualifies
+int SelectDevice(const std::vector<DeviceCandidate> &candidates,
+    DevicePolicy policy, const std::string &pattern) {
+  std::regex nameRegex;
+  if (policy == POLICY_BY_NAME) {
+    try {
+      nameRegex = std::regex(pattern, std::regex::icase);
+    } catch (const std::regex_error &) {
+      std::cout << "Err: invalid device name pattern " << pattern << std::endl;
+      return -1;
+    }
+  }
+
+  int best = -1;
+  for (size_t i = 0; i < candidates.size(); i++) {
+    const DeviceCandidate &c = candidates[i];
+    if (policy == POLICY_CPU_ONLY && !(c.type & CL_DEVICE_TYPE_CPU))
+      continue;
+    if (policy == POLICY_UNIFIED && !c.unifiedMemory)
+      continue;
+    if (policy == POLICY_BY_NAME && !std::regex_search(c.deviceName, nameRegex)
+        && !std::regex_search(c.platformName, nameRegex))
+      continue;
+    if (best < 0) {
+      best = (int) i;
+      continue;
+    }
+    const DeviceCandidate &b = candidates[best];
+    bool better = (policy == POLICY_MOST_MEMORY)
+        ? (c.globalMem > b.globalMem || (c.globalMem == b.globalMem && c.score > b.score))
+        : c.score > b.score;
+    if (better)
+      best = (int) i;
+  }
+  return best;
+}
+
+void DisplayCandidates(const std::vector<DeviceCandidate> &candidates, int selected) {
+  std::cout << "Devices (score = compute/memory/discrete/bandwidth/latency):" << std::endl;
+  for (size_t i = 0; i < candidates.size(); i++) {
+    const DeviceCandidate &c = candidates[i];
+    std::cout << ((int) i == selected ? " * " : "   ") << i << "\t" << c.deviceName
+        << " [" << c.platformName << "]" << std::endl;
+    std::cout << "\t" << c.computeUnits << " CU @ " << c.clockMHz << " MHz, "
+        << (c.globalMem >> 20) << " MB" << (c.unifiedMemory ? ", unified memory" : "");
+    if (c.bandwidthGBs > 0)
+      std::cout << ", " << c.bandwidthGBs << " GB/s, launch " << c.launchUs << " us";
+    std::cout << std::endl;
+    std::cout << std::fixed << std::setprecision(2) << "\tscore " << c.score << " = "
+        << c.computeScore << "/" << c.memoryScore << "/" << c.discreteScore << "/"
+        << c.bandwidthScore << "/" << c.latencyScore << std::endl;
+    std::cout.unsetf(std::ios::floatfield);
+    std::cout << std::setprecision(6);
+  }
+}
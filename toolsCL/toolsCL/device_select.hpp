@@ -0,0 +1,57 @@
+#ifndef DEVICE_SELECT_HPP
+#define DEVICE_SELECT_HPP
+#include <string>
+#include <vector>
+#include <CL/cl.h>
+
+//How Device::Init picks a device when no index is given
+enum DevicePolicy {
+  POLICY_FASTEST,      //highest total score
+  POLICY_MOST_MEMORY,  //largest global memory
+  POLICY_CPU_ONLY,     //best CL_DEVICE_TYPE_CPU device
+  POLICY_UNIFIED,      //best device sharing memory with the host (iGPU, CPU), for zero-copy
+  POLICY_BY_NAME       //best device whose device or platform name matches a regex
+};
+
+//One device of one platform, with the figures it was ranked on.
+//Every *Score is normalized to the best candidate (0..1).
+struct DeviceCandidate {
+  DeviceCandidate()
+      : platform(NULL), device(NULL), type(0), computeUnits(0), clockMHz(0),
+        vectorWidth(1), globalMem(0), unifiedMemory(CL_FALSE), bandwidthGBs(0),
+        launchUs(0), computeScore(0), memoryScore(0), discreteScore(0),
+        bandwidthScore(0), latencyScore(0), score(0) {
+  }
+  cl_platform_id platform;
+  cl_device_id device;
+  std::string platformName;
+  std::string deviceName;
+  cl_device_type type;
+  cl_uint computeUnits;
+  cl_uint clockMHz;
+  cl_uint vectorWidth;   //CL_DEVICE_NATIVE_VECTOR_WIDTH_FLOAT
+  cl_ulong globalMem;
+  cl_bool unifiedMemory;
+
+  double bandwidthGBs;   //host->device write bandwidth, 0 if not probed
+  double launchUs;       //empty kernel enqueue-to-finish, 0 if not probed
+
+  double computeScore;
+  double memoryScore;
+  double discreteScore;
+  double bandwidthScore;
+  double latencyScore;
+  double score;          //weighted sum of the above
+};
+
+void EnumerateDevices(cl_platform_id *platforms, cl_uint numPlatforms,
+    std::vector<DeviceCandidate> &candidates);
+DeviceCandidate DescribeDevice(cl_platform_id platform, cl_device_id device);
+bool ProbeDevice(DeviceCandidate &candidate);
+double ComputeEstimate(const DeviceCandidate &candidate);
+void ScoreDevices(std::vector<DeviceCandidate> &candidates);
+int SelectDevice(const std::vector<DeviceCandidate> &candidates,
+    DevicePolicy policy, const std::string &pattern);
+void DisplayCandidates(const std::vector<DeviceCandidate> &candidates, int selected);
+
+#endif //DEVICE_SELECT_HPP
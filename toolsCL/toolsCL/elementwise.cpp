@@ -0,0 +1,75 @@
+#include "elementwise.hpp"
+#include "device.hpp"
+
+Elementwise::Elementwise(Device &device)
+    : queue(device.CommandQueue), localSize(0), groupsPerUnit(8), forceWidth(0), device(device),
+      prof(device.Prof), generation(device.generation), computeUnits(1), maxLocalSize(1) {
+  clGetDeviceInfo(device.pDevices[0], CL_DEVICE_MAX_COMPUTE_UNITS, sizeof(cl_uint), &computeUnits, NULL);
+  clGetDeviceInfo(device.pDevices[0], CL_DEVICE_MAX_WORK_GROUP_SIZE, sizeof(size_t), &maxLocalSize, NULL);
+  if (computeUnits == 0)
+    computeUnits = 1;
+}
+
+int Elementwise::Width(cl_device_info preferred) {
+  if (forceWidth != 0)
+    return forceWidth >= 8 ? 8 : (forceWidth >= 2 ? 4 : 1);
+  std::map<cl_device_info, int>::iterator it = widths.find(preferred);
+  if (it != widths.end())
+    return it->second;
+  cl_uint width = 1;
+  clGetDeviceInfo(device.pDevices[0], preferred, sizeof(cl_uint), &width, NULL);
+  //a preferred width of 0 means the type is not supported (double)
+  int picked = width >= 8 ? 8 : (width >= 2 ? 4 : 1);
+  widths[preferred] = picked;
+  return picked;
+}
+
+NDRange Elementwise::Grid(size_t n, int width, size_t kernelMax) const {
+  //without a local size the grid is counted in the kernel's largest
+  //groups, which every tuned size divides
+  size_t fixed = localSize != 0 ? localSize : kernelMax;
+  size_t local = fixed != 0 && fixed < maxLocalSize ? fixed : maxLocalSize;
+  if (kernelMax != 0 && local > kernelMax)
+    local = kernelMax;
+  if (local == 0)
+    local = 1;
+  size_t items = (n + width - 1) / width;
+  size_t groups = (items + local - 1) / local;
+  size_t resident = (size_t) computeUnits * groupsPerUnit;
+  if (groups > resident)
+    groups = resident;
+  if (groups == 0)
+    groups = 1;
+  if (localSize == 0)
+    return NDRange(groups * local);
+  return NDRange(groups * local).Local(local);
+}
+
+cl_int Elementwise::LaunchTuned(cl_kernel kernel, const NDRange &range, bool tune) {
+  return device.LaunchTuned(queue, kernel, range, tune);
+}
+
+bool Elementwise::Fits(const char *op, size_t n, const NDRange &range) const {
+  if (n > CL_UINT_MAX || range.global[0] > CL_UINT_MAX - n) {
+    std::cout << "Err: Elementwise " << op << " of " << n << " elements, the kernels index with uint up to "
+        << CL_UINT_MAX << " - " << range.global[0] << " work-items" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+cl_kernel Elementwise::Kernel(const char *op, int width, const char *type, size_t &kernelMax) {
+  std::string name = std::string(op) + "_v" + (char) ('0' + width) + "_" + type;
+  cl_kernel kernel = device.GetKernel(name);
+  if (kernel == NULL)
+    return NULL;
+  //can be below the device limit (registers, local memory)
+  std::map<std::string, size_t>::iterator it = kernelMaxes.find(name);
+  if (it == kernelMaxes.end()) {
+    size_t size = 0;
+    clGetKernelWorkGroupInfo(kernel, device.pDevices[0], CL_KERNEL_WORK_GROUP_SIZE, sizeof(size_t), &size, NULL);
+    it = kernelMaxes.insert(std::make_pair(name, size)).first;
+  }
+  kernelMax = it->second;
+  return kernel;
+}
@@ -0,0 +1,99 @@
+#ifndef ELEMENTWISE_HPP
+#define ELEMENTWISE_HPP
+#include <string>
+#include <map>
+#include <CL/cl.h>
+#include "kernel_types.hpp"
+#include "launch.hpp"
+#include "profiler.hpp"
+
+class Device;
+
+//Elementwise kernels of kernelGen/cl_kernels/elementwise.cl for arrays of
+//any length. The vector width comes from the device's preferred width of
+//the element type: 1, 4 (preferred 2 or 4) or 8 (8 and up). The grid is
+//groupsPerUnit work-groups of the kernel's largest size per compute unit,
+//or fewer for short arrays, and every work-item strides over the array,
+//tail included. The local size dividing that grid is the device Tuner's;
+//Axpy, which updates y in place and cannot be timed by rerunning, only
+//takes a size already tuned.
+//Run from the thread that owns the Elementwise.
+class Elementwise {
+  public:
+    explicit Elementwise(Device &device);
+
+    //out = in * alpha
+    template <typename T>
+    cl_int Scale(cl_mem in, cl_mem out, T alpha, size_t n) {
+      return Enqueue<T>("scale", n, true, in, out, alpha, (cl_uint) n);
+    }
+    //out = in * 2, mul2 for any n
+    template <typename T>
+    cl_int Mul2(cl_mem in, cl_mem out, size_t n) {
+      return Scale<T>(in, out, (T) 2, n);
+    }
+    //out = a + b
+    template <typename T>
+    cl_int Add(cl_mem a, cl_mem b, cl_mem out, size_t n) {
+      return Enqueue<T>("add", n, true, a, b, out, (cl_uint) n);
+    }
+    //y = alpha * x + y
+    template <typename T>
+    cl_int Axpy(T alpha, cl_mem x, cl_mem y, size_t n) {
+      return Enqueue<T>("axpy", n, false, alpha, x, y, (cl_uint) n);
+    }
+
+    //Vector width used for T
+    template <typename T>
+    int VectorWidth() {
+      return Width(KernelType<T>::PreferredWidth());
+    }
+    //Work-items for n elements of width-wide vectors, in groups of
+    //localSize or, when that is 0, of kernelMax (the kernel's
+    //CL_KERNEL_WORK_GROUP_SIZE) with no local size set
+    NDRange Grid(size_t n, int width, size_t kernelMax = 0) const;
+
+    cl_command_queue queue;  //CommandQueue unless set
+    size_t localSize;        //work-group size, capped by the device; 0 for the Tuner's
+    size_t groupsPerUnit;    //work-groups per compute unit in flight
+    int forceWidth;          //1, 4 or 8 instead of the preferred width, 0 for preferred
+
+  private:
+    //tune: the kernel may be rerun to time local sizes
+    template <typename T, typename... Args>
+    cl_int Enqueue(const char *op, size_t n, bool tune, const Args &... args) {
+      if (n == 0)
+        return CL_SUCCESS;
+      int width = VectorWidth<T>();
+      size_t kernelMax = 0;
+      cl_kernel kernel = Kernel(op, width, KernelType<T>::Name(), kernelMax);
+      if (kernel == NULL)
+        return CL_INVALID_KERNEL;
+      NDRange range = Grid(n, width, kernelMax);
+      if (!Fits(op, n, range))
+        return CL_INVALID_VALUE;
+      if (!range.hasLocal) {
+        cl_int err = SetKernelArgs(generation, kernel, args...);
+        return err != CL_SUCCESS ? err : LaunchTuned(kernel, range, tune);
+      }
+      ProfileEvent pe(prof, kernel);
+      return LaunchKernel(queue, generation, kernel, range, pe.Out(), args...);
+    }
+    cl_int LaunchTuned(cl_kernel kernel, const NDRange &range, bool tune);
+    //op_v<width>_<type> and its work-group limit
+    cl_kernel Kernel(const char *op, int width, const char *type, size_t &kernelMax);
+    //Whether the uint index of the grid-stride loops reaches n without
+    //wrapping: the last step goes up to n - 1 + the global size
+    bool Fits(const char *op, size_t n, const NDRange &range) const;
+    int Width(cl_device_info preferred);
+
+    Device &device;
+    Profiler &prof;
+    unsigned long long generation;
+    cl_uint computeUnits;
+    size_t maxLocalSize;
+    std::map<cl_device_info, int> widths;  //preferred width by query
+    std::map<std::string, size_t> kernelMaxes;  //CL_KERNEL_WORK_GROUP_SIZE by kernel name
+};
+
+#endif //ELEMENTWISE_HPP
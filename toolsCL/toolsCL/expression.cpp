@@ -0,0 +1,91 @@
+#include "expression.hpp"
+#include "device.hpp"
+#include <sstream>
+
+void ExprBuilder::Buffer(cl_mem mem, size_t elements) {
+  if (count == 0)
+    count = elements;
+  else if (count != elements)
+    mismatch = true;
+  //an array used twice is one argument, read once per element
+  size_t index = 0;
+  while (index < buffers.size() && buffers[index] != mem)
+    index++;
+  if (index == buffers.size())
+    buffers.push_back(mem);
+  std::ostringstream name;
+  name << "a" << index << "[i]";
+  code += name.str();
+}
+
+void ExprBuilder::Scalar(cl_float value) {
+  std::ostringstream name;
+  name << "s" << scalars.size();
+  scalars.push_back(value);
+  code += name.str();
+}
+
+std::string ExpressionEngine::KernelSource(const ExprBuilder &b) {
+  std::ostringstream source;
+  source << "__kernel void fused_expression(__global float *out";
+  for (size_t i = 0; i < b.buffers.size(); i++)
+    source << ", __global const float *a" << i;
+  for (size_t i = 0; i < b.scalars.size(); i++)
+    source << ", float s" << i;
+  source << ")\n{\n"
+      << "    size_t i = get_global_id(0);\n"
+      << "    out[i] = " << b.code << ";\n"
+      << "}\n";
+  return source.str();
+}
+
+ExpressionEngine::~ExpressionEngine() {
+  for (std::map<std::string, cl_kernel>::iterator it = kernels.begin(); it != kernels.end(); ++it) {
+    ForgetKernelArgs(device.generation, it->second);
+    clReleaseKernel(it->second);
+  }
+}
+
+cl_int ExpressionEngine::Run(const DeviceArray &out, const ExprBuilder &b) {
+  if (b.mismatch || (b.count != 0 && b.count != out.Count())) {
+    std::cout << "Err: expression over arrays of different lengths: " << b.code << std::endl;
+    return CL_INVALID_VALUE;
+  }
+  if (out.Count() == 0)
+    return CL_SUCCESS;
+
+  std::string source = KernelSource(b);
+  std::map<std::string, cl_kernel>::iterator it = kernels.find(source);
+  if (it == kernels.end()) {
+    cl_program program = device.GetGeneratedProgram("fused " + b.code, source);
+    if (program == NULL)
+      return CL_BUILD_PROGRAM_FAILURE;
+    cl_int err = CL_SUCCESS;
+    cl_kernel kernel = clCreateKernel(program, "fused_expression", &err);
+    OCL_CHECK(err, "ExpressionEngine: fused_expression");
+    if (kernel == NULL)
+      return err;
+    it = kernels.insert(std::make_pair(source, kernel)).first;
+  }
+  cl_kernel kernel = it->second;
+
+  //the argument list is only known at run time: the cached setter, no type
+  //checks; buffers are set every launch, as Launch does
+  KernelArgState &state = GetKernelArgState(device.generation, kernel);
+  if (!state.described && !DescribeKernelArgs(kernel, state))
+    return CL_INVALID_KERNEL;
+  cl_uint index = 0;
+  cl_mem dst = out.Get();
+  cl_int err = SetKernelArgCached(kernel, state, index++, sizeof(cl_mem), &dst, false);
+  for (size_t i = 0; i < b.buffers.size() && err == CL_SUCCESS; i++)
+    err = SetKernelArgCached(kernel, state, index++, sizeof(cl_mem), &b.buffers[i], false);
+  for (size_t i = 0; i < b.scalars.size() && err == CL_SUCCESS; i++)
+    err = SetKernelArgCached(kernel, state, index++, sizeof(cl_float), &b.scalars[i]);
+  if (err != CL_SUCCESS)
+    return err;
+
+  size_t global = out.Count();
+  ProfileEvent pe(device.Prof, kernel);
+  launches++;
+  return clEnqueueNDRangeKernel(device.CommandQueue, kernel, 1, NULL, &global, NULL, 0, NULL, pe.Out());
+}
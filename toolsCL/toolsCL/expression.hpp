@@ -0,0 +1,189 @@
+#ifndef EXPRESSION_HPP
+#define EXPRESSION_HPP
+#include <string>
+#include <vector>
+#include <map>
+#include <CL/cl.h>
+
+class Device;
+class ExpressionEngine;
+
+//What an expression compiles to: the OpenCL text of one element and the
+//buffers and scalars it reads, in argument order. Scalars are arguments,
+//not literals, so a * 2 and a * 3 share a kernel.
+struct ExprBuilder {
+  ExprBuilder() : count(0), mismatch(false) {}
+  std::string code;
+  std::vector<cl_mem> buffers;
+  std::vector<cl_float> scalars;
+  size_t count;    //elements of every array read
+  bool mismatch;   //arrays of different lengths
+
+  void Buffer(cl_mem mem, size_t elements);
+  void Scalar(cl_float value);
+};
+
+template <typename Derived> struct Expr {
+  const Derived &Self() const { return static_cast<const Derived &>(*this); }
+};
+
+struct ScalarExpr : Expr<ScalarExpr> {
+  explicit ScalarExpr(cl_float value) : value(value) {}
+  cl_float value;
+  void Emit(ExprBuilder &b) const { b.Scalar(value); }
+};
+
+template <typename E>
+struct UnaryExpr : Expr<UnaryExpr<E> > {
+  UnaryExpr(const char *fn, const E &e) : fn(fn), e(e) {}
+  const char *fn;
+  E e;
+  void Emit(ExprBuilder &b) const {
+    b.code += fn;
+    b.code += "(";
+    e.Emit(b);
+    b.code += ")";
+  }
+};
+
+//An operator (a + b) or a builtin of two arguments (fmax(a, b))
+template <typename L, typename R>
+struct BinaryExpr : Expr<BinaryExpr<L, R> > {
+  BinaryExpr(const char *op, bool call, const L &l, const R &r) : op(op), call(call), l(l), r(r) {}
+  const char *op;
+  bool call;
+  L l;
+  R r;
+  void Emit(ExprBuilder &b) const {
+    b.code += call ? std::string(op) + "(" : std::string("(");
+    l.Emit(b);
+    b.code += call ? std::string(", ") : std::string(" ") + op + " ";
+    r.Emit(b);
+    b.code += ")";
+  }
+};
+
+//count floats in a device buffer. Assigning an expression to it runs the
+//whole expression as one kernel: out = a * 2 + sqrt(b) - c;
+//Copies share the buffer; assigning one array to another copies elements.
+class DeviceArray : public Expr<DeviceArray> {
+  public:
+    DeviceArray(ExpressionEngine &engine, cl_mem mem, size_t count)
+        : engine(&engine), mem(mem), count(count) {}
+    DeviceArray(const DeviceArray &other) : engine(other.engine), mem(other.mem), count(other.count) {}
+
+    template <typename E>
+    DeviceArray &operator=(const Expr<E> &expr);
+    DeviceArray &operator=(const DeviceArray &other);
+
+    cl_mem Get() const { return mem; }
+    size_t Count() const { return count; }
+    void Emit(ExprBuilder &b) const { b.Buffer(mem, count); }
+
+  private:
+    ExpressionEngine *engine;
+    cl_mem mem;
+    size_t count;
+};
+
+//Fuses elementwise float expressions into one kernel each: every input is
+//read once and the output written once, however many operations the
+//expression chains. The kernel of an expression shape is generated and
+//built on its first use; the program is shared through the Device and
+//the on-disk cache, the kernel is kept here. Run from the thread that
+//owns the engine.
+class ExpressionEngine {
+  public:
+    explicit ExpressionEngine(Device &device) : device(device), launches(0) {}
+    ~ExpressionEngine();
+
+    DeviceArray Array(cl_mem mem, size_t count) { return DeviceArray(*this, mem, count); }
+    template <typename E>
+    cl_int Assign(const DeviceArray &out, const Expr<E> &expr) {
+      ExprBuilder b;
+      expr.Self().Emit(b);
+      return Run(out, b);
+    }
+    cl_int Run(const DeviceArray &out, const ExprBuilder &b);
+    //The fused kernel of an expression, named fused_expression
+    static std::string KernelSource(const ExprBuilder &b);
+    size_t Shapes() const { return kernels.size(); }
+    size_t Launches() const { return launches; }
+
+  private:
+    ExpressionEngine(const ExpressionEngine &);
+    ExpressionEngine &operator=(const ExpressionEngine &);
+
+    Device &device;
+    std::map<std::string, cl_kernel> kernels;  //by kernel source
+    size_t launches;
+};
+
+template <typename E>
+DeviceArray &DeviceArray::operator=(const Expr<E> &expr) {
+  engine->Assign(*this, expr);
+  return *this;
+}
+
+inline DeviceArray &DeviceArray::operator=(const DeviceArray &other) {
+  engine->Assign(*this, other);
+  return *this;
+}
+
+#define EXPR_OPERATOR(op) \
+  template <typename L, typename R> \
+  BinaryExpr<L, R> operator op(const Expr<L> &l, const Expr<R> &r) { \
+    return BinaryExpr<L, R>(#op, false, l.Self(), r.Self()); \
+  } \
+  template <typename L> \
+  BinaryExpr<L, ScalarExpr> operator op(const Expr<L> &l, cl_float r) { \
+    return BinaryExpr<L, ScalarExpr>(#op, false, l.Self(), ScalarExpr(r)); \
+  } \
+  template <typename R> \
+  BinaryExpr<ScalarExpr, R> operator op(cl_float l, const Expr<R> &r) { \
+    return BinaryExpr<ScalarExpr, R>(#op, false, ScalarExpr(l), r.Self()); \
+  }
+EXPR_OPERATOR(+)
+EXPR_OPERATOR(-)
+EXPR_OPERATOR(*)
+EXPR_OPERATOR(/)
+#undef EXPR_OPERATOR
+
+#define EXPR_FUNCTION2(fn) \
+  template <typename L, typename R> \
+  BinaryExpr<L, R> fn(const Expr<L> &l, const Expr<R> &r) { \
+    return BinaryExpr<L, R>(#fn, true, l.Self(), r.Self()); \
+  } \
+  template <typename L> \
+  BinaryExpr<L, ScalarExpr> fn(const Expr<L> &l, cl_float r) { \
+    return BinaryExpr<L, ScalarExpr>(#fn, true, l.Self(), ScalarExpr(r)); \
+  } \
+  template <typename R> \
+  BinaryExpr<ScalarExpr, R> fn(cl_float l, const Expr<R> &r) { \
+    return BinaryExpr<ScalarExpr, R>(#fn, true, ScalarExpr(l), r.Self()); \
+  }
+EXPR_FUNCTION2(fmin)
+EXPR_FUNCTION2(fmax)
+EXPR_FUNCTION2(pow)
+#undef EXPR_FUNCTION2
+
+#define EXPR_FUNCTION(fn) \
+  template <typename E> \
+  UnaryExpr<E> fn(const Expr<E> &e) { \
+    return UnaryExpr<E>(#fn, e.Self()); \
+  }
+EXPR_FUNCTION(sqrt)
+EXPR_FUNCTION(rsqrt)
+EXPR_FUNCTION(exp)
+EXPR_FUNCTION(log)
+EXPR_FUNCTION(sin)
+EXPR_FUNCTION(cos)
+EXPR_FUNCTION(fabs)
+#undef EXPR_FUNCTION
+
+template <typename E>
+UnaryExpr<E> operator-(const Expr<E> &e) {
+  return UnaryExpr<E>("-", e.Self());
+}
+
+#endif //EXPRESSION_HPP
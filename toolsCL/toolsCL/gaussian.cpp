@@ -0,0 +1,91 @@
+#include "gaussian.hpp"
+#include "device.hpp"
+#include <math.h>
+
+SeparableGaussian::SeparableGaussian(Device &device, int radius, float sigma)
+    : tileWidth(16), tileHeight(16), precision(STORAGE_FLOAT), device(device), radius(0), weights(NULL),
+      scratch(NULL), scratchWidth(0), scratchHeight(0), scratchPrecision(STORAGE_FLOAT) {
+  std::vector<float> taps;
+  Weights(radius, sigma, taps);
+  SetWeights(taps);
+}
+
+SeparableGaussian::~SeparableGaussian() {
+  if (weights != NULL)
+    clReleaseMemObject(weights);
+  if (scratch != NULL)
+    clReleaseMemObject(scratch);
+}
+
+void SeparableGaussian::Weights(int radius, float sigma, std::vector<float> &taps) {
+  if (radius < 0)
+    radius = 0;
+  if (sigma <= 0)
+    sigma = 0.3f * (radius - 1) + 0.8f;
+  taps.resize(2 * radius + 1);
+  double sum = 0;
+  for (int i = -radius; i <= radius; i++) {
+    taps[i + radius] = (float) exp(-(i * i) / (2.0 * sigma * sigma));
+    sum += taps[i + radius];
+  }
+  for (size_t i = 0; i < taps.size(); i++)
+    taps[i] = (float) (taps[i] / sum);
+}
+
+bool SeparableGaussian::SetWeights(const std::vector<float> &taps) {
+  if (taps.size() % 2 == 0) {
+    std::cout << "Err: SeparableGaussian needs an odd number of weights" << std::endl;
+    return false;
+  }
+  cl_int err = CL_SUCCESS;
+  cl_mem mem = clCreateBuffer(device.Context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+      sizeof(float) * taps.size(), (void *) &taps[0], &err);
+  OCL_CHECK(err, "SeparableGaussian: weights");
+  if (mem == NULL)
+    return false;
+  if (weights != NULL)
+    clReleaseMemObject(weights);
+  weights = mem;
+  radius = (int) taps.size() / 2;
+  return true;
+}
+
+cl_int SeparableGaussian::Run(cl_mem src, cl_mem dst, int width, int height, cl_event *event) {
+  cl_kernel rows = device.GetKernel("gaussian_rows");
+  cl_kernel cols = device.GetKernel("gaussian_cols");
+  if (rows == NULL || cols == NULL || weights == NULL)
+    return CL_INVALID_KERNEL;
+
+  if (scratch == NULL || scratchWidth != width || scratchHeight != height || scratchPrecision != precision) {
+    if (scratch != NULL)
+      clReleaseMemObject(scratch);
+    StoragePrecision wanted = precision;
+    if (wanted == STORAGE_HALF && !HalfImageSupport(device.Context))
+      wanted = STORAGE_FLOAT;
+    cl_image_format format;
+    format.image_channel_order = CL_RGBA;
+    format.image_channel_data_type = StorageChannelType(wanted);
+    cl_int err = CL_SUCCESS;
+    scratch = clCreateImage2D(device.Context, CL_MEM_READ_WRITE, &format, width, height, 0, NULL, &err);
+    OCL_CHECK(err, "SeparableGaussian: scratch image");
+    if (scratch == NULL)
+      return err;
+    scratchWidth = width;
+    scratchHeight = height;
+    scratchPrecision = precision;
+  }
+
+  //every work-item of a partial group still loads its part of the tile
+  size_t w = ((width + tileWidth - 1) / tileWidth) * tileWidth;
+  size_t h = ((height + tileHeight - 1) / tileHeight) * tileHeight;
+  NDRange range = NDRange(w, h).Local(tileWidth, tileHeight);
+  size_t rowTile = (tileWidth + 2 * radius) * tileHeight * sizeof(cl_float4);
+  size_t colTile = tileWidth * (tileHeight + 2 * radius) * sizeof(cl_float4);
+  cl_int err = device.Launch(rows, range, src, scratch, weights, (cl_int) radius, (cl_int) width,
+      (cl_int) height, LocalMemory(rowTile));
+  if (err != CL_SUCCESS)
+    return err;
+  ProfileEvent pe(device.Prof, cols, event);
+  return LaunchKernel(device.CommandQueue, device.generation, cols, range, pe.Out(), scratch, dst, weights,
+      (cl_int) radius, (cl_int) width, (cl_int) height, LocalMemory(colTile));
+}
@@ -0,0 +1,43 @@
+#ifndef GAUSSIAN_HPP
+#define GAUSSIAN_HPP
+#include <vector>
+#include <CL/cl.h>
+#include "half_storage.hpp"
+
+class Device;
+
+//Separable Gaussian blur of RGBA images of any radius: a row pass into
+//a float or half intermediate image, then a column pass into dst, both through
+//local-memory tiles (kernelGen/cl_kernels/gaussian_separable.cl)
+class SeparableGaussian {
+  public:
+    //sigma <= 0 derives it from the radius like OpenCV: 0.3 * (radius - 1) + 0.8
+    SeparableGaussian(Device &device, int radius, float sigma = 0);
+    ~SeparableGaussian();
+
+    //2*radius+1 normalized taps
+    static void Weights(int radius, float sigma, std::vector<float> &weights);
+    //Replace the taps, odd count, e.g. { 0.25f, 0.5f, 0.25f }
+    bool SetWeights(const std::vector<float> &weights);
+    int Radius() const { return radius; }
+    //src and dst are width x height images; dst may not be src
+    cl_int Run(cl_mem src, cl_mem dst, int width, int height, cl_event *event = NULL);
+
+    size_t tileWidth;   //work-group size, set before Run
+    size_t tileHeight;
+    StoragePrecision precision;  //of the intermediate image; float where half images are unsupported
+
+  private:
+    SeparableGaussian(const SeparableGaussian &);
+    SeparableGaussian &operator=(const SeparableGaussian &);
+
+    Device &device;
+    int radius;
+    cl_mem weights;
+    cl_mem scratch;     //row pass output, CL_RGBA / CL_FLOAT or CL_HALF_FLOAT
+    int scratchWidth;
+    int scratchHeight;
+    StoragePrecision scratchPrecision;  //precision asked for when scratch was created
+};
+
+#endif //GAUSSIAN_HPP
@@ -0,0 +1,175 @@
+#include "half_storage.hpp"
+#include "device.hpp"
+#include <string.h>
+#include <math.h>
+#include <vector>
+
+cl_half FloatToHalf(float value) {
+  cl_uint f;
+  memcpy(&f, &value, sizeof(f));
+  cl_uint sign = (f >> 16) & 0x8000;
+  cl_uint bits = f & 0x7fffffff;
+  if (bits >= 0x7f800000)  //inf, nan keeps a quiet payload
+    return (cl_half) (sign | 0x7c00 | (bits > 0x7f800000 ? 0x200 : 0));
+  if (bits >= 0x47800000)  //2^16 and up
+    return (cl_half) (sign | 0x7c00);
+  if (bits < 0x38800000) {
+    //below 2^-14: a denormal, mantissa in units of 2^-24
+    int shift = 126 - (int) (bits >> 23);
+    if (shift > 24)
+      return (cl_half) sign;
+    cl_uint m = (bits & 0x7fffff) | 0x800000;
+    cl_uint h = m >> shift;
+    cl_uint rest = m & ((1u << shift) - 1);
+    cl_uint halfway = 1u << (shift - 1);
+    if (rest > halfway || (rest == halfway && (h & 1)))
+      h++;
+    return (cl_half) (sign | h);
+  }
+  //rebias the exponent from 127 to 15; a carry of the rounding moves
+  //into the exponent, up to infinity at 65520
+  cl_uint h = (bits - 0x38000000) >> 13;
+  cl_uint rest = bits & 0x1fff;
+  if (rest > 0x1000 || (rest == 0x1000 && (h & 1)))
+    h++;
+  return (cl_half) (sign | h);
+}
+
+float HalfToFloat(cl_half value) {
+  cl_uint sign = (cl_uint) (value & 0x8000) << 16;
+  cl_uint exponent = (value >> 10) & 0x1f;
+  cl_uint mantissa = value & 0x3ff;
+  cl_uint f;
+  if (exponent == 0) {
+    float denormal = ldexpf((float) mantissa, -24);
+    return sign ? -denormal : denormal;
+  }
+  if (exponent == 31)
+    f = sign | 0x7f800000 | (mantissa << 13);
+  else
+    f = sign | ((exponent + 112) << 23) | (mantissa << 13);
+  float result;
+  memcpy(&result, &f, sizeof(result));
+  return result;
+}
+
+void FloatToHalf(const float *src, cl_half *dst, size_t count) {
+  for (size_t i = 0; i < count; i++)
+    dst[i] = FloatToHalf(src[i]);
+}
+
+void HalfToFloat(const cl_half *src, float *dst, size_t count) {
+  for (size_t i = 0; i < count; i++)
+    dst[i] = HalfToFloat(src[i]);
+}
+
+size_t StorageSize(StoragePrecision precision) {
+  return precision == STORAGE_HALF ? sizeof(cl_half) : sizeof(cl_float);
+}
+
+cl_channel_type StorageChannelType(StoragePrecision precision) {
+  return precision == STORAGE_HALF ? CL_HALF_FLOAT : CL_FLOAT;
+}
+
+bool HalfImageSupport(cl_context context, cl_channel_order order, cl_mem_flags flags) {
+  cl_uint num = 0;
+  if (clGetSupportedImageFormats(context, flags, CL_MEM_OBJECT_IMAGE2D, 0, NULL, &num) != CL_SUCCESS || num == 0)
+    return false;
+  std::vector<cl_image_format> formats(num);
+  clGetSupportedImageFormats(context, flags, CL_MEM_OBJECT_IMAGE2D, num, &formats[0], NULL);
+  for (cl_uint i = 0; i < num; i++) {
+    if (formats[i].image_channel_order == order && formats[i].image_channel_data_type == CL_HALF_FLOAT)
+      return true;
+  }
+  return false;
+}
+
+bool HalfArithmetic(cl_device_id device) {
+  return Device::GetDeviceString(device, CL_DEVICE_EXTENSIONS).find("cl_khr_fp16") != std::string::npos;
+}
+
+cl_int UploadFloats(Device &device, cl_mem dst, StoragePrecision precision, const float *src, size_t count) {
+  if (precision == STORAGE_FLOAT)
+    return device.Staging.Upload(device.CommandQueue, dst, 0, src, count * sizeof(float));
+  std::vector<cl_half> halves(count);
+  FloatToHalf(src, &halves[0], count);
+  return device.Staging.Upload(device.CommandQueue, dst, 0, &halves[0], count * sizeof(cl_half));
+}
+
+cl_int DownloadFloats(Device &device, cl_mem src, StoragePrecision precision, float *dst, size_t count) {
+  if (precision == STORAGE_FLOAT)
+    return device.Staging.Download(device.CommandQueue, src, 0, dst, count * sizeof(float));
+  std::vector<cl_half> halves(count);
+  cl_int err = device.Staging.Download(device.CommandQueue, src, 0, &halves[0], count * sizeof(cl_half));
+  if (err == CL_SUCCESS)
+    HalfToFloat(&halves[0], dst, count);
+  return err;
+}
+
+cl_mem CreateFloatImage(Device &device, StoragePrecision precision, int width, int height,
+    cl_mem_flags flags, const float *rgba) {
+  cl_image_format format;
+  format.image_channel_order = CL_RGBA;
+  format.image_channel_data_type = StorageChannelType(precision);
+  size_t count = (size_t) width * height * 4;
+  std::vector<cl_half> halves;
+  const void *host = rgba;
+  if (rgba != NULL && precision == STORAGE_HALF) {
+    halves.resize(count);
+    FloatToHalf(rgba, &halves[0], count);
+    host = &halves[0];
+  }
+  if (host != NULL)
+    flags |= CL_MEM_COPY_HOST_PTR;
+  cl_int err = CL_SUCCESS;
+  cl_mem image = clCreateImage2D(device.Context, flags, &format, width, height, 0, (void *) host, &err);
+  OCL_CHECK(err, "CreateFloatImage");
+  return image;
+}
+
+cl_int ReadFloatImage(Device &device, cl_mem image, StoragePrecision precision, int width, int height,
+    float *rgba) {
+  size_t origin[3] = { 0, 0, 0 };
+  size_t region[3] = { (size_t) width, (size_t) height, 1 };
+  size_t count = (size_t) width * height * 4;
+  if (precision == STORAGE_FLOAT) {
+    ProfileEvent pe(device.Prof, "read float image", PROFILE_READ, count * sizeof(float));
+    return clEnqueueReadImage(device.CommandQueue, image, CL_TRUE, origin, region, 0, 0, rgba, 0, NULL,
+        pe.Out());
+  }
+  std::vector<cl_half> halves(count);
+  cl_int err = CL_SUCCESS;
+  {
+    ProfileEvent pe(device.Prof, "read half image", PROFILE_READ, count * sizeof(cl_half));
+    err = clEnqueueReadImage(device.CommandQueue, image, CL_TRUE, origin, region, 0, 0, &halves[0],
+        0, NULL, pe.Out());
+  }
+  if (err == CL_SUCCESS)
+    HalfToFloat(&halves[0], rgba, count);
+  return err;
+}
+
+PrecisionReport ComparePrecision(const float *reference, const float *result, size_t count) {
+  PrecisionReport report;
+  report.count = count;
+  double sum = 0, sumSquares = 0;
+  for (size_t i = 0; i < count; i++) {
+    double diff = fabs((double) result[i] - reference[i]);
+    sum += diff;
+    sumSquares += diff * diff;
+    if (diff > report.maxAbs)
+      report.maxAbs = diff;
+    if (reference[i] != 0 && diff / fabs(reference[i]) > report.maxRel)
+      report.maxRel = diff / fabs(reference[i]);
+  }
+  if (count > 0) {
+    report.meanAbs = sum / count;
+    report.rms = sqrt(sumSquares / count);
+  }
+  return report;
+}
+
+void PrecisionReport::Display(const std::string &name) const {
+  std::cout << "\t" << name << " against fp32: max abs " << maxAbs << ", mean abs " << meanAbs
+      << ", rms " << rms << ", max rel " << maxRel << " (" << count << " values)" << std::endl;
+}
@@ -0,0 +1,55 @@
+#ifndef HALF_STORAGE_HPP
+#define HALF_STORAGE_HPP
+#include <string>
+#include <CL/cl.h>
+
+class Device;
+
+//How float data is kept in device memory. STORAGE_HALF holds IEEE fp16:
+//buffers are read and written with vload_half/vstore_half and images use
+//CL_HALF_FLOAT, both core OpenCL, so kernels still compute in fp32 and
+//cl_khr_fp16 is only needed for arithmetic on half itself.
+enum StoragePrecision {
+  STORAGE_FLOAT,
+  STORAGE_HALF
+};
+
+//Round to nearest even, overflow to infinity, denormals kept
+cl_half FloatToHalf(float value);
+float HalfToFloat(cl_half value);
+void FloatToHalf(const float *src, cl_half *dst, size_t count);
+void HalfToFloat(const cl_half *src, float *dst, size_t count);
+
+//Bytes of one element in device memory
+size_t StorageSize(StoragePrecision precision);
+cl_channel_type StorageChannelType(StoragePrecision precision);
+//CL_HALF_FLOAT images of the order can be created with the flags
+bool HalfImageSupport(cl_context context, cl_channel_order order = CL_RGBA,
+    cl_mem_flags flags = CL_MEM_READ_WRITE);
+//cl_khr_fp16: half arithmetic, not needed for the storage mode
+bool HalfArithmetic(cl_device_id device);
+
+//count floats from host src into dst, converted on the host when dst holds halves
+cl_int UploadFloats(Device &device, cl_mem dst, StoragePrecision precision, const float *src, size_t count);
+//count elements of src to host floats. Blocking.
+cl_int DownloadFloats(Device &device, cl_mem src, StoragePrecision precision, float *dst, size_t count);
+//width x height CL_RGBA image of floats or halves, filled from rgba when not NULL
+cl_mem CreateFloatImage(Device &device, StoragePrecision precision, int width, int height,
+    cl_mem_flags flags, const float *rgba = NULL);
+//The pixels of such an image as 4 floats each. Blocking.
+cl_int ReadFloatImage(Device &device, cl_mem image, StoragePrecision precision, int width, int height,
+    float *rgba);
+
+//Error of a reduced-precision result against the fp32 reference
+struct PrecisionReport {
+  PrecisionReport() : count(0), maxAbs(0), meanAbs(0), maxRel(0), rms(0) {}
+  size_t count;
+  double maxAbs;
+  double meanAbs;
+  double maxRel;   //relative to |reference|, elements where it is 0 skipped
+  double rms;
+  void Display(const std::string &name) const;
+};
+PrecisionReport ComparePrecision(const float *reference, const float *result, size_t count);
+
+#endif //HALF_STORAGE_HPP
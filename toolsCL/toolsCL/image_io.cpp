@@ -0,0 +1,384 @@
+#include "image_io.hpp"
+#include "device.hpp"
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include <algorithm>
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#ifdef _WIN32
+MappedFile::MappedFile() : data(NULL), size(0), file(INVALID_HANDLE_VALUE), mapping(NULL) {}
+
+bool MappedFile::Open(const std::string &path) {
+  Close();
+  file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+      FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+  if (file == INVALID_HANDLE_VALUE)
+    return false;
+  LARGE_INTEGER length;
+  GetFileSizeEx(file, &length);
+  size = (size_t) length.QuadPart;
+  mapping = size > 0 ? CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL) : NULL;
+  data = mapping != NULL ? (unsigned char *) MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : NULL;
+  if (data == NULL)
+    Close();
+  return data != NULL;
+}
+
+bool MappedFile::Create(const std::string &path, size_t bytes) {
+  Close();
+  file = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, 0, NULL, CREATE_ALWAYS,
+      FILE_ATTRIBUTE_NORMAL, NULL);
+  if (file == INVALID_HANDLE_VALUE)
+    return false;
+  size = bytes;
+  mapping = CreateFileMappingA(file, NULL, PAGE_READWRITE, (DWORD) ((unsigned long long) bytes >> 32),
+      (DWORD) bytes, NULL);
+  data = mapping != NULL ? (unsigned char *) MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, 0) : NULL;
+  if (data == NULL)
+    Close();
+  return data != NULL;
+}
+
+void MappedFile::Close() {
+  if (data != NULL)
+    UnmapViewOfFile(data);
+  if (mapping != NULL)
+    CloseHandle(mapping);
+  if (file != INVALID_HANDLE_VALUE)
+    CloseHandle(file);
+  data = NULL;
+  mapping = NULL;
+  file = INVALID_HANDLE_VALUE;
+  size = 0;
+}
+#else
+MappedFile::MappedFile() : data(NULL), size(0), fd(-1) {}
+
+bool MappedFile::Open(const std::string &path) {
+  Close();
+  fd = open(path.c_str(), O_RDONLY);
+  struct stat st;
+  if (fd < 0 || fstat(fd, &st) != 0 || st.st_size == 0) {
+    Close();
+    return false;
+  }
+  size = (size_t) st.st_size;
+  void *p = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (p == MAP_FAILED) {
+    Close();
+    return false;
+  }
+  data = (unsigned char *) p;
+  madvise(p, size, MADV_SEQUENTIAL);
+  return true;
+}
+
+bool MappedFile::Create(const std::string &path, size_t bytes) {
+  Close();
+  fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0 || ftruncate(fd, (off_t) bytes) != 0) {
+    Close();
+    return false;
+  }
+  size = bytes;
+  void *p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (p == MAP_FAILED) {
+    Close();
+    return false;
+  }
+  data = (unsigned char *) p;
+  return true;
+}
+
+void MappedFile::Close() {
+  if (data != NULL)
+    munmap(data, size);
+  if (fd >= 0)
+    close(fd);
+  data = NULL;
+  size = 0;
+  fd = -1;
+}
+#endif
+
+ImageFileFormat ImageFormatFromName(const std::string &path) {
+  size_t dot = path.rfind('.');
+  std::string ext = dot == std::string::npos ? "" : path.substr(dot + 1);
+  std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+  if (ext == "bmp")
+    return IMAGE_BMP;
+  if (ext == "ppm")
+    return IMAGE_PPM;
+  if (ext == "pgm")
+    return IMAGE_PGM;
+  return IMAGE_UNKNOWN;
+}
+
+static unsigned int Le16(const unsigned char *p) { return p[0] | (p[1] << 8); }
+static unsigned int Le32(const unsigned char *p) { return p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned int) p[3] << 24); }
+static void PutLe16(unsigned char *p, unsigned int v) { p[0] = v & 0xff; p[1] = (v >> 8) & 0xff; }
+static void PutLe32(unsigned char *p, unsigned int v) { PutLe16(p, v & 0xffff); PutLe16(p + 2, v >> 16); }
+
+//Next decimal field of a PNM header, skipping whitespace and # comments
+static bool PnmField(const unsigned char *data, size_t size, size_t &pos, int &value) {
+  while (pos < size && (isspace(data[pos]) || data[pos] == '#')) {
+    if (data[pos] == '#')
+      while (pos < size && data[pos] != '\n') pos++;
+    else
+      pos++;
+  }
+  if (pos >= size || !isdigit(data[pos]))
+    return false;
+  value = 0;
+  while (pos < size && isdigit(data[pos]))
+    value = value * 10 + (data[pos++] - '0');
+  return true;
+}
+
+bool ParseImageHeader(const unsigned char *data, size_t size, ImageFileHeader &header,
+    unsigned long long fileSize) {
+  header = ImageFileHeader();
+  unsigned long long total = fileSize > 0 ? fileSize : size;
+  if (size >= 54 && data[0] == 'B' && data[1] == 'M') {
+    unsigned int offset = Le32(data + 10);
+    int width = (int) Le32(data + 18);
+    int height = (int) Le32(data + 22);
+    unsigned int bits = Le16(data + 28);
+    unsigned int compression = Le32(data + 30);
+    if ((bits != 24 && bits != 32) || (compression != 0 && compression != 3) || width <= 0 || height == 0) {
+      std::cout << "Err: only uncompressed 24/32 bit BMPs are supported" << std::endl;
+      return false;
+    }
+    //BI_BITFIELDS: the red, green and blue masks follow the info header,
+    //and only the BGRA layout BI_RGB has is read as such
+    if (compression == 3 && (bits != 32 || size < 66 || Le32(data + 54) != 0x00ff0000u
+        || Le32(data + 58) != 0x0000ff00u || Le32(data + 62) != 0x000000ffu)) {
+      std::cout << "Err: only BGRA channel masks are supported in BI_BITFIELDS BMPs" << std::endl;
+      return false;
+    }
+    header.format = IMAGE_BMP;
+    header.width = width;
+    header.height = height < 0 ? -height : height;
+    header.channels = bits / 8;
+    long long pitch = ((long long) width * header.channels + 3) & ~3LL;
+    //rows are stored bottom-up unless the height is negative
+    header.offset = height < 0 ? offset : offset + (size_t) (pitch * (header.height - 1));
+    header.rowPitch = height < 0 ? pitch : -pitch;
+    return offset + pitch * header.height <= (long long) total;
+  }
+  if (size >= 2 && data[0] == 'P' && (data[1] == '6' || data[1] == '5')) {
+    size_t pos = 2;
+    int width = 0, height = 0, maxval = 0;
+    if (!PnmField(data, size, pos, width) || !PnmField(data, size, pos, height)
+        || !PnmField(data, size, pos, maxval) || maxval > 255 || width <= 0 || height <= 0) {
+      std::cout << "Err: only 8 bit binary PPM/PGM files are supported" << std::endl;
+      return false;
+    }
+    header.format = data[1] == '6' ? IMAGE_PPM : IMAGE_PGM;
+    header.width = width;
+    header.height = height;
+    header.channels = header.format == IMAGE_PPM ? 3 : 1;
+    header.offset = pos + 1;  //a single whitespace ends the header
+    header.rowPitch = (long long) width * header.channels;
+    return (long long) header.offset + header.rowPitch * height <= (long long) total;
+  }
+  std::cout << "Err: unknown image file format" << std::endl;
+  return false;
+}
+
+size_t ImageFileSize(ImageFileFormat format, int width, int height) {
+  ImageFileHeader header;
+  return WriteImageHeader(format, width, height, NULL, header);
+}
+
+size_t WriteImageHeader(ImageFileFormat format, int width, int height, unsigned char *data,
+    ImageFileHeader &header) {
+  header = ImageFileHeader();
+  header.format = format;
+  header.width = width;
+  header.height = height;
+  if (format == IMAGE_BMP) {
+    header.channels = 3;
+    long long pitch = ((long long) width * 3 + 3) & ~3LL;
+    size_t bytes = 54 + (size_t) (pitch * height);
+    header.offset = 54 + (size_t) (pitch * (height - 1));
+    header.rowPitch = -pitch;
+    if (data != NULL) {
+      memset(data, 0, 54);
+      data[0] = 'B';
+      data[1] = 'M';
+      PutLe32(data + 2, (unsigned int) bytes);
+      PutLe32(data + 10, 54);
+      PutLe32(data + 14, 40);
+      PutLe32(data + 18, width);
+      PutLe32(data + 22, height);
+      PutLe16(data + 26, 1);
+      PutLe16(data + 28, 24);
+      PutLe32(data + 34, (unsigned int) (bytes - 54));
+    }
+    return bytes;
+  }
+  if (format == IMAGE_PPM || format == IMAGE_PGM) {
+    char text[64];
+    int length = sprintf(text, "P%c\n%d %d\n255\n", format == IMAGE_PPM ? '6' : '5', width, height);
+    header.channels = format == IMAGE_PPM ? 3 : 1;
+    header.offset = length;
+    header.rowPitch = (long long) width * header.channels;
+    if (data != NULL)
+      memcpy(data, text, length);
+    return length + (size_t) (header.rowPitch * height);
+  }
+  return 0;
+}
+
+void RowToRGBA(const ImageFileHeader &header, const unsigned char *src, unsigned char *dst, int width) {
+  switch (header.format) {
+  case IMAGE_BMP:
+    for (int x = 0; x < width; x++, src += header.channels, dst += 4) {
+      dst[0] = src[2];
+      dst[1] = src[1];
+      dst[2] = src[0];
+      dst[3] = header.channels == 4 ? src[3] : 0xff;
+    }
+    break;
+  case IMAGE_PPM:
+    for (int x = 0; x < width; x++, src += 3, dst += 4) {
+      dst[0] = src[0];
+      dst[1] = src[1];
+      dst[2] = src[2];
+      dst[3] = 0xff;
+    }
+    break;
+  default:
+    for (int x = 0; x < width; x++, src++, dst += 4) {
+      dst[0] = dst[1] = dst[2] = src[0];
+      dst[3] = 0xff;
+    }
+    break;
+  }
+}
+
+void RowFromRGBA(const ImageFileHeader &header, const unsigned char *src, unsigned char *dst, int width) {
+  switch (header.format) {
+  case IMAGE_BMP:
+    for (int x = 0; x < width; x++, src += 4, dst += 3) {
+      dst[0] = src[2];
+      dst[1] = src[1];
+      dst[2] = src[0];
+    }
+    break;
+  case IMAGE_PPM:
+    for (int x = 0; x < width; x++, src += 4, dst += 3) {
+      dst[0] = src[0];
+      dst[1] = src[1];
+      dst[2] = src[2];
+    }
+    break;
+  default:
+    //BT.601 luma
+    for (int x = 0; x < width; x++, src += 4, dst++)
+      dst[0] = (unsigned char) ((src[0] * 77 + src[1] * 150 + src[2] * 29) >> 8);
+    break;
+  }
+}
+
+void ImageToRGBA(const ImageFileHeader &header, const unsigned char *file, unsigned char *rgba, size_t pitch) {
+  for (int y = 0; y < header.height; y++)
+    RowToRGBA(header, file + header.offset + header.rowPitch * y, rgba + pitch * y, header.width);
+}
+
+void ImageFromRGBA(const ImageFileHeader &header, const unsigned char *rgba, size_t pitch, unsigned char *file) {
+  for (int y = 0; y < header.height; y++)
+    RowFromRGBA(header, rgba + pitch * y, file + header.offset + header.rowPitch * y, header.width);
+}
+
+cl_mem LoadImageFile(Device &device, const std::string &path, int &width, int &height, cl_mem_flags flags) {
+  MappedFile file;
+  ImageFileHeader header;
+  if (!file.Open(path) || !ParseImageHeader(file.Data(), file.Size(), header)) {
+    std::cout << "Err: cannot read image " << path << std::endl;
+    return NULL;
+  }
+  width = header.width;
+  height = header.height;
+
+  cl_image_format format;
+  format.image_channel_order = CL_RGBA;
+  format.image_channel_data_type = CL_UNORM_INT8;
+  cl_int err = CL_SUCCESS;
+  //host-allocated so the map below is pinned memory, or the image itself
+  cl_mem image = clCreateImage2D(device.Context, flags | CL_MEM_ALLOC_HOST_PTR, &format, width, height, 0,
+      NULL, &err);
+  OCL_CHECK(err, "LoadImageFile: image");
+  if (image == NULL)
+    return NULL;
+
+  size_t origin[3] = { 0, 0, 0 };
+  size_t region[3] = { (size_t) width, (size_t) height, 1 };
+  size_t pitch = 0;
+  cl_map_flags mapFlags = CL_MAP_WRITE;
+#ifdef CL_VERSION_1_2
+  mapFlags = CL_MAP_WRITE_INVALIDATE_REGION;
+#endif
+  size_t bytes = (size_t) width * height * 4;
+  unsigned char *mapped = NULL;
+  {
+    ProfileEvent pe(device.Prof, "load image map", PROFILE_MAP, bytes);
+    mapped = (unsigned char *) clEnqueueMapImage(device.CommandQueue, image, CL_TRUE, mapFlags,
+        origin, region, &pitch, NULL, 0, NULL, pe.Out(), &err);
+  }
+  OCL_CHECK(err, "LoadImageFile: map");
+  if (mapped == NULL) {
+    clReleaseMemObject(image);
+    return NULL;
+  }
+  ImageToRGBA(header, file.Data(), mapped, pitch);
+  ProfileEvent pe(device.Prof, "load image unmap", PROFILE_MAP, bytes);
+  clEnqueueUnmapMemObject(device.CommandQueue, image, mapped, 0, NULL, pe.Out());
+  return image;
+}
+
+bool SaveImageFile(Device &device, cl_mem image, const std::string &path) {
+  ImageFileFormat format = ImageFormatFromName(path);
+  size_t width = 0, height = 0;
+  clGetImageInfo(image, CL_IMAGE_WIDTH, sizeof(size_t), &width, NULL);
+  clGetImageInfo(image, CL_IMAGE_HEIGHT, sizeof(size_t), &height, NULL);
+  size_t bytes = ImageFileSize(format, (int) width, (int) height);
+  MappedFile file;
+  if (bytes == 0 || !file.Create(path, bytes)) {
+    std::cout << "Err: cannot write image " << path << std::endl;
+    return false;
+  }
+  ImageFileHeader header;
+  WriteImageHeader(format, (int) width, (int) height, file.Data(), header);
+
+  size_t origin[3] = { 0, 0, 0 };
+  size_t region[3] = { width, height, 1 };
+  size_t pitch = 0;
+  cl_int err = CL_SUCCESS;
+  const unsigned char *mapped = NULL;
+  {
+    ProfileEvent pe(device.Prof, "save image map", PROFILE_MAP, width * height * 4);
+    mapped = (const unsigned char *) clEnqueueMapImage(device.CommandQueue, image, CL_TRUE,
+        CL_MAP_READ, origin, region, &pitch, NULL, 0, NULL, pe.Out(), &err);
+  }
+  OCL_CHECK(err, "SaveImageFile: map");
+  if (mapped == NULL)
+    return false;
+  ImageFromRGBA(header, mapped, pitch, file.Data());
+  {
+    ProfileEvent pe(device.Prof, "save image unmap", PROFILE_MAP, width * height * 4);
+    clEnqueueUnmapMemObject(device.CommandQueue, image, (void *) mapped, 0, NULL, pe.Out());
+  }
+  clFinish(device.CommandQueue);
+  return true;
+}
@@ -0,0 +1,78 @@
+#ifndef IMAGE_IO_HPP
+#define IMAGE_IO_HPP
+#include <string>
+#include <CL/cl.h>
+
+class Device;
+
+//A file mapped into memory, read-only or created read-write at a size
+class MappedFile {
+  public:
+    MappedFile();
+    ~MappedFile() { Close(); }
+
+    bool Open(const std::string &path);
+    bool Create(const std::string &path, size_t size);
+    void Close();
+    unsigned char *Data() const { return data; }
+    size_t Size() const { return size; }
+
+  private:
+    MappedFile(const MappedFile &);
+    MappedFile &operator=(const MappedFile &);
+
+    unsigned char *data;
+    size_t size;
+#ifdef _WIN32
+    void *file;
+    void *mapping;
+#else
+    int fd;
+#endif
+};
+
+enum ImageFileFormat {
+  IMAGE_UNKNOWN,
+  IMAGE_BMP,  //uncompressed 24 or 32 bit
+  IMAGE_PPM,  //binary P6, maxval 255
+  IMAGE_PGM   //binary P5, maxval 255
+};
+
+//Where the pixels of an image file are: row y starts at
+//data + offset + y * rowPitch; rowPitch is negative for bottom-up BMPs
+struct ImageFileHeader {
+  ImageFileHeader() : format(IMAGE_UNKNOWN), width(0), height(0), channels(0), offset(0), rowPitch(0) {}
+  ImageFileFormat format;
+  int width;
+  int height;
+  int channels;   //bytes per pixel in the file: BGR(A) for BMP, RGB or grey otherwise
+  size_t offset;  //first byte of row 0 (the top row)
+  long long rowPitch;
+};
+
+ImageFileFormat ImageFormatFromName(const std::string &path);
+//data holds the first size bytes of a file of fileSize bytes (0: all of it)
+bool ParseImageHeader(const unsigned char *data, size_t size, ImageFileHeader &header,
+    unsigned long long fileSize = 0);
+//Pixel layout of a file of that format and size; the header bytes go to
+//data unless it is NULL
+size_t WriteImageHeader(ImageFileFormat format, int width, int height, unsigned char *data,
+    ImageFileHeader &header);
+size_t ImageFileSize(ImageFileFormat format, int width, int height);
+//width pixels of one file row to or from RGBA8
+void RowToRGBA(const ImageFileHeader &header, const unsigned char *src, unsigned char *dst, int width);
+void RowFromRGBA(const ImageFileHeader &header, const unsigned char *src, unsigned char *dst, int width);
+//One pass between file pixels and RGBA8 rows of pitch bytes
+void ImageToRGBA(const ImageFileHeader &header, const unsigned char *file, unsigned char *rgba, size_t pitch);
+void ImageFromRGBA(const ImageFileHeader &header, const unsigned char *rgba, size_t pitch, unsigned char *file);
+
+//Read a BMP/PPM/PGM file into a new CL_RGBA / CL_UNORM_INT8 image: the
+//file is mapped and converted straight into the mapped image, the only
+//copy of the pixels on the host
+cl_mem LoadImageFile(Device &device, const std::string &path, int &width, int &height,
+    cl_mem_flags flags = CL_MEM_READ_ONLY);
+//Write an RGBA8 image, format from the extension, converting straight
+//from the mapped image into the mapped output file
+bool SaveImageFile(Device &device, cl_mem image, const std::string &path);
+
+#endif //IMAGE_IO_HPP
@@ -21,8 +21,14 @@
 #define CONCAT(A,B) A##_##B
 #define TEMPLATE(name,type) CONCAT(name,type)
 
+// Templated kernel files are built once per element type, with Dtype
+// and TYPE set to one of these (kernel_types.cpp):
+//   __kernel void TEMPLATE(mul2,Dtype)(...)  ->  mul2_float, mul2_uchar, ...
 #define TYPE_FLOAT 1
 #define TYPE_DOUBLE 2
+#define TYPE_INT 3
+#define TYPE_SHORT 4
+#define TYPE_UCHAR 5
 
 #if defined(cl_khr_fp64)
 #pragma OPENCL EXTENSION cl_khr_fp64 : enable
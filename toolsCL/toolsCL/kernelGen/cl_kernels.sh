@@ -1,66 +1,243 @@
 #! /bin/bash
 # This script converts all OpenCL Kernels to C++ char strings
 # Outputs (overwrites): cl_kernels.hpp and cl_kernels.cpp
+#
+# Usage: ./cl_kernels.sh [-b BINDIR] [-s]
+#   -b BINDIR  also embed the device binaries found in BINDIR/<device>/,
+#              as written by Device::DumpBinaries on each target device
+#   -s         compile every kernel to SPIR 1.2 with clang into BINDIR/spir/
+#              (needs -b) for devices exposing cl_khr_spir
 
 CL_HEADERDIR="./cl_headers/*.cl"
 CL_KERNELDIR="./cl_kernels/*.cl"
 HEADER='../cl_kernels.hpp'
 INCHEADER='cl_kernels.hpp'
 SOURCE='../cl_kernels.cpp'
+CL_BINDIR=""
+CL_SPIR=0
+
+while getopts "b:s" OPT
+do
+	case $OPT in
+		b) CL_BINDIR="${OPTARG%/}";;
+		s) CL_SPIR=1;;
+		*) echo "Usage: $0 [-b BINDIR] [-s]"; exit 1;;
+	esac
+done
+
+if [ $CL_SPIR -eq 1 ] && [ -z "$CL_BINDIR" ]; then
+	echo "-s needs -b BINDIR"
+	exit 1
+fi
 
 echo "// AUTOMATICALLY GENERATED FILE, DO NOT EDIT" > $HEADER
 echo "// AUTOMATICALLY GENERATED FILE, DO NOT EDIT" > $SOURCE
 
 echo "#ifndef CL_KERNELS_HPP_" >> $HEADER
 echo "#define CL_KERNELS_HPP_" >> $HEADER
-echo "#include <iostream>" >> $HEADER
 echo "#include <string>" >> $HEADER
+echo "#include <stddef.h>" >> $HEADER
 
 echo "#include \"$INCHEADER\"" >> $SOURCE
-echo "#include <sstream>" >> $SOURCE
 echo "#include <string>" >> $SOURCE
 
-echo "void RegisterKernels(std::string &strSource);" >> $HEADER
-
-
-shopt -s nullglob
-for CL_KERNEL in $CL_HEADERDIR $CL_KERNELDIR
-do
-	CL_KERNEL_STR=`cat $CL_KERNEL`
-	CL_KERNEL_NAME=`echo $CL_KERNEL`
-	CL_KERNEL_NAME="${CL_KERNEL_NAME##*/}"
-	CL_KERNEL_NAME="${CL_KERNEL_NAME%.cl}"
-	echo -n "std::string ${CL_KERNEL_NAME} = \"" >> $SOURCE
-	echo -n "$CL_KERNEL_STR" | sed -e ':a;N;$!ba;s/\n/\\n/g' | sed -e 's/\"/\\"/g' >> $SOURCE
-	echo "\";  // NOLINT" >> $SOURCE
-done
-
-
-
-echo "void RegisterKernels(std::string &strSource) {" >> $SOURCE
-echo "  std::stringstream ss;" >> $SOURCE
+echo "" >> $HEADER
+echo "// One embedded kernel file. The table is constant-initialized: no" >> $HEADER
+echo "// static constructors and no copy until a file is actually built." >> $HEADER
+echo "struct KernelSource {" >> $HEADER
+echo "  const char *file;            // e.g. \"mul2.cl\"" >> $HEADER
+echo "  const char *source;" >> $HEADER
+echo "  size_t length;" >> $HEADER
+echo "  const char *const *kernels;  // __kernel names declared in the file" >> $HEADER
+echo "  size_t numKernels;" >> $HEADER
+echo "};" >> $HEADER
+echo "extern const KernelSource kernelHeader;  // cl_headers, joined" >> $HEADER
+echo "extern const KernelSource kernelSources[];" >> $HEADER
+echo "extern const size_t numKernelSources;" >> $HEADER
+echo "const KernelSource *FindKernelSource(const std::string &file);" >> $HEADER
+echo "const KernelSource *FindKernelOwner(const std::string &kernel);" >> $HEADER
+echo "" >> $HEADER
+echo "// Kernel file compiled ahead of time for one device and driver" >> $HEADER
+echo "struct KernelBinary {" >> $HEADER
+echo "  const char *device;  // CL_DEVICE_NAME, or \"spir\" for portable SPIR" >> $HEADER
+echo "  const char *driver;  // CL_DRIVER_VERSION, empty for SPIR" >> $HEADER
+echo "  const char *file;" >> $HEADER
+echo "  const unsigned char *data;" >> $HEADER
+echo "  size_t size;" >> $HEADER
+echo "};" >> $HEADER
+echo "const KernelBinary *FindKernelBinary(const std::string &device, const std::string &driver, const std::string &file);" >> $HEADER
+
+# Emit the lines of a file as adjacent string literals, byte for byte
+emit_literal() {
+	if [ -s "$1" ]; then
+		if [ -n "$(tail -c1 "$1")" ]; then
+			sed -e 's/\\/\\\\/g' -e 's/"/\\"/g' -e 's/^/  "/' -e 's/$/\\n"/' "$1" | sed -e '$ s/\\n"$/"/'
+			echo ""
+		else
+			sed -e 's/\\/\\\\/g' -e 's/"/\\"/g' -e 's/^/  "/' -e 's/$/\\n"/' "$1"
+		fi
+	fi
+}
+
+# Element types of templated files, as in kernel_types.cpp
+CL_TYPES="float double int short uchar"
+
+# __kernel names declared in a file. TEMPLATE(name,Dtype) expands to one
+# name per type; other names built by macros are skipped
+kernel_names() {
+	CL_FLAT=$(sed -e 's://.*$::' "$1" | tr '\n' ' ')
+	echo "$CL_FLAT" \
+		| grep -oE '(^|[^A-Za-z0-9_])(__kernel|kernel)[[:space:]][^;{]*void[[:space:]]+[A-Za-z_][A-Za-z0-9_]*[[:space:]]*\(' \
+		| sed -E 's/.*void[[:space:]]+([A-Za-z_][A-Za-z0-9_]*).*/\1/' \
+		| grep -v '^TEMPLATE$'
+	echo "$CL_FLAT" \
+		| grep -oE '(^|[^A-Za-z0-9_])(__kernel|kernel)[[:space:]][^;{]*void[[:space:]]+TEMPLATE[[:space:]]*\([[:space:]]*[A-Za-z_][A-Za-z0-9_]*[[:space:]]*,[[:space:]]*Dtype[[:space:]]*\)' \
+		| sed -E 's/.*TEMPLATE[[:space:]]*\([[:space:]]*([A-Za-z_][A-Za-z0-9_]*).*/\1/' \
+		| while read CL_NAME; do
+			for CL_TYPE in $CL_TYPES; do echo "${CL_NAME}_${CL_TYPE}"; done
+		done
+}
+
+# A templated file repeated once per type, as InstantiateTypes does
+instantiate_types() {
+	for CL_TYPE in $CL_TYPES
+	do
+		CL_TYPE_ID="TYPE_$(echo $CL_TYPE | tr 'a-z' 'A-Z')"
+		if [ "$CL_TYPE" = "double" ]; then echo "#ifdef DOUBLE_SUPPORT_AVAILABLE"; fi
+		printf '#define Dtype %s\n#define TYPE %s\n#line 1\n' $CL_TYPE $CL_TYPE_ID
+		cat "$1"
+		printf '\n#undef Dtype\n#undef TYPE\n'
+		if [ "$CL_TYPE" = "double" ]; then echo "#endif"; fi
+	done
+}
 
 shopt -s nullglob
+echo "static constexpr char kernel_header_source[] =" >> $SOURCE
 for CL_KERNEL in $CL_HEADERDIR
 do
-	CL_KERNEL_NAME=`echo $CL_KERNEL`
-	CL_KERNEL_NAME="${CL_KERNEL_NAME##*/}"
-	CL_KERNEL_NAME="${CL_KERNEL_NAME%.cl}"
-	echo "  ss << $CL_KERNEL_NAME << \"\\n\\n\";  // NOLINT" >> $SOURCE
+	emit_literal $CL_KERNEL >> $SOURCE
+	echo '  "\n\n"' >> $SOURCE
 done
+echo '  "";  // NOLINT' >> $SOURCE
+echo "constexpr KernelSource kernelHeader = { \"header\", kernel_header_source, sizeof(kernel_header_source) - 1, nullptr, 0 };" >> $SOURCE
 
-shopt -s nullglob
+CL_SOURCE_TABLE=()
 for CL_KERNEL in $CL_KERNELDIR
 do
-	CL_KERNEL_NAME=`echo $CL_KERNEL`
-	CL_KERNEL_NAME="${CL_KERNEL_NAME##*/}"
-	CL_KERNEL_NAME="${CL_KERNEL_NAME%.cl}"
-	echo "  ss << ${CL_KERNEL_NAME} << \"\\n\\n\";  // NOLINT" >> $SOURCE
+	CL_KERNEL_FILE="${CL_KERNEL##*/}"
+	CL_KERNEL_NAME=$(echo -n "${CL_KERNEL_FILE%.cl}" | tr -c 'A-Za-z0-9_' '_')
+	echo "static constexpr char ${CL_KERNEL_NAME}_source[] =" >> $SOURCE
+	emit_literal $CL_KERNEL >> $SOURCE
+	echo '  "";  // NOLINT' >> $SOURCE
+	CL_NAMES=$(kernel_names $CL_KERNEL)
+	if [ -n "$CL_NAMES" ]; then
+		CL_COUNT=$(echo "$CL_NAMES" | wc -l)
+		echo -n "static constexpr const char *${CL_KERNEL_NAME}_kernels[] = {" >> $SOURCE
+		echo -n "$CL_NAMES" | sed -e 's/.*/ "&"/' | paste -sd, | tr -d '\n' >> $SOURCE
+		echo " };" >> $SOURCE
+		CL_SOURCE_TABLE+=("  { \"$CL_KERNEL_FILE\", ${CL_KERNEL_NAME}_source, sizeof(${CL_KERNEL_NAME}_source) - 1, ${CL_KERNEL_NAME}_kernels, $CL_COUNT },")
+	else
+		CL_SOURCE_TABLE+=("  { \"$CL_KERNEL_FILE\", ${CL_KERNEL_NAME}_source, sizeof(${CL_KERNEL_NAME}_source) - 1, nullptr, 0 },")
+	fi
 done
 
+echo "constexpr KernelSource kernelSources[] = {" >> $SOURCE
+if [ ${#CL_SOURCE_TABLE[@]} -gt 0 ]; then
+	printf '%s\n' "${CL_SOURCE_TABLE[@]}" >> $SOURCE
+fi
+echo "  { nullptr, nullptr, 0, nullptr, 0 }" >> $SOURCE
+echo "};" >> $SOURCE
+echo "constexpr size_t numKernelSources = ${#CL_SOURCE_TABLE[@]};" >> $SOURCE
+echo "const KernelSource *FindKernelSource(const std::string &file) {" >> $SOURCE
+echo "  for (size_t i = 0; i < numKernelSources; i++) {" >> $SOURCE
+echo "    if (file == kernelSources[i].file)" >> $SOURCE
+echo "      return &kernelSources[i];" >> $SOURCE
+echo "  }" >> $SOURCE
+echo "  return NULL;" >> $SOURCE
+echo "}" >> $SOURCE
+echo "const KernelSource *FindKernelOwner(const std::string &kernel) {" >> $SOURCE
+echo "  for (size_t i = 0; i < numKernelSources; i++) {" >> $SOURCE
+echo "    for (size_t k = 0; k < kernelSources[i].numKernels; k++) {" >> $SOURCE
+echo "      if (kernel == kernelSources[i].kernels[k])" >> $SOURCE
+echo "        return &kernelSources[i];" >> $SOURCE
+echo "    }" >> $SOURCE
+echo "  }" >> $SOURCE
+echo "  return NULL;" >> $SOURCE
+echo "}" >> $SOURCE
 
-echo "  strSource = ss.str();" >> $SOURCE
-
+# Ahead-of-time binaries
+if [ $CL_SPIR -eq 1 ]; then
+	mkdir -p "$CL_BINDIR/spir"
+	printf "spir\n\n" > "$CL_BINDIR/spir/device.txt"
+	CL_INCLUDES=""
+	for CL_KERNEL in $CL_HEADERDIR
+	do
+		CL_INCLUDES="$CL_INCLUDES -include $CL_KERNEL"
+	done
+	for CL_KERNEL in $CL_HEADERDIR; do cat $CL_KERNEL; printf "\n\n"; done > "$CL_BINDIR/spir/header.src"
+	for CL_KERNEL in $CL_KERNELDIR
+	do
+		CL_KERNEL_FILE="${CL_KERNEL##*/}"
+		# templated files are compiled once per type, as Device does
+		CL_INPUT=$CL_KERNEL
+		if grep -qE 'TEMPLATE[[:space:]]*\([^)]*,[[:space:]]*Dtype[[:space:]]*\)' $CL_KERNEL; then
+			CL_INPUT="$CL_BINDIR/spir/.typed.cl"
+			instantiate_types $CL_KERNEL > $CL_INPUT
+		fi
+		if clang -x cl -cl-std=CL1.2 -target spir64 -emit-llvm -c $CL_INCLUDES \
+			-o "$CL_BINDIR/spir/$CL_KERNEL_FILE.bin" $CL_INPUT; then
+			cp $CL_KERNEL "$CL_BINDIR/spir/$CL_KERNEL_FILE.src"
+		else
+			echo "SPIR compile failed: $CL_KERNEL"
+			rm -f "$CL_BINDIR/spir/$CL_KERNEL_FILE.bin"
+		fi
+	done
+	rm -f "$CL_BINDIR/spir/.typed.cl"
+fi
+
+CL_BINARY_COUNT=0
+CL_BINARY_TABLE=()
+if [ -n "$CL_BINDIR" ]; then
+	for CL_HEADER in $CL_HEADERDIR; do cat $CL_HEADER; printf "\n\n"; done > "$CL_BINDIR/.header.now"
+	for CL_DEVICE_INFO in "$CL_BINDIR"/*/device.txt
+	do
+		CL_DEVICE_DIR="${CL_DEVICE_INFO%/device.txt}"
+		CL_DEVICE=$(sed -n 1p "$CL_DEVICE_INFO" | sed -e 's/\\/\\\\/g' -e 's/"/\\"/g')
+		CL_DRIVER=$(sed -n 2p "$CL_DEVICE_INFO" | sed -e 's/\\/\\\\/g' -e 's/"/\\"/g')
+		if [ -f "$CL_DEVICE_DIR/header.src" ] && ! cmp -s "$CL_DEVICE_DIR/header.src" "$CL_BINDIR/.header.now"; then
+			echo "Skipping stale binaries in $CL_DEVICE_DIR (headers changed)"
+			continue
+		fi
+		for CL_BINARY in "$CL_DEVICE_DIR"/*.bin
+		do
+			CL_KERNEL_FILE="${CL_BINARY##*/}"
+			CL_KERNEL_FILE="${CL_KERNEL_FILE%.bin}"
+			if [ ! -f "./cl_kernels/$CL_KERNEL_FILE" ] || ! cmp -s "$CL_DEVICE_DIR/$CL_KERNEL_FILE.src" "./cl_kernels/$CL_KERNEL_FILE"; then
+				echo "Skipping stale binary $CL_BINARY"
+				continue
+			fi
+			echo "static const unsigned char kernel_binary_${CL_BINARY_COUNT}[] = {" >> $SOURCE
+			od -An -v -tx1 "$CL_BINARY" | sed -e 's/ *\([0-9a-f][0-9a-f]\)/0x\1,/g' >> $SOURCE
+			echo "};" >> $SOURCE
+			CL_BINARY_TABLE+=("  { \"$CL_DEVICE\", \"$CL_DRIVER\", \"$CL_KERNEL_FILE\", kernel_binary_${CL_BINARY_COUNT}, sizeof(kernel_binary_${CL_BINARY_COUNT}) },")
+			CL_BINARY_COUNT=$((CL_BINARY_COUNT + 1))
+		done
+	done
+	rm -f "$CL_BINDIR/.header.now"
+fi
+
+echo "static const KernelBinary kernelBinaries[] = {" >> $SOURCE
+if [ $CL_BINARY_COUNT -gt 0 ]; then
+	printf '%s\n' "${CL_BINARY_TABLE[@]}" >> $SOURCE
+fi
+echo "  { NULL, NULL, NULL, NULL, 0 }" >> $SOURCE
+echo "};" >> $SOURCE
+echo "const KernelBinary *FindKernelBinary(const std::string &device, const std::string &driver, const std::string &file) {" >> $SOURCE
+echo "  for (const KernelBinary *b = kernelBinaries; b->data != NULL; b++) {" >> $SOURCE
+echo "    if (device == b->device && driver == b->driver && file == b->file)" >> $SOURCE
+echo "      return b;" >> $SOURCE
+echo "  }" >> $SOURCE
+echo "  return NULL;" >> $SOURCE
 echo "}" >> $SOURCE
 
 echo "#endif//#ifndef CL_KERNELS_HPP_" >> $HEADER
\ No newline at end of file
@@ -1,5 +1,6 @@
 
-// Gaussian filter of image
+// Gaussian filter of image. Any image read_imagef accepts: RGBA8,
+// CL_FLOAT, or CL_HALF_FLOAT for half the bytes (half_storage.hpp)
 
 __kernel void gaussian_filter(__read_only image2d_t srcImg,
                               __write_only image2d_t dstImg,
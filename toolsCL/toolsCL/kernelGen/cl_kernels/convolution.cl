@@ -0,0 +1,119 @@
+// 2D convolution of single-channel float images (row pitch == width),
+// applied as a correlation with clamp-to-edge borders.
+//
+// The specialized kernels only exist when the file is built as a variant
+// (Device::GetProgramVariant) with:
+//   -DKW=<mask width> -DKH=<mask height>   odd sizes, the loops unroll fully
+//   -DTILE_W=<w> -DTILE_H=<h>              work-group size
+//   -DVARIANT=<suffix>                     e.g. 3x3, names convolve2d_3x3
+//   -DSEPARABLE                            KW row taps, then KH column taps
+// convolve_generic takes the mask size at run time, for comparison.
+
+#define CLAMPED(src, x, y, width, height) \
+    src[clamp((y), 0, (height) - 1) * (width) + clamp((x), 0, (width) - 1)]
+
+#ifdef KW
+
+#ifdef SEPARABLE
+
+// mask[0..KW-1]
+__kernel __attribute__((reqd_work_group_size(TILE_W, TILE_H, 1)))
+void TEMPLATE(convolve_rows,VARIANT)(__global const float *src, __global float *dst,
+                                      __constant float *mask, int width, int height)
+{
+    __local float tile[TILE_H][TILE_W + KW - 1];
+    int lx = get_local_id(0);
+    int ly = get_local_id(1);
+    int x0 = get_group_id(0) * TILE_W - KW / 2;
+    int y = get_global_id(1);
+    for (int i = lx; i < TILE_W + KW - 1; i += TILE_W)
+        tile[ly][i] = CLAMPED(src, x0 + i, y, width, height);
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    int x = get_global_id(0);
+    if (x < width && y < height)
+    {
+        float sum = 0.0f;
+#pragma unroll
+        for (int k = 0; k < KW; k++)
+            sum += tile[ly][lx + k] * mask[k];
+        dst[y * width + x] = sum;
+    }
+}
+
+// mask[KW..KW+KH-1]
+__kernel __attribute__((reqd_work_group_size(TILE_W, TILE_H, 1)))
+void TEMPLATE(convolve_cols,VARIANT)(__global const float *src, __global float *dst,
+                                      __constant float *mask, int width, int height)
+{
+    __local float tile[TILE_H + KH - 1][TILE_W];
+    int lx = get_local_id(0);
+    int ly = get_local_id(1);
+    int x = get_global_id(0);
+    int y0 = get_group_id(1) * TILE_H - KH / 2;
+    for (int j = ly; j < TILE_H + KH - 1; j += TILE_H)
+        tile[j][lx] = CLAMPED(src, x, y0 + j, width, height);
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    int y = get_global_id(1);
+    if (x < width && y < height)
+    {
+        float sum = 0.0f;
+#pragma unroll
+        for (int k = 0; k < KH; k++)
+            sum += tile[ly + k][lx] * mask[KW + k];
+        dst[y * width + x] = sum;
+    }
+}
+
+#else
+
+// mask: KH rows of KW
+__kernel __attribute__((reqd_work_group_size(TILE_W, TILE_H, 1)))
+void TEMPLATE(convolve2d,VARIANT)(__global const float *src, __global float *dst,
+                                   __constant float *mask, int width, int height)
+{
+    __local float tile[TILE_H + KH - 1][TILE_W + KW - 1];
+    int lx = get_local_id(0);
+    int ly = get_local_id(1);
+    int x0 = get_group_id(0) * TILE_W - KW / 2;
+    int y0 = get_group_id(1) * TILE_H - KH / 2;
+    for (int j = ly; j < TILE_H + KH - 1; j += TILE_H)
+        for (int i = lx; i < TILE_W + KW - 1; i += TILE_W)
+            tile[j][i] = CLAMPED(src, x0 + i, y0 + j, width, height);
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    int x = get_global_id(0);
+    int y = get_global_id(1);
+    if (x < width && y < height)
+    {
+        float sum = 0.0f;
+#pragma unroll
+        for (int j = 0; j < KH; j++)
+        {
+#pragma unroll
+            for (int i = 0; i < KW; i++)
+                sum += tile[ly + j][lx + i] * mask[j * KW + i];
+        }
+        dst[y * width + x] = sum;
+    }
+}
+
+#endif // SEPARABLE
+
+#endif // KW
+
+__kernel void convolve_generic(__global const float *src, __global float *dst,
+                               __constant float *mask, int kw, int kh,
+                               int width, int height)
+{
+    int x = get_global_id(0);
+    int y = get_global_id(1);
+    if (x >= width || y >= height)
+        return;
+    float sum = 0.0f;
+    for (int j = 0; j < kh; j++)
+        for (int i = 0; i < kw; i++)
+            sum += CLAMPED(src, x + i - kw / 2, y + j - kh / 2, width, height) * mask[j * kw + i];
+    dst[y * width + x] = sum;
+}
@@ -0,0 +1,92 @@
+// Elementwise kernels for any length: a grid-stride loop over W-wide
+// vectors (vloadW/vstoreW), then a grid-stride loop over the n % W tail.
+// The grid is sized to the device, not to n. Built per element type,
+// with widths 1, 4 and 8. Host side: elementwise.hpp.
+
+#ifndef GRID_STRIDE
+#define GRID_STRIDE(i, count) \
+    for (uint i = get_global_id(0); i < (count); i += get_global_size(0))
+#define GRID_TAIL(i, W, n) \
+    for (uint i = (n) / (W) * (W) + get_global_id(0); i < (n); i += get_global_size(0))
+#endif
+
+// out = in * alpha
+
+__kernel void TEMPLATE(scale_v1,Dtype)(__global const Dtype *in, __global Dtype *out,
+                                       Dtype alpha, uint n)
+{
+    GRID_STRIDE(i, n)
+        out[i] = in[i] * alpha;
+}
+
+__kernel void TEMPLATE(scale_v4,Dtype)(__global const Dtype *in, __global Dtype *out,
+                                       Dtype alpha, uint n)
+{
+    GRID_STRIDE(v, n / 4)
+        vstore4(vload4(v, in) * alpha, v, out);
+    GRID_TAIL(i, 4, n)
+        out[i] = in[i] * alpha;
+}
+
+__kernel void TEMPLATE(scale_v8,Dtype)(__global const Dtype *in, __global Dtype *out,
+                                       Dtype alpha, uint n)
+{
+    GRID_STRIDE(v, n / 8)
+        vstore8(vload8(v, in) * alpha, v, out);
+    GRID_TAIL(i, 8, n)
+        out[i] = in[i] * alpha;
+}
+
+// out = a + b
+
+__kernel void TEMPLATE(add_v1,Dtype)(__global const Dtype *a, __global const Dtype *b,
+                                     __global Dtype *out, uint n)
+{
+    GRID_STRIDE(i, n)
+        out[i] = a[i] + b[i];
+}
+
+__kernel void TEMPLATE(add_v4,Dtype)(__global const Dtype *a, __global const Dtype *b,
+                                     __global Dtype *out, uint n)
+{
+    GRID_STRIDE(v, n / 4)
+        vstore4(vload4(v, a) + vload4(v, b), v, out);
+    GRID_TAIL(i, 4, n)
+        out[i] = a[i] + b[i];
+}
+
+__kernel void TEMPLATE(add_v8,Dtype)(__global const Dtype *a, __global const Dtype *b,
+                                     __global Dtype *out, uint n)
+{
+    GRID_STRIDE(v, n / 8)
+        vstore8(vload8(v, a) + vload8(v, b), v, out);
+    GRID_TAIL(i, 8, n)
+        out[i] = a[i] + b[i];
+}
+
+// y = alpha * x + y
+
+__kernel void TEMPLATE(axpy_v1,Dtype)(Dtype alpha, __global const Dtype *x, __global Dtype *y,
+                                      uint n)
+{
+    GRID_STRIDE(i, n)
+        y[i] = alpha * x[i] + y[i];
+}
+
+__kernel void TEMPLATE(axpy_v4,Dtype)(Dtype alpha, __global const Dtype *x, __global Dtype *y,
+                                      uint n)
+{
+    GRID_STRIDE(v, n / 4)
+        vstore4(alpha * vload4(v, x) + vload4(v, y), v, y);
+    GRID_TAIL(i, 4, n)
+        y[i] = alpha * x[i] + y[i];
+}
+
+__kernel void TEMPLATE(axpy_v8,Dtype)(Dtype alpha, __global const Dtype *x, __global Dtype *y,
+                                      uint n)
+{
+    GRID_STRIDE(v, n / 8)
+        vstore8(alpha * vload8(v, x) + vload8(v, y), v, y);
+    GRID_TAIL(i, 8, n)
+        y[i] = alpha * x[i] + y[i];
+}
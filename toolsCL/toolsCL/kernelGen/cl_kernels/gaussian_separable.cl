@@ -0,0 +1,66 @@
+// Separable Gaussian filter of image: gaussian_rows then gaussian_cols.
+// Each work-group stages its tile plus a radius-wide halo in __local
+// memory, so every source pixel is read once per group instead of once
+// per tap, and the 2*radius+1 normalized weights come from __constant.
+
+__constant sampler_t clampSampler = CLK_NORMALIZED_COORDS_FALSE |
+                                    CLK_ADDRESS_CLAMP_TO_EDGE |
+                                    CLK_FILTER_NEAREST;
+
+// tile: (local width + 2 * radius) * local height float4
+__kernel void gaussian_rows(__read_only image2d_t srcImg,
+                            __write_only image2d_t dstImg,
+                            __constant float *weights, int radius,
+                            int width, int height,
+                            __local float4 *tile)
+{
+    int lx = get_local_id(0);
+    int lw = get_local_size(0);
+    int tileW = lw + 2 * radius;
+    int x0 = get_group_id(0) * lw - radius;
+    int y = get_global_id(1);
+    __local float4 *row = tile + get_local_id(1) * tileW;
+
+    // the halo is read clamped, so the border repeats the edge pixel
+    for (int i = lx; i < tileW; i += lw)
+        row[i] = read_imagef(srcImg, clampSampler, (int2)(x0 + i, y));
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    int x = get_global_id(0);
+    if (x < width && y < height)
+    {
+        float4 sum = (float4)(0.0f, 0.0f, 0.0f, 0.0f);
+        for (int k = 0; k <= 2 * radius; k++)
+            sum += row[lx + k] * weights[k];
+        write_imagef(dstImg, (int2)(x, y), sum);
+    }
+}
+
+// tile: local width * (local height + 2 * radius) float4
+__kernel void gaussian_cols(__read_only image2d_t srcImg,
+                            __write_only image2d_t dstImg,
+                            __constant float *weights, int radius,
+                            int width, int height,
+                            __local float4 *tile)
+{
+    int lx = get_local_id(0);
+    int ly = get_local_id(1);
+    int lw = get_local_size(0);
+    int lh = get_local_size(1);
+    int tileH = lh + 2 * radius;
+    int x = get_global_id(0);
+    int y0 = get_group_id(1) * lh - radius;
+
+    for (int i = ly; i < tileH; i += lh)
+        tile[i * lw + lx] = read_imagef(srcImg, clampSampler, (int2)(x, y0 + i));
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    int y = get_global_id(1);
+    if (x < width && y < height)
+    {
+        float4 sum = (float4)(0.0f, 0.0f, 0.0f, 0.0f);
+        for (int k = 0; k <= 2 * radius; k++)
+            sum += tile[(ly + k) * lw + lx] * weights[k];
+        write_imagef(dstImg, (int2)(x, y), sum);
+    }
+}
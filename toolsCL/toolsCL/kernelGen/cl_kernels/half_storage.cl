@@ -0,0 +1,10 @@
+// fp16 storage, fp32 arithmetic: vload_half/vstore_half are core OpenCL
+// and need no cl_khr_fp16. Half the bytes of the float kernels for the
+// bandwidth-bound ones. Host side: half_storage.hpp.
+
+__kernel void mul2_half(__global const half* input, 
+					__global half* output)
+{
+	unsigned int id = get_global_id(0);
+	vstore_half_rte(vload_half(id, input) * 2.0f, id, output);
+}
@@ -1,7 +1,8 @@
-
-__kernel void mul2(__global float* input, 
-					__global float* output)
+// Built per element type: mul2_float, mul2_double, mul2_int, mul2_short,
+// mul2_uchar. Integer results wrap like their C counterparts.
+__kernel void TEMPLATE(mul2,Dtype)(__global const Dtype* input, 
+					__global Dtype* output)
 {
 	unsigned int id = get_global_id(0);
-	output[id] = input[id] * 2;
-}
\ No newline at end of file
+	output[id] = input[id] * (Dtype)2;
+}
@@ -0,0 +1,146 @@
+// Reductions of n elements to one value. Built by Reduction
+// (reduction.hpp) through Device::GetProgramVariant, with a prelude that
+// defines:
+//   Dtype, Atype, Atype4, convert_Atype4  input and accumulator types
+//   ATYPE_MIN, ATYPE_MAX                  limits of Atype
+//   REDUCE_OP(a,b), REDUCE_IDENTITY       associative and commutative op
+//   SUBGROUP_REDUCE                       sub_group_reduce_*, optional
+//   ATOMIC_FINISH                         atomic_* into out[0], optional
+// or, for argmin/argmax:
+//   ARG_BETTER(a,b), ARG_WORST            order of the values, start value
+// Every work-group folds its grid-stride share of the input, then its
+// work-items through __local memory, into one partial; the partials are
+// reduced by a further pass, or atomically into out[0].
+
+#ifdef REDUCE_OP
+
+// n elements of in into acc, four at a time, then the tail
+#define ACCUMULATE(acc, in, n) \
+    for (uint v = get_global_id(0); v < (n) / 4; v += get_global_size(0)) { \
+        Atype4 x = convert_Atype4(vload4(v, in)); \
+        acc = REDUCE_OP(acc, REDUCE_OP(REDUCE_OP(x.s0, x.s1), REDUCE_OP(x.s2, x.s3))); \
+    } \
+    for (uint i = (n) / 4 * 4 + get_global_id(0); i < (n); i += get_global_size(0)) \
+        acc = REDUCE_OP(acc, (Atype) in[i]);
+
+// The values of the work-group folded into one
+Atype reduce_group(Atype acc, __local Atype *scratch)
+{
+    uint lid = get_local_id(0);
+#ifdef SUBGROUP_REDUCE
+    acc = SUBGROUP_REDUCE(acc);
+    if (get_sub_group_local_id() == 0)
+        scratch[get_sub_group_id()] = acc;
+    uint active = get_num_sub_groups();
+#else
+    scratch[lid] = acc;
+    uint active = get_local_size(0);
+#endif
+    barrier(CLK_LOCAL_MEM_FENCE);
+    // fold the upper part of the active values onto the lower, any count
+    while (active > 1) {
+        uint kept = (active + 1) / 2;
+        if (lid < active - kept)
+            scratch[lid] = REDUCE_OP(scratch[lid], scratch[lid + kept]);
+        barrier(CLK_LOCAL_MEM_FENCE);
+        active = kept;
+    }
+    return scratch[0];
+}
+
+// scratch: local size Atype
+__kernel void TEMPLATE(reduce_local,Atype)(__global const Dtype *in, uint n,
+                                           __global Atype *out, __local Atype *scratch)
+{
+    Atype acc = REDUCE_IDENTITY;
+    ACCUMULATE(acc, in, n)
+    acc = reduce_group(acc, scratch);
+    if (get_local_id(0) == 0) {
+#ifdef ATOMIC_FINISH
+        ATOMIC_FINISH(out, acc);
+#else
+        out[get_group_id(0)] = acc;
+#endif
+    }
+}
+
+// The partials of a previous pass
+__kernel void TEMPLATE(reduce_partials,Atype)(__global const Atype *in, uint n,
+                                              __global Atype *out, __local Atype *scratch)
+{
+    Atype acc = REDUCE_IDENTITY;
+    ACCUMULATE(acc, in, n)
+    acc = reduce_group(acc, scratch);
+    if (get_local_id(0) == 0)
+        out[get_group_id(0)] = acc;
+}
+
+#endif // REDUCE_OP
+
+#ifdef ARG_BETTER
+
+// (vb, ib) replaces (va, ia): a better value, or the same at a lower index
+#define ARG_TAKE(va, ia, vb, ib) (ARG_BETTER(vb, va) || ((vb) == (va) && (ib) < (ia)))
+
+void argreduce_group(Atype *value, uint *index, __local Atype *values, __local uint *indices)
+{
+    uint lid = get_local_id(0);
+    values[lid] = *value;
+    indices[lid] = *index;
+    barrier(CLK_LOCAL_MEM_FENCE);
+    uint active = get_local_size(0);
+    while (active > 1) {
+        uint kept = (active + 1) / 2;
+        if (lid < active - kept && ARG_TAKE(values[lid], indices[lid], values[lid + kept], indices[lid + kept])) {
+            values[lid] = values[lid + kept];
+            indices[lid] = indices[lid + kept];
+        }
+        barrier(CLK_LOCAL_MEM_FENCE);
+        active = kept;
+    }
+    *value = values[0];
+    *index = indices[0];
+}
+
+// values, indices: local size each
+__kernel void TEMPLATE(argreduce_local,Atype)(__global const Dtype *in, uint n,
+                                              __global Atype *outValue, __global uint *outIndex,
+                                              __local Atype *values, __local uint *indices)
+{
+    Atype value = ARG_WORST;
+    uint index = UINT_MAX;
+    for (uint i = get_global_id(0); i < n; i += get_global_size(0)) {
+        Atype x = (Atype) in[i];
+        if (ARG_TAKE(value, index, x, i)) {
+            value = x;
+            index = i;
+        }
+    }
+    argreduce_group(&value, &index, values, indices);
+    if (get_local_id(0) == 0) {
+        outValue[get_group_id(0)] = value;
+        outIndex[get_group_id(0)] = index;
+    }
+}
+
+// The value and index partials of a previous pass
+__kernel void TEMPLATE(argreduce_partials,Atype)(__global const Atype *in, __global const uint *inIndex,
+                                                 uint n, __global Atype *outValue, __global uint *outIndex,
+                                                 __local Atype *values, __local uint *indices)
+{
+    Atype value = ARG_WORST;
+    uint index = UINT_MAX;
+    for (uint i = get_global_id(0); i < n; i += get_global_size(0)) {
+        if (ARG_TAKE(value, index, in[i], inIndex[i])) {
+            value = in[i];
+            index = inIndex[i];
+        }
+    }
+    argreduce_group(&value, &index, values, indices);
+    if (get_local_id(0) == 0) {
+        outValue[get_group_id(0)] = value;
+        outIndex[get_group_id(0)] = index;
+    }
+}
+
+#endif // ARG_BETTER
@@ -0,0 +1,29 @@
+#include "kernel_types.hpp"
+
+const KernelTypeInfo kernelTypes[] = {
+  { "float", "TYPE_FLOAT", false },
+  { "double", "TYPE_DOUBLE", true },
+  { "int", "TYPE_INT", false },
+  { "short", "TYPE_SHORT", false },
+  { "uchar", "TYPE_UCHAR", false },
+};
+const size_t numKernelTypes = sizeof(kernelTypes) / sizeof(kernelTypes[0]);
+
+std::string InstantiateTypes(const std::string &source)
+{
+  std::string out;
+  for (size_t i = 0; i < numKernelTypes; i++) {
+    const KernelTypeInfo &type = kernelTypes[i];
+    if (type.fp64)
+      out += "#ifdef DOUBLE_SUPPORT_AVAILABLE\n";
+    out += std::string("#define Dtype ") + type.name + "\n";
+    out += std::string("#define TYPE ") + type.id + "\n";
+    //compiler messages keep the line numbers of the file
+    out += "#line 1\n";
+    out += source;
+    out += "\n#undef Dtype\n#undef TYPE\n";
+    if (type.fp64)
+      out += "#endif\n";
+  }
+  return out;
+}
@@ -0,0 +1,45 @@
+#ifndef KERNEL_TYPES_HPP
+#define KERNEL_TYPES_HPP
+#include <string>
+#include <stddef.h>
+#include <CL/cl.h>
+
+//Element types of templated kernel files. A file that declares
+//  __kernel void TEMPLATE(mul2,Dtype)(__global const Dtype *in, ...)
+//is compiled once per entry, with Dtype and TYPE defined, and provides
+//mul2_float, mul2_double, ... Helper functions of such a file need
+//TEMPLATE names too. kernelGen/cl_kernels.sh keeps the same list.
+struct KernelTypeInfo {
+  const char *name;  //Dtype, and the suffix of the kernel names
+  const char *id;    //TYPE, one of the TYPE_* values of header.cl
+  bool fp64;         //only built where DOUBLE_SUPPORT_AVAILABLE
+};
+extern const KernelTypeInfo kernelTypes[];
+extern const size_t numKernelTypes;
+
+//The source of a templated file repeated once per type
+std::string InstantiateTypes(const std::string &source);
+
+//Kernel name suffix of a host type, and the device query of its preferred
+//vector width. There is no instantiation for the other types, so a
+//Run<long> fails to compile rather than to launch.
+template <typename T> struct KernelType;
+#define KERNEL_TYPE(T, name, width) \
+  template <> struct KernelType<T> { \
+    static const char *Name() { return name; } \
+    static cl_device_info PreferredWidth() { return width; } \
+  };
+KERNEL_TYPE(cl_float, "float", CL_DEVICE_PREFERRED_VECTOR_WIDTH_FLOAT)
+KERNEL_TYPE(cl_double, "double", CL_DEVICE_PREFERRED_VECTOR_WIDTH_DOUBLE)
+KERNEL_TYPE(cl_int, "int", CL_DEVICE_PREFERRED_VECTOR_WIDTH_INT)
+KERNEL_TYPE(cl_short, "short", CL_DEVICE_PREFERRED_VECTOR_WIDTH_SHORT)
+KERNEL_TYPE(cl_uchar, "uchar", CL_DEVICE_PREFERRED_VECTOR_WIDTH_CHAR)
+#undef KERNEL_TYPE
+
+//TEMPLATE(name,T) of the kernel files: TemplateName<cl_uchar>("mul2") == "mul2_uchar"
+template <typename T>
+std::string TemplateName(const std::string &name) {
+  return name + "_" + KernelType<T>::Name();
+}
+
+#endif //KERNEL_TYPES_HPP
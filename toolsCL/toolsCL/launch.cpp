@@ -0,0 +1,104 @@
+#include "launch.hpp"
+#include <map>
+#include <iostream>
+#include <string.h>
+
+//Kernel instances are per thread (Device::GetKernel), so is their state
+static thread_local std::map<unsigned long long, std::map<cl_kernel, KernelArgState> > threadArgs;
+
+KernelArgState &GetKernelArgState(unsigned long long generation, cl_kernel kernel) {
+  return threadArgs[generation][kernel];
+}
+
+void ForgetKernelArgs(unsigned long long generation, cl_kernel kernel) {
+  threadArgs[generation].erase(kernel);
+}
+
+bool DescribeKernelArgs(cl_kernel kernel, KernelArgState &state) {
+  char function[256] = { 0 };
+  clGetKernelInfo(kernel, CL_KERNEL_FUNCTION_NAME, sizeof(function) - 1, function, NULL);
+  state.function = function;
+  cl_int err = clGetKernelInfo(kernel, CL_KERNEL_NUM_ARGS, sizeof(cl_uint), &state.numArgs, NULL);
+  if (err != CL_SUCCESS) {
+    std::cout << "Err: Launch cannot query kernel " << state.function << " ( Err = " << err << " )" << std::endl;
+    return false;
+  }
+  state.checked.assign(state.numArgs, NULL);
+  state.value.assign(state.numArgs, std::vector<unsigned char>());
+  state.address.clear();
+  state.typeName.clear();
+  //only programs built with -cl-kernel-arg-info answer these
+  for (cl_uint i = 0; i < state.numArgs; i++) {
+    cl_kernel_arg_address_qualifier address = 0;
+    char type[256] = { 0 };
+    if (clGetKernelArgInfo(kernel, i, CL_KERNEL_ARG_ADDRESS_QUALIFIER, sizeof(address), &address, NULL) != CL_SUCCESS
+        || clGetKernelArgInfo(kernel, i, CL_KERNEL_ARG_TYPE_NAME, sizeof(type) - 1, type, NULL) != CL_SUCCESS) {
+      state.address.clear();
+      state.typeName.clear();
+      break;
+    }
+    state.address.push_back(address);
+    state.typeName.push_back(type);
+  }
+  state.described = true;
+  return true;
+}
+
+void ReportArgCount(const KernelArgState &state, cl_uint given) {
+  std::cout << "Err: Launch of " << state.function << " with " << given << " arguments, the kernel takes "
+      << state.numArgs << std::endl;
+}
+
+bool CheckKernelArg(KernelArgState &state, cl_uint index, KernelArgClass cls, const char *name) {
+  if (index >= state.address.size())
+    return true;
+  cl_kernel_arg_address_qualifier address = state.address[index];
+  const std::string &type = state.typeName[index];
+  bool ok;
+  switch (cls) {
+  case ARG_MEMORY:
+    ok = address == CL_KERNEL_ARG_ADDRESS_GLOBAL || address == CL_KERNEL_ARG_ADDRESS_CONSTANT;
+    break;
+  case ARG_LOCAL:
+    ok = address == CL_KERNEL_ARG_ADDRESS_LOCAL;
+    break;
+  default:
+    ok = address == CL_KERNEL_ARG_ADDRESS_PRIVATE && (name == NULL || type == name);
+    break;
+  }
+  if (!ok) {
+    const char *expected = cls == ARG_MEMORY ? "cl_mem" : (cls == ARG_LOCAL ? "LocalMemory" : (name ? name : "a struct"));
+    std::cout << "Err: Launch of " << state.function << ": argument " << index << " is " << type
+        << ", given " << expected << std::endl;
+  }
+  return ok;
+}
+
+cl_int SetKernelArgCached(cl_kernel kernel, KernelArgState &state, cl_uint index, size_t size,
+    const void *value, bool cached) {
+  //a __local argument is remembered by its size alone
+  std::vector<unsigned char> &last = state.value[index];
+  size_t stored = value != NULL ? size : sizeof(size_t);
+  const void *bytes = value != NULL ? value : &size;
+  if (cached && last.size() == stored + 1 && last[0] == (value != NULL) && memcmp(&last[1], bytes, stored) == 0) {
+    state.skips++;
+    return CL_SUCCESS;
+  }
+  cl_int err = clSetKernelArg(kernel, index, size, value);
+  if (err != CL_SUCCESS) {
+    last.clear();
+    std::cout << "Err: Launch of " << state.function << ": clSetKernelArg " << index << " ( Err = "
+        << err << " )" << std::endl;
+    return err;
+  }
+  if (!cached) {
+    last.clear();
+    state.sets++;
+    return CL_SUCCESS;
+  }
+  last.resize(stored + 1);
+  last[0] = value != NULL;
+  memcpy(&last[1], bytes, stored);
+  state.sets++;
+  return CL_SUCCESS;
+}
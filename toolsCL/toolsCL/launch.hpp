@@ -0,0 +1,175 @@
+#ifndef LAUNCH_HPP
+#define LAUNCH_HPP
+#include <string>
+#include <vector>
+#include <CL/cl.h>
+#include "autotuner.hpp"
+
+//Global (and optionally local) work size of a launch:
+//  NDRange(n)  NDRange(w, h)  NDRange(w, h).Local(16, 16)
+struct NDRange {
+  explicit NDRange(size_t g0, size_t g1 = 0, size_t g2 = 0) : dims(g2 ? 3 : (g1 ? 2 : 1)), hasLocal(false) {
+    global[0] = g0; global[1] = g1 ? g1 : 1; global[2] = g2 ? g2 : 1;
+    local[0] = local[1] = local[2] = 1;
+  }
+  NDRange &Local(size_t l0, size_t l1 = 1, size_t l2 = 1) {
+    local[0] = l0; local[1] = l1; local[2] = l2;
+    hasLocal = true;
+    return *this;
+  }
+  cl_uint dims;
+  bool hasLocal;
+  size_t global[3];
+  size_t local[3];
+};
+
+//Size of a __local pointer argument
+struct LocalMemory {
+  explicit LocalMemory(size_t bytes) : bytes(bytes) {}
+  size_t bytes;
+};
+
+//What an argument may bind to, checked against CL_KERNEL_ARG_ADDRESS_QUALIFIER
+enum KernelArgClass {
+  ARG_PRIVATE,  //by-value scalar, vector or struct
+  ARG_MEMORY,   //cl_mem: __global/__constant pointer or image
+  ARG_LOCAL,    //LocalMemory
+  ARG_SAMPLER
+};
+
+//OpenCL C type name of a host argument type, NULL when there is no
+//single name to compare with (structs)
+template <typename T> struct KernelArgTraits {
+  static const KernelArgClass cls = ARG_PRIVATE;
+  static const char *Name() { return NULL; }
+};
+#define KERNEL_ARG_TRAITS(T, c, name) \
+  template <> struct KernelArgTraits<T> { \
+    static const KernelArgClass cls = c; \
+    static const char *Name() { return name; } \
+  };
+KERNEL_ARG_TRAITS(cl_mem, ARG_MEMORY, NULL)
+KERNEL_ARG_TRAITS(LocalMemory, ARG_LOCAL, NULL)
+KERNEL_ARG_TRAITS(cl_sampler, ARG_SAMPLER, "sampler_t")
+KERNEL_ARG_TRAITS(cl_char, ARG_PRIVATE, "char")
+KERNEL_ARG_TRAITS(cl_uchar, ARG_PRIVATE, "uchar")
+KERNEL_ARG_TRAITS(cl_short, ARG_PRIVATE, "short")
+KERNEL_ARG_TRAITS(cl_ushort, ARG_PRIVATE, "ushort")
+KERNEL_ARG_TRAITS(cl_int, ARG_PRIVATE, "int")
+KERNEL_ARG_TRAITS(cl_uint, ARG_PRIVATE, "uint")
+KERNEL_ARG_TRAITS(cl_long, ARG_PRIVATE, "long")
+KERNEL_ARG_TRAITS(cl_ulong, ARG_PRIVATE, "ulong")
+KERNEL_ARG_TRAITS(cl_float, ARG_PRIVATE, "float")
+KERNEL_ARG_TRAITS(cl_double, ARG_PRIVATE, "double")
+KERNEL_ARG_TRAITS(cl_int2, ARG_PRIVATE, "int2")
+KERNEL_ARG_TRAITS(cl_int4, ARG_PRIVATE, "int4")
+KERNEL_ARG_TRAITS(cl_uint2, ARG_PRIVATE, "uint2")
+KERNEL_ARG_TRAITS(cl_uint4, ARG_PRIVATE, "uint4")
+KERNEL_ARG_TRAITS(cl_float2, ARG_PRIVATE, "float2")
+KERNEL_ARG_TRAITS(cl_float4, ARG_PRIVATE, "float4")
+#undef KERNEL_ARG_TRAITS
+
+//One address per host type, to remember which type an argument was checked with
+template <typename T> struct KernelArgId { static char id; };
+template <typename T> char KernelArgId<T>::id;
+
+//Per thread and kernel instance: the argument metadata, read once, the
+//values of the last launch and the tuned local size of the last
+//launch without one
+struct KernelArgState {
+  KernelArgState() : described(false), numArgs(0), sets(0), skips(0), tunedQueue(NULL), tunedDims(0) {
+    tunedGlobal[0] = tunedGlobal[1] = tunedGlobal[2] = 0;
+  }
+  bool described;
+  cl_uint numArgs;
+  std::string function;
+  std::vector<cl_kernel_arg_address_qualifier> address;  //empty without -cl-kernel-arg-info
+  std::vector<std::string> typeName;
+  std::vector<const void *> checked;                     //KernelArgId of the type last accepted
+  std::vector<std::vector<unsigned char> > value;        //bytes of the last value, empty if unset
+  size_t sets;   //clSetKernelArg calls made
+  size_t skips;  //arguments left as they were
+  cl_command_queue tunedQueue;  //queue and global size tunedLocal is for
+  cl_uint tunedDims;
+  size_t tunedGlobal[3];
+  LocalSize tunedLocal;
+};
+
+//The calling thread's state of kernel, owned by Device generation
+KernelArgState &GetKernelArgState(unsigned long long generation, cl_kernel kernel);
+//Drop what this thread remembers of kernel: after setting its arguments
+//by hand, and before releasing a kernel created outside GetKernel, whose
+//handle a later kernel may reuse
+void ForgetKernelArgs(unsigned long long generation, cl_kernel kernel);
+bool DescribeKernelArgs(cl_kernel kernel, KernelArgState &state);
+void ReportArgCount(const KernelArgState &state, cl_uint given);
+bool CheckKernelArg(KernelArgState &state, cl_uint index, KernelArgClass cls, const char *name);
+//cached false sets the argument regardless of its last value
+cl_int SetKernelArgCached(cl_kernel kernel, KernelArgState &state, cl_uint index, size_t size,
+    const void *value, bool cached = true);
+
+template <typename T>
+inline cl_int LaunchArg(cl_kernel kernel, KernelArgState &state, cl_uint index, const T &arg) {
+  typedef KernelArgTraits<T> Traits;
+  if (state.checked[index] != &KernelArgId<T>::id) {
+    if (!CheckKernelArg(state, index, Traits::cls, Traits::Name()))
+      return CL_INVALID_ARG_VALUE;
+    state.checked[index] = &KernelArgId<T>::id;
+  }
+  //a released cl_mem or cl_sampler handle may come back for a new object,
+  //so equal handle bytes do not mean the same argument
+  bool handle = Traits::cls == ARG_MEMORY || Traits::cls == ARG_SAMPLER;
+  return SetKernelArgCached(kernel, state, index, sizeof(T), &arg, !handle);
+}
+
+inline cl_int LaunchArg(cl_kernel kernel, KernelArgState &state, cl_uint index, const LocalMemory &arg) {
+  if (state.checked[index] != &KernelArgId<LocalMemory>::id) {
+    if (!CheckKernelArg(state, index, ARG_LOCAL, NULL))
+      return CL_INVALID_ARG_VALUE;
+    state.checked[index] = &KernelArgId<LocalMemory>::id;
+  }
+  return SetKernelArgCached(kernel, state, index, arg.bytes, NULL);
+}
+
+inline cl_int LaunchArgs(cl_kernel, KernelArgState &, cl_uint) {
+  return CL_SUCCESS;
+}
+
+template <typename T, typename... Rest>
+inline cl_int LaunchArgs(cl_kernel kernel, KernelArgState &state, cl_uint index, const T &first,
+    const Rest &... rest) {
+  cl_int err = LaunchArg(kernel, state, index, first);
+  if (err != CL_SUCCESS)
+    return err;
+  return LaunchArgs(kernel, state, index + 1, rest...);
+}
+
+//Set the by-value and __local arguments that changed since this kernel
+//instance's last launch on this thread, and every memory object and
+//sampler. The count is checked against the kernel, and each
+//argument's kind and type name too when the program was built with
+//-cl-kernel-arg-info. Arguments set with clSetKernelArg in between are
+//not seen: call ForgetKernelArgs after doing so.
+template <typename... Args>
+cl_int SetKernelArgs(unsigned long long generation, cl_kernel kernel, const Args &... args) {
+  KernelArgState &state = GetKernelArgState(generation, kernel);
+  if (!state.described && !DescribeKernelArgs(kernel, state))
+    return CL_INVALID_KERNEL;
+  if (state.numArgs != sizeof...(Args)) {
+    ReportArgCount(state, sizeof...(Args));
+    return CL_INVALID_KERNEL_ARGS;
+  }
+  return LaunchArgs(kernel, state, 0, args...);
+}
+
+template <typename... Args>
+cl_int LaunchKernel(cl_command_queue queue, unsigned long long generation, cl_kernel kernel,
+    const NDRange &range, cl_event *event, const Args &... args) {
+  cl_int err = SetKernelArgs(generation, kernel, args...);
+  if (err != CL_SUCCESS)
+    return err;
+  return clEnqueueNDRangeKernel(queue, kernel, range.dims, NULL, range.global,
+      range.hasLocal ? range.local : NULL, 0, NULL, event);
+}
+
+#endif //LAUNCH_HPP
@@ -0,0 +1,276 @@
+#include "ndrange_split.hpp"
+#include "device.hpp"
+#include <iostream>
+#include <algorithm>
+
+//No device drops below this share, so every device keeps being measured
+static const double minShare = 0.01;
+
+NDRangeSplitter::NDRangeSplitter(Device &device, double smoothing)
+    : smoothing(smoothing), dev(device) {
+  cl_uint n = dev.numContextDevices;
+  double total = 0;
+  for (cl_uint d = 0; d < n; d++) {
+    weights.push_back(ComputeEstimate(DescribeDevice(dev.Selected.platform, dev.pDevices[d])));
+    total += weights[d];
+  }
+  for (cl_uint d = 0; d < n; d++)
+    weights[d] = total > 0 ? weights[d] / total : 1.0 / n;
+  lastMs.resize(n, 0);
+}
+
+//Cut total work-items (or rows) into one slice per device. Slice sizes
+//are multiples of granularity (the work-group size), the tail of an
+//uneven total goes to the device with the largest share.
+void NDRangeSplitter::Split(size_t total, size_t granularity, std::vector<Slice> &slices)
+{
+  if (granularity == 0)
+    granularity = 1;
+  size_t units = total / granularity;
+  size_t n = weights.size();
+  std::vector<size_t> counts(n, 0);
+  size_t given = 0, largest = 0;
+  for (size_t d = 0; d < n; d++) {
+    counts[d] = std::min((size_t) (units * weights[d]), units - given);
+    given += counts[d];
+    if (weights[d] > weights[largest])
+      largest = d;
+  }
+  counts[largest] += units - given;
+
+  slices.clear();
+  size_t offset = 0;
+  for (size_t d = 0; d < n; d++) {
+    Slice s;
+    s.device = (cl_uint) d;
+    s.offset = offset;
+    s.count = counts[d] * granularity;
+    if (d == largest)
+      s.count += total - units * granularity;
+    slices.push_back(s);
+    offset += s.count;
+  }
+}
+
+//Run a 1D kernel whose work-item i only touches element i of each split
+//buffer. The kernel sees its slice from index 0; arguments that are not
+//split must be set by the caller beforehand.
+cl_int NDRangeSplitter::Run1D(cl_kernel kernel, size_t global, size_t local,
+    const std::vector<SplitBuffer> &buffers)
+{
+  std::vector<Slice> slices;
+  Split(global, local, slices);
+  std::vector<std::vector<cl_event> > events(slices.size());
+  std::vector<cl_mem> mems;
+  cl_int err = CL_SUCCESS;
+  for (size_t i = 0; i < slices.size() && err == CL_SUCCESS; i++) {
+    const Slice &s = slices[i];
+    if (s.count == 0)
+      continue;
+    cl_command_queue queue = dev.Queues[s.device];
+    cl_event event = NULL;
+    std::vector<cl_mem> gather;
+    for (size_t b = 0; b < buffers.size() && err == CL_SUCCESS; b++) {
+      const SplitBuffer &sb = buffers[b];
+      size_t bytes = s.count * sb.elementSize;
+      cl_mem mem = clCreateBuffer(dev.Context, sb.flags, bytes, NULL, &err);
+      if (mem == NULL)
+        break;
+      mems.push_back(mem);
+      if (!(sb.flags & CL_MEM_WRITE_ONLY)) {
+        ProfileEvent pe(dev.Prof, "split write", PROFILE_WRITE, bytes, &event);
+        err = clEnqueueWriteBuffer(queue, mem, CL_FALSE, 0, bytes,
+            (char *) sb.host + s.offset * sb.elementSize, 0, NULL, pe.Out());
+        if (err == CL_SUCCESS)
+          events[i].push_back(event);
+      }
+      if (err == CL_SUCCESS)
+        err = clSetKernelArg(kernel, sb.arg, sizeof(cl_mem), &mem);
+      gather.push_back(mem);
+    }
+    if (err != CL_SUCCESS)
+      break;
+
+    size_t count = s.count;
+    {
+      ProfileEvent pe(dev.Prof, kernel, &event);
+      err = clEnqueueNDRangeKernel(queue, kernel, 1, NULL, &count,
+          local > 0 ? &local : NULL, 0, NULL, pe.Out());
+    }
+    if (err != CL_SUCCESS)
+      break;
+    events[i].push_back(event);
+
+    for (size_t b = 0; b < buffers.size() && err == CL_SUCCESS; b++) {
+      const SplitBuffer &sb = buffers[b];
+      if (sb.flags & CL_MEM_READ_ONLY)
+        continue;
+      ProfileEvent pe(dev.Prof, "split read", PROFILE_READ, s.count * sb.elementSize, &event);
+      err = clEnqueueReadBuffer(queue, gather[b], CL_FALSE, 0, s.count * sb.elementSize,
+          (char *) sb.host + s.offset * sb.elementSize, 0, NULL, pe.Out());
+      if (err == CL_SUCCESS)
+        events[i].push_back(event);
+    }
+    clFlush(queue);
+  }
+  OCL_CHECK(err, "NDRangeSplitter::Run1D");
+
+  {
+    HostSpan span(dev.Prof, "wait split");
+    for (size_t i = 0; i < slices.size(); i++)
+      clFinish(dev.Queues[slices[i].device]);
+  }
+  if (err == CL_SUCCESS)
+    Update(slices, events);
+  for (size_t i = 0; i < events.size(); i++) {
+    for (size_t e = 0; e < events[i].size(); e++)
+      clReleaseEvent(events[i][e]);
+  }
+  for (size_t i = 0; i < mems.size(); i++)
+    clReleaseMemObject(mems[i]);
+  return err;
+}
+
+//Run a 2D image kernel split by rows. Each device gets its rows plus
+//halo rows above and below (clamped at the image border), so a filter
+//reading halo pixels around its own sees the same input as on one
+//device. The kernel is launched with a global offset that skips the
+//top halo and its height argument, if any, is set to the slice height.
+cl_int NDRangeSplitter::RunImage2D(cl_kernel kernel, size_t width, size_t height, size_t halo,
+    const cl_image_format &format, size_t pixelSize, const void *src, void *dst,
+    cl_uint srcArg, cl_uint dstArg, int heightArg)
+{
+  std::vector<Slice> slices;
+  Split(height, 1, slices);
+  std::vector<std::vector<cl_event> > events(slices.size());
+  std::vector<cl_mem> mems;
+  size_t rowPitch = width * pixelSize;
+  cl_int err = CL_SUCCESS;
+  for (size_t i = 0; i < slices.size() && err == CL_SUCCESS; i++) {
+    Slice &s = slices[i];
+    if (s.count == 0)
+      continue;
+    s.haloBefore = std::min(halo, s.offset);
+    s.haloAfter = std::min(halo, height - s.offset - s.count);
+    size_t rows = s.count + s.haloBefore + s.haloAfter;
+    cl_command_queue queue = dev.Queues[s.device];
+    cl_event event = NULL;
+
+    cl_mem srcImage = clCreateImage2D(dev.Context, CL_MEM_READ_ONLY, &format, width, rows, 0, NULL, &err);
+    if (srcImage == NULL)
+      break;
+    mems.push_back(srcImage);
+    cl_mem dstImage = clCreateImage2D(dev.Context, CL_MEM_WRITE_ONLY, &format, width, rows, 0, NULL, &err);
+    if (dstImage == NULL)
+      break;
+    mems.push_back(dstImage);
+
+    size_t origin[3] = { 0, 0, 0 };
+    size_t region[3] = { width, rows, 1 };
+    {
+      ProfileEvent pe(dev.Prof, "split write image", PROFILE_WRITE, rows * rowPitch, &event);
+      err = clEnqueueWriteImage(queue, srcImage, CL_FALSE, origin, region, rowPitch, 0,
+          (const char *) src + (s.offset - s.haloBefore) * rowPitch, 0, NULL, pe.Out());
+    }
+    if (err != CL_SUCCESS)
+      break;
+    events[i].push_back(event);
+
+    cl_int sliceHeight = (cl_int) rows;
+    err = clSetKernelArg(kernel, srcArg, sizeof(cl_mem), &srcImage);
+    err |= clSetKernelArg(kernel, dstArg, sizeof(cl_mem), &dstImage);
+    if (heightArg >= 0)
+      err |= clSetKernelArg(kernel, (cl_uint) heightArg, sizeof(cl_int), &sliceHeight);
+    if (err != CL_SUCCESS)
+      break;
+    size_t offset[2] = { 0, s.haloBefore };
+    size_t global[2] = { width, s.count };
+    {
+      ProfileEvent pe(dev.Prof, kernel, &event);
+      err = clEnqueueNDRangeKernel(queue, kernel, 2, offset, global, NULL, 0, NULL, pe.Out());
+    }
+    if (err != CL_SUCCESS)
+      break;
+    events[i].push_back(event);
+
+    origin[1] = s.haloBefore;
+    region[1] = s.count;
+    {
+      ProfileEvent pe(dev.Prof, "split read image", PROFILE_READ, s.count * rowPitch, &event);
+      err = clEnqueueReadImage(queue, dstImage, CL_FALSE, origin, region, rowPitch, 0,
+          (char *) dst + s.offset * rowPitch, 0, NULL, pe.Out());
+    }
+    if (err != CL_SUCCESS)
+      break;
+    events[i].push_back(event);
+    clFlush(queue);
+  }
+  OCL_CHECK(err, "NDRangeSplitter::RunImage2D");
+
+  {
+    HostSpan span(dev.Prof, "wait split");
+    for (size_t i = 0; i < slices.size(); i++)
+      clFinish(dev.Queues[slices[i].device]);
+  }
+  if (err == CL_SUCCESS)
+    Update(slices, events);
+  for (size_t i = 0; i < events.size(); i++) {
+    for (size_t e = 0; e < events[i].size(); e++)
+      clReleaseEvent(events[i][e]);
+  }
+  for (size_t i = 0; i < mems.size(); i++)
+    clReleaseMemObject(mems[i]);
+  return err;
+}
+
+//Throughput of each device = its work-items over the device time from
+//its first upload to its last download. Each measured device moves its
+//weight towards its share of the measured throughput.
+void NDRangeSplitter::Update(const std::vector<Slice> &slices,
+    std::vector<std::vector<cl_event> > &events)
+{
+  std::vector<double> rate(weights.size(), 0);
+  double measuredWeight = 0, measuredRate = 0;
+  for (size_t i = 0; i < slices.size(); i++) {
+    const Slice &s = slices[i];
+    if (s.count == 0 || events[i].empty())
+      continue;
+    cl_ulong first = 0, last = 0;
+    for (size_t e = 0; e < events[i].size(); e++) {
+      cl_ulong start = 0, end = 0;
+      clGetEventProfilingInfo(events[i][e], CL_PROFILING_COMMAND_START, sizeof(cl_ulong), &start, NULL);
+      clGetEventProfilingInfo(events[i][e], CL_PROFILING_COMMAND_END, sizeof(cl_ulong), &end, NULL);
+      if (first == 0 || start < first)
+        first = start;
+      last = std::max(last, end);
+    }
+    if (last <= first)
+      continue;
+    lastMs[s.device] = (last - first) / 1e6;
+    rate[s.device] = s.count / (double) (last - first);
+    measuredWeight += weights[s.device];
+    measuredRate += rate[s.device];
+  }
+  if (measuredRate <= 0)
+    return;
+
+  double total = 0;
+  for (size_t d = 0; d < weights.size(); d++) {
+    if (rate[d] > 0) {
+      double target = rate[d] / measuredRate * measuredWeight;
+      weights[d] = (1 - smoothing) * weights[d] + smoothing * target;
+    }
+    weights[d] = std::max(weights[d], minShare);
+    total += weights[d];
+  }
+  for (size_t d = 0; d < weights.size(); d++)
+    weights[d] /= total;
+}
+
+void NDRangeSplitter::Display()
+{
+  for (size_t d = 0; d < weights.size(); d++) {
+    std::cout << "\t" << d << "\t" << Device::GetDeviceString(dev.pDevices[d], CL_DEVICE_NAME)
+        << "\tshare " << weights[d] * 100 << " %\tlast " << lastMs[d] << " ms" << std::endl;
+  }
+}
@@ -0,0 +1,56 @@
+#ifndef NDRANGE_SPLIT_HPP
+#define NDRANGE_SPLIT_HPP
+#include <vector>
+#include <CL/cl.h>
+
+class Device;
+
+//A host array indexed by the work-item id, cut along with the range.
+//CL_MEM_READ_ONLY slices are uploaded, CL_MEM_WRITE_ONLY slices are
+//gathered back, CL_MEM_READ_WRITE both.
+struct SplitBuffer {
+  SplitBuffer(cl_uint arg, void *host, size_t elementSize, cl_mem_flags flags)
+      : arg(arg), host(host), elementSize(elementSize), flags(flags) {
+  }
+  cl_uint arg;          //kernel argument index
+  void *host;
+  size_t elementSize;   //bytes per work-item
+  cl_mem_flags flags;
+};
+
+//The part of the range one device runs
+struct Slice {
+  Slice() : device(0), offset(0), count(0), haloBefore(0), haloAfter(0) {}
+  cl_uint device;      //index into Device::pDevices and Device::Queues
+  size_t offset;       //first work-item (1D) or row (2D) owned
+  size_t count;        //work-items or rows owned
+  size_t haloBefore;   //rows read above the slice
+  size_t haloAfter;    //rows read below the slice
+};
+
+//Runs one NDRange across every device of a Device context. Each device
+//gets a share of the range proportional to its weight; the weights
+//start from compute units x clock and follow the throughput measured
+//from the events of every launch (exponential moving average).
+class NDRangeSplitter {
+  public:
+    NDRangeSplitter(Device &device, double smoothing = 0.5);
+
+    std::vector<double> weights;   //share of the range per device, sums to 1
+    std::vector<double> lastMs;    //device time of each slice in the last launch
+    double smoothing;              //weight of the latest launch in the average
+
+    void Split(size_t total, size_t granularity, std::vector<Slice> &slices);
+    cl_int Run1D(cl_kernel kernel, size_t global, size_t local,
+        const std::vector<SplitBuffer> &buffers);
+    cl_int RunImage2D(cl_kernel kernel, size_t width, size_t height, size_t halo,
+        const cl_image_format &format, size_t pixelSize, const void *src, void *dst,
+        cl_uint srcArg, cl_uint dstArg, int heightArg);
+    void Display();
+
+  private:
+    Device &dev;
+    void Update(const std::vector<Slice> &slices, std::vector<std::vector<cl_event> > &events);
+};
+
+#endif //NDRANGE_SPLIT_HPP
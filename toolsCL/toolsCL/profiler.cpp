@@ -0,0 +1,340 @@
+#include "profiler.hpp"
+#include <iostream>
+#include <iomanip>
+#include <map>
+#include <algorithm>
+#include <fstream>
+#include <stdio.h>
+
+Profiler::~Profiler() {
+  for (size_t i = 0; i < pending.size(); i++)
+    clReleaseEvent(pending[i].event);
+}
+
+const char *Profiler::KindName(ProfileKind kind) {
+  switch (kind) {
+    case PROFILE_KERNEL: return "kernel";
+    case PROFILE_WRITE: return "write";
+    case PROFILE_READ: return "read";
+    case PROFILE_COPY: return "copy";
+    case PROFILE_MAP: return "map";
+    default: return "other";
+  }
+}
+
+void Profiler::Add(cl_event event, const std::string &name, ProfileKind kind, size_t bytes) {
+  if (event == NULL)
+    return;
+  clRetainEvent(event);
+  Pending p;
+  p.event = event;
+  p.name = name;
+  p.kind = kind;
+  p.bytes = bytes;
+  bool collect = false;
+  {
+    std::lock_guard<std::mutex> guard(mutex);
+    pending.push_back(p);
+    collect = maxPending > 0 && pending.size() >= collectAt;
+    if (collect)
+      collectAt = (size_t) -1;  //one Collect at a time from Add
+  }
+  //read what has completed so that long runs hold few events
+  if (collect)
+    Collect(false);
+}
+
+void Profiler::Collect(bool wait) {
+  //the events are read outside the lock: waiting on them must not hold up
+  //the threads that Add
+  std::vector<Pending> batch;
+  {
+    std::lock_guard<std::mutex> guard(mutex);
+    batch.swap(pending);
+  }
+  std::vector<ProfileRecord> done;
+  size_t kept = 0;
+  for (size_t i = 0; i < batch.size(); i++) {
+    Pending &p = batch[i];
+    cl_int status = CL_QUEUED;
+    if (wait)
+      clWaitForEvents(1, &p.event);
+    clGetEventInfo(p.event, CL_EVENT_COMMAND_EXECUTION_STATUS, sizeof(cl_int), &status, NULL);
+    if (status > CL_COMPLETE) {
+      batch[kept++] = p;
+      continue;
+    }
+    //a failed command (negative status) has no timestamps
+    if (status == CL_COMPLETE) {
+      ProfileRecord r;
+      r.name = p.name;
+      r.kind = p.kind;
+      r.bytes = p.bytes;
+      r.queue = NULL;
+      r.queued = r.submit = r.start = r.end = 0;
+      clGetEventInfo(p.event, CL_EVENT_COMMAND_QUEUE, sizeof(cl_command_queue), &r.queue, NULL);
+      clGetEventProfilingInfo(p.event, CL_PROFILING_COMMAND_QUEUED, sizeof(cl_ulong), &r.queued, NULL);
+      clGetEventProfilingInfo(p.event, CL_PROFILING_COMMAND_SUBMIT, sizeof(cl_ulong), &r.submit, NULL);
+      clGetEventProfilingInfo(p.event, CL_PROFILING_COMMAND_START, sizeof(cl_ulong), &r.start, NULL);
+      clGetEventProfilingInfo(p.event, CL_PROFILING_COMMAND_END, sizeof(cl_ulong), &r.end, NULL);
+      done.push_back(r);
+    }
+    clReleaseEvent(p.event);
+  }
+  batch.resize(kept);
+  std::lock_guard<std::mutex> guard(mutex);
+  records.insert(records.end(), done.begin(), done.end());
+  pending.insert(pending.end(), batch.begin(), batch.end());
+  //the next Collect from Add once maxPending more are in
+  collectAt = pending.size() + maxPending;
+}
+
+std::vector<ProfileRecord> Profiler::Records() {
+  std::lock_guard<std::mutex> guard(mutex);
+  return records;
+}
+
+void Profiler::Reset() {
+  Collect(true);
+  std::lock_guard<std::mutex> guard(mutex);
+  records.clear();
+  hostRecords.clear();
+}
+
+//Nearest-rank percentile of sorted values
+static double Percentile(const std::vector<double> &sorted, double p) {
+  if (sorted.empty())
+    return 0;
+  size_t rank = (size_t) (p / 100.0 * sorted.size() + 0.5);
+  rank = std::min(std::max(rank, (size_t) 1), sorted.size());
+  return sorted[rank - 1];
+}
+
+void Profiler::Report() {
+  Collect(true);
+  std::vector<ProfileRecord> all = Records();
+
+  struct Group {
+    Group() : bytes(0), waitMs(0) {}
+    std::vector<double> ms;
+    size_t bytes;
+    double waitMs;   //queued -> start
+  };
+  std::map<std::pair<int, std::string>, Group> groups;
+  double kindMs[PROFILE_OTHER + 1] = { 0 };
+  double waitMs = 0;
+  for (size_t i = 0; i < all.size(); i++) {
+    const ProfileRecord &r = all[i];
+    Group &g = groups[std::make_pair((int) r.kind, r.name)];
+    double ms = r.end > r.start ? (r.end - r.start) / 1e6 : 0;
+    double wait = r.start > r.queued ? (r.start - r.queued) / 1e6 : 0;
+    g.ms.push_back(ms);
+    g.bytes += r.bytes;
+    g.waitMs += wait;
+    kindMs[r.kind] += ms;
+    waitMs += wait;
+  }
+
+  std::cout << "Profile: " << all.size() << " commands (ms; wait = queued to start)" << std::endl;
+  std::cout << std::left << std::setw(8) << "kind" << std::setw(28) << "name" << std::right
+      << std::setw(8) << "count" << std::setw(11) << "total" << std::setw(10) << "p50"
+      << std::setw(10) << "p95" << std::setw(10) << "p99" << std::setw(11) << "avg wait"
+      << std::setw(10) << "GB/s" << std::endl;
+  std::cout << std::fixed << std::setprecision(3);
+  std::map<std::pair<int, std::string>, Group>::iterator it;
+  for (it = groups.begin(); it != groups.end(); it++) {
+    Group &g = it->second;
+    std::sort(g.ms.begin(), g.ms.end());
+    double total = 0;
+    for (size_t i = 0; i < g.ms.size(); i++)
+      total += g.ms[i];
+    std::cout << std::left << std::setw(8) << KindName((ProfileKind) it->first.first)
+        << std::setw(28) << it->first.second << std::right
+        << std::setw(8) << g.ms.size() << std::setw(11) << total
+        << std::setw(10) << Percentile(g.ms, 50) << std::setw(10) << Percentile(g.ms, 95)
+        << std::setw(10) << Percentile(g.ms, 99) << std::setw(11) << g.waitMs / g.ms.size();
+    if (g.bytes > 0 && total > 0)
+      std::cout << std::setw(10) << g.bytes / (total * 1e6);
+    std::cout << std::endl;
+  }
+  double transferMs = kindMs[PROFILE_WRITE] + kindMs[PROFILE_READ] + kindMs[PROFILE_COPY]
+      + kindMs[PROFILE_MAP];
+  std::cout << "Totals: queue wait " << waitMs << " ms, transfers " << transferMs
+      << " ms, kernels " << kindMs[PROFILE_KERNEL] << " ms" << std::endl;
+  std::cout.unsetf(std::ios::floatfield);
+  std::cout << std::setprecision(6);
+}
+
+ProfileEvent::ProfileEvent(Profiler &profiler, const char *name, ProfileKind kind,
+    size_t bytes, cl_event *user)
+    : profiler(profiler), name(name), kernel(NULL), kind(kind), bytes(bytes), user(user),
+      event(NULL) {
+  if (user != NULL)
+    *user = NULL;
+}
+
+ProfileEvent::ProfileEvent(Profiler &profiler, cl_kernel kernel, cl_event *user)
+    : profiler(profiler), name(NULL), kernel(kernel), kind(PROFILE_KERNEL), bytes(0), user(user),
+      event(NULL) {
+  if (user != NULL)
+    *user = NULL;
+}
+
+cl_event *ProfileEvent::Out() {
+  if (user != NULL)
+    return user;
+  return profiler.enabled ? &event : NULL;
+}
+
+ProfileEvent::~ProfileEvent() {
+  cl_event e = (user != NULL) ? *user : event;
+  if (e != NULL && profiler.enabled) {
+    std::string label = name != NULL ? name : "";
+    if (kernel != NULL) {
+      char function[256] = { 0 };
+      clGetKernelInfo(kernel, CL_KERNEL_FUNCTION_NAME, sizeof(function) - 1, function, NULL);
+      label = function;
+    }
+    profiler.Add(e, label, kind, bytes);
+  }
+  if (event != NULL)
+    clReleaseEvent(event);
+}
+
+long long Profiler::Now() const {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now() - origin).count();
+}
+
+void Profiler::AddHostSpan(const std::string &name, long long begin, long long end) {
+  std::lock_guard<std::mutex> guard(mutex);
+  std::thread::id id = std::this_thread::get_id();
+  if (threadIds.find(id) == threadIds.end()) {
+    unsigned int next = (unsigned int) threadIds.size();
+    threadIds[id] = next;
+  }
+  HostRecord h;
+  h.name = name;
+  h.thread = threadIds[id];
+  h.begin = begin;
+  h.end = end;
+  hostRecords.push_back(h);
+}
+
+void Profiler::NameQueue(cl_command_queue queue, const std::string &name) {
+  std::lock_guard<std::mutex> guard(mutex);
+  if (queueNames.find(queue) == queueNames.end())
+    queueOrder.push_back(queue);
+  queueNames[queue] = name;
+}
+
+//Offset from the device clock of a queue to the host clock: a marker
+//completes between two host reads, the tightest of a few tries wins
+long long Profiler::Calibrate(cl_command_queue queue) {
+  long long offset = 0, window = -1;
+  for (int i = 0; i < 5; i++) {
+    cl_event marker = NULL;
+    long long before = Now();
+#ifdef CL_VERSION_1_2
+    cl_int err = clEnqueueMarkerWithWaitList(queue, 0, NULL, &marker);
+#else
+    cl_int err = clEnqueueMarker(queue, &marker);
+#endif
+    if (err != CL_SUCCESS)
+      break;
+    clFinish(queue);
+    long long after = Now();
+    cl_ulong end = 0;
+    clGetEventProfilingInfo(marker, CL_PROFILING_COMMAND_END, sizeof(cl_ulong), &end, NULL);
+    clReleaseEvent(marker);
+    if (end == 0)
+      continue;
+    if (window < 0 || after - before < window) {
+      window = after - before;
+      offset = (before + after) / 2 - (long long) end;
+    }
+  }
+  if (window < 0)
+    std::cout << "Profiler: cannot calibrate a queue, its device times are unaligned" << std::endl;
+  return offset;
+}
+
+static std::string JsonString(const std::string &str) {
+  std::string out = "\"";
+  for (size_t i = 0; i < str.size(); i++) {
+    char c = str[i];
+    if (c == '"' || c == '\\')
+      out += '\\';
+    if ((unsigned char) c < 0x20)
+      continue;
+    out += c;
+  }
+  return out + "\"";
+}
+
+bool Profiler::WriteTrace(const std::string &path) {
+  Collect(true);
+  std::vector<ProfileRecord> all = Records();
+  std::vector<HostRecord> host;
+  std::map<cl_command_queue, std::string> names;
+  std::vector<cl_command_queue> order;
+  {
+    std::lock_guard<std::mutex> guard(mutex);
+    host = hostRecords;
+    names = queueNames;
+    order = queueOrder;
+  }
+
+  //one track per queue, named ones in naming order first, then the
+  //others as their commands come
+  std::map<cl_command_queue, int> tracks;
+  std::map<cl_command_queue, long long> offsets;
+  for (size_t i = 0; i < all.size(); i++) {
+    if (names.find(all[i].queue) == names.end()) {
+      char name[64];
+      sprintf(name, "queue %p", (void *) all[i].queue);
+      names[all[i].queue] = name;
+      order.push_back(all[i].queue);
+    }
+  }
+  for (size_t i = 0; i < order.size(); i++) {
+    tracks[order[i]] = (int) i;
+    offsets[order[i]] = Calibrate(order[i]);
+  }
+
+  std::ofstream file(path.c_str());
+  if (!file.is_open()) {
+    std::cout << "Err: cannot write " << path << std::endl;
+    return false;
+  }
+  file << std::fixed << std::setprecision(3);
+  file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+  file << "{\"ph\":\"M\",\"name\":\"process_name\",\"pid\":0,\"args\":{\"name\":\"host\"}},\n";
+  file << "{\"ph\":\"M\",\"name\":\"process_name\",\"pid\":1,\"args\":{\"name\":\"device queues\"}}";
+  for (size_t i = 0; i < order.size(); i++) {
+    file << ",\n{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":" << tracks[order[i]]
+        << ",\"args\":{\"name\":" << JsonString(names[order[i]]) << "}}";
+  }
+  for (size_t i = 0; i < host.size(); i++) {
+    const HostRecord &h = host[i];
+    file << ",\n{\"ph\":\"X\",\"cat\":\"host\",\"name\":" << JsonString(h.name)
+        << ",\"pid\":0,\"tid\":" << h.thread << ",\"ts\":" << h.begin / 1e3
+        << ",\"dur\":" << (h.end - h.begin) / 1e3 << "}";
+  }
+  for (size_t i = 0; i < all.size(); i++) {
+    const ProfileRecord &r = all[i];
+    long long offset = offsets[r.queue];
+    double start = ((long long) r.start + offset) / 1e3;
+    double dur = r.end > r.start ? (r.end - r.start) / 1e3 : 0;
+    file << ",\n{\"ph\":\"X\",\"cat\":\"" << KindName(r.kind) << "\",\"name\":"
+        << JsonString(r.name.empty() ? KindName(r.kind) : r.name)
+        << ",\"pid\":1,\"tid\":" << tracks[r.queue] << ",\"ts\":" << start << ",\"dur\":" << dur
+        << ",\"args\":{\"bytes\":" << r.bytes << ",\"queued_to_start_us\":"
+        << (r.start > r.queued ? (r.start - r.queued) / 1e3 : 0) << "}}";
+  }
+  file << "\n]}\n";
+  file.close();
+  std::cout << "Trace: " << all.size() << " commands, " << host.size() << " host spans -> "
+      << path << std::endl;
+  return true;
+}
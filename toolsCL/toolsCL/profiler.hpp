@@ -0,0 +1,136 @@
+#ifndef PROFILER_HPP
+#define PROFILER_HPP
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <chrono>
+#include <thread>
+#include <CL/cl.h>
+
+enum ProfileKind {
+  PROFILE_KERNEL,
+  PROFILE_WRITE,   //host->device
+  PROFILE_READ,    //device->host
+  PROFILE_COPY,    //device->device
+  PROFILE_MAP,     //map and unmap
+  PROFILE_OTHER
+};
+
+//One finished command, times in ns of the device clock
+struct ProfileRecord {
+  std::string name;
+  ProfileKind kind;
+  size_t bytes;
+  cl_command_queue queue;
+  cl_ulong queued, submit, start, end;
+};
+
+//A stretch of host work, ns since the profiler was created
+struct HostRecord {
+  std::string name;
+  unsigned int thread;
+  long long begin, end;
+};
+
+//Collects CL_PROFILING_COMMAND_* of the commands the toolkit enqueues,
+//and host spans (HostSpan). Off by default; while off ProfileEvent
+//hands out no events. Events are read once they complete, on Collect,
+//Report or WriteTrace, and by Add every maxPending events. Thread-safe.
+class Profiler {
+  public:
+    Profiler() : enabled(false), maxPending(1024), collectAt(1024), origin(std::chrono::steady_clock::now()) {}
+    ~Profiler();
+
+    bool enabled;
+    size_t maxPending;  //events held before Add collects the completed ones; 0 to wait for Collect
+
+    void Add(cl_event event, const std::string &name, ProfileKind kind, size_t bytes);
+    //Read the completed events; wait for all of them when wait is set
+    void Collect(bool wait);
+    //Per (kind, name): count, total, p50/p95/p99, queue delay, bytes/s
+    void Report();
+    std::vector<ProfileRecord> Records();
+    void Reset();
+    static const char *KindName(ProfileKind kind);
+
+    //ns on the host clock since the profiler was created
+    long long Now() const;
+    void AddHostSpan(const std::string &name, long long begin, long long end);
+    //Track name of a queue in the trace
+    void NameQueue(cl_command_queue queue, const std::string &name);
+    //Chrome trace-event JSON (chrome://tracing, ui.perfetto.dev): one
+    //track per queue plus one per host thread, device times moved onto
+    //the host clock
+    bool WriteTrace(const std::string &path);
+
+  private:
+    long long Calibrate(cl_command_queue queue);
+
+    struct Pending {
+      cl_event event;
+      std::string name;
+      ProfileKind kind;
+      size_t bytes;
+    };
+    std::vector<Pending> pending;
+    size_t collectAt;  //pending size of the next Collect from Add
+    std::vector<ProfileRecord> records;
+    std::vector<HostRecord> hostRecords;
+    std::map<cl_command_queue, std::string> queueNames;
+    std::vector<cl_command_queue> queueOrder;  //in naming order
+    std::map<std::thread::id, unsigned int> threadIds;
+    std::chrono::steady_clock::time_point origin;
+    std::mutex mutex;
+};
+
+//Host span recorded into the profiler from construction to scope exit
+class HostSpan {
+  public:
+    HostSpan(Profiler &profiler, const std::string &name)
+        : profiler(profiler), active(profiler.enabled), name(active ? name : std::string()),
+          begin(active ? profiler.Now() : 0) {
+    }
+    ~HostSpan() {
+      if (active)
+        profiler.AddHostSpan(name, begin, profiler.Now());
+    }
+
+  private:
+    HostSpan(const HostSpan &);
+    HostSpan &operator=(const HostSpan &);
+
+    Profiler &profiler;
+    bool active;
+    std::string name;
+    long long begin;
+};
+
+//Event slot for one enqueue: pass Out() as the event argument. On scope
+//exit the event goes to the profiler, and to *user if one was given.
+//  { ProfileEvent pe(dev.Prof, kernel); clEnqueueNDRangeKernel(..., pe.Out()); }
+class ProfileEvent {
+  public:
+    ProfileEvent(Profiler &profiler, const char *name, ProfileKind kind,
+        size_t bytes = 0, cl_event *user = NULL);
+    //Named after the kernel function
+    ProfileEvent(Profiler &profiler, cl_kernel kernel, cl_event *user = NULL);
+    ~ProfileEvent();
+
+    //NULL when nobody wants the event
+    cl_event *Out();
+
+  private:
+    ProfileEvent(const ProfileEvent &);
+    ProfileEvent &operator=(const ProfileEvent &);
+
+    Profiler &profiler;
+    const char *name;
+    cl_kernel kernel;
+    ProfileKind kind;
+    size_t bytes;
+    cl_event *user;
+    cl_event event;
+};
+
+#endif //PROFILER_HPP
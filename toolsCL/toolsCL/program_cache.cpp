@@ -0,0 +1,188 @@
+#include "program_cache.hpp"
+#include "device.hpp"
+#include "timer.hpp"
+#include <stdio.h>
+#include <string.h>
+#include <fstream>
+#include <iostream>
+#include <vector>
+#ifdef _WIN32
+#include <direct.h>
+#define MAKE_DIR(path) _mkdir(path)
+#else
+#include <sys/stat.h>
+#define MAKE_DIR(path) mkdir(path, 0755)
+#endif
+
+static const char cacheMagic[8] = { 'T', 'C', 'L', 'B', 'I', 'N', '0', '1' };
+
+//64-bit FNV-1a, good enough to tell program sources apart
+static void HashBytes(unsigned long long &hash, const void *data, size_t size) {
+  const unsigned char *p = (const unsigned char *) data;
+  for (size_t i = 0; i < size; i++) {
+    hash ^= p[i];
+    hash *= 1099511628211ULL;
+  }
+}
+
+static void HashString(unsigned long long &hash, const std::string &str) {
+  HashBytes(hash, str.data(), str.size());
+  //separator so that ("ab","c") and ("a","bc") differ
+  HashBytes(hash, "\0", 1);
+}
+
+std::string ProgramCache::MakeKey(const std::string &source,
+    const std::string &options, cl_device_id device) {
+  cl_platform_id platform = NULL;
+  clGetDeviceInfo(device, CL_DEVICE_PLATFORM, sizeof(cl_platform_id), &platform, NULL);
+
+  unsigned long long hash = 14695981039346656037ULL;
+  HashString(hash, source);
+  HashString(hash, options);
+  HashString(hash, Device::GetDeviceString(device, CL_DEVICE_NAME));
+  HashString(hash, Device::GetDeviceString(device, CL_DEVICE_VERSION));
+  HashString(hash, Device::GetDeviceString(device, CL_DRIVER_VERSION));
+  HashString(hash, Device::GetPlatformString(platform, CL_PLATFORM_NAME));
+  HashString(hash, Device::GetPlatformString(platform, CL_PLATFORM_VERSION));
+
+  char key[17];
+  sprintf(key, "%016llx", hash);
+  return std::string(key);
+}
+
+bool ProgramCache::MakeDirectory(const std::string &path) {
+  return MAKE_DIR(path.c_str()) == 0;
+}
+
+std::string ProgramCache::FileName(const std::string &key) {
+  return cachePath + key + ".bin";
+}
+
+cl_program ProgramCache::Load(cl_context context, cl_device_id device,
+    const std::string &key, const std::string &options) {
+  if (!enabled)
+    return NULL;
+
+  Timer timer;
+  std::ifstream file(FileName(key).c_str(), std::ios::in | std::ios::binary);
+  if (!file.is_open()) {
+    stats.misses++;
+    return NULL;
+  }
+
+  //header: magic, key, binary size
+  char magic[8];
+  char fileKey[16];
+  unsigned long long size = 0;
+  file.read(magic, sizeof(magic));
+  file.read(fileKey, sizeof(fileKey));
+  file.read((char *) &size, sizeof(size));
+  std::vector<unsigned char> binary;
+  if (file && memcmp(magic, cacheMagic, sizeof(magic)) == 0
+      && key.compare(0, key.size(), fileKey, sizeof(fileKey)) == 0 && size > 0) {
+    binary.resize((size_t) size);
+    file.read((char *) &binary[0], binary.size());
+  }
+  if (!file || binary.empty()) {
+    std::cout << "Program cache: stale entry " << key << std::endl;
+    file.close();
+    remove(FileName(key).c_str());
+    stats.misses++;
+    return NULL;
+  }
+  file.close();
+
+  cl_int err = CL_SUCCESS;
+  cl_program program = CreateFromBinary(context, device, &binary[0],
+      binary.size(), options, &err);
+  if (program == NULL) {
+    std::cout << "Program cache: binary rejected ( Err = " << err << " ), rebuilding" << std::endl;
+    remove(FileName(key).c_str());
+    stats.rejects++;
+    stats.misses++;
+    return NULL;
+  }
+
+  stats.hits++;
+  stats.loadMs += timer.MilliSeconds();
+  return program;
+}
+
+//Create and build a program from a device binary, NULL if the driver
+//refuses it
+cl_program ProgramCache::CreateFromBinary(cl_context context, cl_device_id device,
+    const unsigned char *binary, size_t size, const std::string &options, cl_int *err) {
+  cl_int binaryStatus = CL_SUCCESS;
+  *err = CL_SUCCESS;
+  cl_program program = clCreateProgramWithBinary(context, 1, &device,
+      &size, &binary, &binaryStatus, err);
+  if (program != NULL && *err == CL_SUCCESS && binaryStatus == CL_SUCCESS)
+    *err = clBuildProgram(program, 1, &device, options.c_str(), NULL, NULL);
+  else if (*err == CL_SUCCESS)
+    *err = binaryStatus;
+
+  if (*err != CL_SUCCESS) {
+    if (program != NULL)
+      clReleaseProgram(program);
+    return NULL;
+  }
+  return program;
+}
+
+bool ProgramCache::Store(cl_program program, const std::string &key) {
+  if (!enabled)
+    return false;
+
+  size_t binarySize = 0;
+  if (clGetProgramInfo(program, CL_PROGRAM_BINARY_SIZES, sizeof(size_t),
+      &binarySize, NULL) != CL_SUCCESS || binarySize == 0) {
+    std::cout << "Program cache: no binary to store" << std::endl;
+    return false;
+  }
+  std::vector<unsigned char> binary(binarySize);
+  unsigned char *pBinary = &binary[0];
+  if (clGetProgramInfo(program, CL_PROGRAM_BINARIES, sizeof(unsigned char *),
+      &pBinary, NULL) != CL_SUCCESS) {
+    std::cout << "Program cache: failed to read program binary" << std::endl;
+    return false;
+  }
+
+  MakeDirectory(cachePath);
+  //write to a temporary file first so a crashed writer never leaves
+  //a truncated entry under the real name
+  std::string fileName = FileName(key);
+  std::string tmpName = fileName + ".tmp";
+  std::ofstream file(tmpName.c_str(), std::ios::out | std::ios::binary);
+  if (!file.is_open()) {
+    std::cout << "Program cache: cannot write " << tmpName << std::endl;
+    return false;
+  }
+  unsigned long long size = binarySize;
+  file.write(cacheMagic, sizeof(cacheMagic));
+  file.write(key.data(), 16);
+  file.write((const char *) &size, sizeof(size));
+  file.write((const char *) &binary[0], binary.size());
+  file.close();
+
+  remove(fileName.c_str());
+  if (rename(tmpName.c_str(), fileName.c_str()) != 0) {
+    remove(tmpName.c_str());
+    return false;
+  }
+  stats.stores++;
+  return true;
+}
+
+void ProgramCache::RecordCompile(double ms) {
+  stats.compileMs += ms;
+}
+
+void ProgramCache::DisplayStats() {
+  std::cout << "Program cache [" << cachePath << "]"
+      << "  hits: " << stats.hits
+      << "  misses: " << stats.misses
+      << "  rejects: " << stats.rejects
+      << "  stores: " << stats.stores
+      << "  compile ms: " << stats.compileMs
+      << "  load ms: " << stats.loadMs << std::endl;
+}
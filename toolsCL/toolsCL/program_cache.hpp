@@ -0,0 +1,44 @@
+#ifndef PROGRAM_CACHE_HPP
+#define PROGRAM_CACHE_HPP
+#include <string>
+#include <CL/cl.h>
+
+struct ProgramCacheStats {
+  ProgramCacheStats()
+      : hits(0), misses(0), rejects(0), stores(0), compileMs(0), loadMs(0) {
+  }
+  unsigned int hits;     //binary found and accepted by the driver
+  unsigned int misses;   //no binary for the key, built from source
+  unsigned int rejects;  //binary found but refused by the driver
+  unsigned int stores;   //binaries written back to disk
+  double compileMs;      //time spent in source builds
+  double loadMs;         //time spent loading binaries
+};
+
+//On-disk cache of CL_PROGRAM_BINARIES, one file per key.
+//The key hashes the source, the build options, the device and the
+//driver/platform it runs on, so any change invalidates the entry.
+class ProgramCache {
+  public:
+    ProgramCache() : cachePath("./kernelCache/"), enabled(true) {}
+
+    std::string cachePath;
+    bool enabled;
+    ProgramCacheStats stats;
+
+    std::string MakeKey(const std::string &source, const std::string &options,
+        cl_device_id device);
+    cl_program Load(cl_context context, cl_device_id device,
+        const std::string &key, const std::string &options);
+    bool Store(cl_program program, const std::string &key);
+    void RecordCompile(double ms);
+    static cl_program CreateFromBinary(cl_context context, cl_device_id device,
+        const unsigned char *binary, size_t size, const std::string &options, cl_int *err);
+    void DisplayStats();
+    static bool MakeDirectory(const std::string &path);
+
+  private:
+    std::string FileName(const std::string &key);
+};
+
+#endif //PROGRAM_CACHE_HPP
@@ -0,0 +1,249 @@
+#include "reduction.hpp"
+#include "device.hpp"
+#include "buffer_pool.hpp"
+#include <algorithm>
+
+//Accumulator types of ReduceAccumulator, with their limits in OpenCL C
+//and, for the atomic types, the bits of the limits on the host
+struct AccumulatorInfo {
+  const char *name;
+  const char *lowest;
+  const char *highest;
+  bool atomics;  //atomic_add, atomic_min and atomic_max of OpenCL 1.1
+  cl_uint lowestBits;
+  cl_uint highestBits;
+};
+
+static const AccumulatorInfo accumulators[] = {
+  { "float", "(-INFINITY)", "INFINITY", false, 0, 0 },
+  { "double", "(-(double) INFINITY)", "((double) INFINITY)", false, 0, 0 },
+  { "int", "INT_MIN", "INT_MAX", true, 0x80000000u, 0x7fffffffu },
+  { "uint", "0", "UINT_MAX", true, 0, 0xffffffffu },
+};
+
+//float when not found
+static const AccumulatorInfo &FindAccumulator(const std::string &name) {
+  for (size_t i = 0; i < sizeof(accumulators) / sizeof(accumulators[0]); i++)
+    if (name == accumulators[i].name)
+      return accumulators[i];
+  return accumulators[0];
+}
+
+//Definitions shared by the reduce and argreduce kernels of reduce.cl
+static std::string TypePrelude(const std::string &type, const AccumulatorInfo &acc) {
+  std::string name = acc.name;
+  return "#define Dtype " + type + "\n"
+      "#define Atype " + name + "\n"
+      "#define Atype4 " + name + "4\n"
+      "#define convert_Atype4 convert_" + name + "4\n"
+      "#define ATYPE_MIN " + acc.lowest + "\n"
+      "#define ATYPE_MAX " + acc.highest + "\n";
+}
+
+Reduction::Reduction(Device &device)
+    : queue(device.CommandQueue), localSize(256), groupsPerUnit(8), useSubGroups(true), useAtomics(true),
+      device(device), computeUnits(1), maxLocalSize(1) {
+  clGetDeviceInfo(device.pDevices[0], CL_DEVICE_MAX_COMPUTE_UNITS, sizeof(cl_uint), &computeUnits, NULL);
+  clGetDeviceInfo(device.pDevices[0], CL_DEVICE_MAX_WORK_GROUP_SIZE, sizeof(size_t), &maxLocalSize, NULL);
+  if (computeUnits == 0)
+    computeUnits = 1;
+  //sub_group_reduce_* is core to the khr extension from OpenCL C 2.0, and
+  //part of the Intel one on 1.2
+  std::string extensions = Device::GetDeviceString(device.pDevices[0], CL_DEVICE_EXTENSIONS);
+  if (extensions.find("cl_khr_subgroups") != std::string::npos) {
+    std::string version = Device::GetDeviceString(device.pDevices[0], CL_DEVICE_OPENCL_C_VERSION);
+    subGroupPragma = "#pragma OPENCL EXTENSION cl_khr_subgroups : enable\n";
+    subGroupOptions = version.find("OpenCL C 3.") != std::string::npos ? "-cl-std=CL3.0" : "-cl-std=CL2.0";
+  } else if (extensions.find("cl_intel_subgroups") != std::string::npos) {
+    subGroupPragma = "#pragma OPENCL EXTENSION cl_intel_subgroups : enable\n";
+  }
+}
+
+Reduction::~Reduction() {
+  for (std::map<std::string, ReduceKernel>::iterator it = kernels.begin(); it != kernels.end(); ++it) {
+    ForgetKernelArgs(device.generation, it->second.kernel);
+    clReleaseKernel(it->second.kernel);
+  }
+}
+
+cl_kernel Reduction::Kernel(const std::string &name, const std::string &prelude, const std::string &options,
+    size_t &local) {
+  std::string key = name + "\n" + options + "\n" + prelude;
+  std::map<std::string, ReduceKernel>::iterator it = kernels.find(key);
+  if (it == kernels.end()) {
+    cl_program program = device.GetProgramVariant("reduce.cl", options, prelude);
+    if (program == NULL)
+      return NULL;
+    cl_int err = CL_SUCCESS;
+    ReduceKernel rk;
+    rk.kernel = clCreateKernel(program, name.c_str(), &err);
+    OCL_CHECK(err, "Reduction: " << name);
+    if (rk.kernel == NULL)
+      return NULL;
+    rk.maxLocal = 0;
+    clGetKernelWorkGroupInfo(rk.kernel, device.pDevices[0], CL_KERNEL_WORK_GROUP_SIZE, sizeof(size_t),
+        &rk.maxLocal, NULL);
+    it = kernels.insert(std::make_pair(key, rk)).first;
+  }
+  local = std::min(localSize, maxLocalSize);
+  if (it->second.maxLocal != 0 && local > it->second.maxLocal)
+    local = it->second.maxLocal;
+  if (local == 0)
+    local = 1;
+  return it->second.kernel;
+}
+
+//Work-groups for items work-items: enough to keep every compute unit
+//busy, and at most one work-group's worth of partials for the next pass
+size_t Reduction::Groups(size_t items, size_t local) const {
+  size_t groups = (items + local - 1) / local;
+  size_t resident = (size_t) computeUnits * groupsPerUnit;
+  if (groups > resident)
+    groups = resident;
+  if (groups > local)
+    groups = local;
+  return groups == 0 ? 1 : groups;
+}
+
+//The grid-stride loops of reduce.cl step a uint index by the global size:
+//n elements are reached without wrapping while n + global fits
+bool Reduction::Fits(size_t n, size_t global) const {
+  if (global > CL_UINT_MAX - n) {
+    std::cout << "Err: Reduction of " << n << " elements, the kernels index with uint up to "
+        << CL_UINT_MAX << " - " << global << " work-items" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+cl_int Reduction::Run(const char *type, const char *acc, size_t accSize, cl_mem in, size_t n,
+    const ReduceOp &op, void *result) {
+  if (n == 0 || n > CL_UINT_MAX) {
+    std::cout << "Err: Reduction of " << n << " elements, 1 to CL_UINT_MAX are supported" << std::endl;
+    return CL_INVALID_VALUE;
+  }
+  const AccumulatorInfo &info = FindAccumulator(acc);
+  bool builtin = op.kind != REDUCE_CUSTOM;
+  bool atomic = useAtomics && builtin && info.atomics;
+  const char *builtinName = op.kind == REDUCE_SUM ? "add" : (op.kind == REDUCE_MIN ? "min" : "max");
+
+  std::string prelude = TypePrelude(type, info);
+  prelude += "#define REDUCE_OP(a, b) (" + op.combine + ")\n";
+  prelude += "#define REDUCE_IDENTITY (" + op.identity + ")\n";
+  std::string options;
+  if (useSubGroups && builtin && !subGroupPragma.empty()) {
+    prelude += subGroupPragma + "#define SUBGROUP_REDUCE sub_group_reduce_" + builtinName + "\n";
+    options = subGroupOptions;
+  }
+  if (atomic)
+    prelude += std::string("#define ATOMIC_FINISH(p, v) atomic_") + builtinName + "(p, v)\n";
+
+  size_t local = 1;
+  cl_kernel first = Kernel(std::string("reduce_local_") + acc, prelude, options, local);
+  if (first == NULL)
+    return CL_INVALID_KERNEL;
+  size_t groups = Groups((n + 3) / 4, local);
+  if (!Fits(n, groups * local))
+    return CL_INVALID_VALUE;
+
+  if (atomic) {
+    //every work-group folds its partial into the one result
+    BufferLease out = device.Buffers.Acquire(accSize, CL_MEM_READ_WRITE);
+    cl_uint identity = op.kind == REDUCE_MIN ? info.highestBits : (op.kind == REDUCE_MAX ? info.lowestBits : 0);
+    cl_int err = CL_SUCCESS;
+    {
+      //in queue order ahead of the kernel, nothing waits on it
+#ifdef CL_VERSION_1_2
+      ProfileEvent pe(device.Prof, "reduce fill", PROFILE_WRITE, accSize);
+      err = clEnqueueFillBuffer(queue, out.Get(), &identity, accSize, 0, accSize, 0, NULL, pe.Out());
+#else
+      ProfileEvent pe(device.Prof, "reduce write", PROFILE_WRITE, accSize);
+      err = clEnqueueWriteBuffer(queue, out.Get(), CL_FALSE, 0, accSize, &identity, 0, NULL, pe.Out());
+#endif
+    }
+    if (err != CL_SUCCESS)
+      return err;
+    err = device.LaunchOn(queue, first, NDRange(groups * local).Local(local), in, (cl_uint) n, out.Get(),
+        LocalMemory(local * accSize));
+    if (err != CL_SUCCESS) {
+#ifndef CL_VERSION_1_2
+      //the write may still read identity
+      clFinish(queue);
+#endif
+      return err;
+    }
+    ProfileEvent pe(device.Prof, "reduce read", PROFILE_READ, accSize);
+    return clEnqueueReadBuffer(queue, out.Get(), CL_TRUE, 0, accSize, result, 0, NULL, pe.Out());
+  }
+
+  //partials ping-pong between two buffers until one value is left
+  BufferLease a = device.Buffers.Acquire(groups * accSize, CL_MEM_READ_WRITE);
+  BufferLease b = device.Buffers.Acquire(groups * accSize, CL_MEM_READ_WRITE);
+  cl_int err = device.LaunchOn(queue, first, NDRange(groups * local).Local(local), in, (cl_uint) n, a.Get(),
+      LocalMemory(local * accSize));
+  if (err != CL_SUCCESS)
+    return err;
+  cl_mem src = a.Get(), dst = b.Get();
+  for (size_t count = groups; count > 1; std::swap(src, dst)) {
+    cl_kernel partials = Kernel(std::string("reduce_partials_") + acc, prelude, options, local);
+    if (partials == NULL)
+      return CL_INVALID_KERNEL;
+    groups = Groups((count + 3) / 4, local);
+    err = device.LaunchOn(queue, partials, NDRange(groups * local).Local(local), src, (cl_uint) count, dst,
+        LocalMemory(local * accSize));
+    if (err != CL_SUCCESS)
+      return err;
+    count = groups;
+  }
+  ProfileEvent pe(device.Prof, "reduce read", PROFILE_READ, accSize);
+  return clEnqueueReadBuffer(queue, src, CL_TRUE, 0, accSize, result, 0, NULL, pe.Out());
+}
+
+cl_int Reduction::RunArg(const char *type, const char *acc, size_t accSize, cl_mem in, size_t n,
+    bool min, void *value, cl_uint *index) {
+  if (n == 0 || n > CL_UINT_MAX) {
+    std::cout << "Err: Reduction of " << n << " elements, 1 to CL_UINT_MAX are supported" << std::endl;
+    return CL_INVALID_VALUE;
+  }
+  std::string prelude = TypePrelude(type, FindAccumulator(acc));
+  prelude += min ? "#define ARG_BETTER(a, b) ((a) < (b))\n#define ARG_WORST ATYPE_MAX\n"
+                 : "#define ARG_BETTER(a, b) ((a) > (b))\n#define ARG_WORST ATYPE_MIN\n";
+
+  size_t local = 1;
+  cl_kernel first = Kernel(std::string("argreduce_local_") + acc, prelude, "", local);
+  if (first == NULL)
+    return CL_INVALID_KERNEL;
+  size_t groups = Groups(n, local);
+  if (!Fits(n, groups * local))
+    return CL_INVALID_VALUE;
+  BufferLease values[2], indices[2];
+  for (int i = 0; i < 2; i++) {
+    values[i] = device.Buffers.Acquire(groups * accSize, CL_MEM_READ_WRITE);
+    indices[i] = device.Buffers.Acquire(groups * sizeof(cl_uint), CL_MEM_READ_WRITE);
+  }
+  cl_int err = device.LaunchOn(queue, first, NDRange(groups * local).Local(local), in, (cl_uint) n,
+      values[0].Get(), indices[0].Get(), LocalMemory(local * accSize), LocalMemory(local * sizeof(cl_uint)));
+  if (err != CL_SUCCESS)
+    return err;
+  int src = 0;
+  for (size_t count = groups; count > 1; src = 1 - src) {
+    cl_kernel partials = Kernel(std::string("argreduce_partials_") + acc, prelude, "", local);
+    if (partials == NULL)
+      return CL_INVALID_KERNEL;
+    groups = Groups(count, local);
+    err = device.LaunchOn(queue, partials, NDRange(groups * local).Local(local),
+        values[src].Get(), indices[src].Get(), (cl_uint) count, values[1 - src].Get(), indices[1 - src].Get(),
+        LocalMemory(local * accSize), LocalMemory(local * sizeof(cl_uint)));
+    if (err != CL_SUCCESS)
+      return err;
+    count = groups;
+  }
+  {
+    ProfileEvent pe(device.Prof, "reduce read", PROFILE_READ, accSize);
+    err = clEnqueueReadBuffer(queue, values[src].Get(), CL_FALSE, 0, accSize, value, 0, NULL, pe.Out());
+  }
+  if (err != CL_SUCCESS)
+    return err;
+  ProfileEvent pe(device.Prof, "reduce read", PROFILE_READ, sizeof(cl_uint));
+  return clEnqueueReadBuffer(queue, indices[src].Get(), CL_TRUE, 0, sizeof(cl_uint), index, 0, NULL, pe.Out());
+}
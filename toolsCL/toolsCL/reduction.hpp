@@ -0,0 +1,133 @@
+#ifndef REDUCTION_HPP
+#define REDUCTION_HPP
+#include <string>
+#include <map>
+#include <CL/cl.h>
+#include "kernel_types.hpp"
+
+class Device;
+
+enum ReduceKind {
+  REDUCE_CUSTOM,
+  REDUCE_SUM,
+  REDUCE_MIN,
+  REDUCE_MAX
+};
+
+//How two values a and b of the accumulator type combine, as an OpenCL C
+//expression. The op must be associative and commutative: work-groups and
+//work-items fold in no fixed order. identity is the value x for which
+//combine(identity, x) == x; ATYPE_MIN and ATYPE_MAX are the limits of the
+//accumulator type.
+struct ReduceOp {
+  ReduceKind kind;
+  std::string combine;
+  std::string identity;
+
+  static ReduceOp Sum() { return ReduceOp(REDUCE_SUM, "(a) + (b)", "0"); }
+  static ReduceOp Min() { return ReduceOp(REDUCE_MIN, "min(a, b)", "ATYPE_MAX"); }
+  static ReduceOp Max() { return ReduceOp(REDUCE_MAX, "max(a, b)", "ATYPE_MIN"); }
+  //Custom("fmax(fabs(a), fabs(b))", "0")
+  static ReduceOp Custom(const std::string &combine, const std::string &identity) {
+    return ReduceOp(REDUCE_CUSTOM, combine, identity);
+  }
+
+  ReduceOp(ReduceKind kind, const std::string &combine, const std::string &identity)
+      : kind(kind), combine(combine), identity(identity) {}
+};
+
+//The type an element type is reduced in: small integers widen so that
+//sums of many elements do not wrap as soon.
+template <typename T> struct ReduceAccumulator;
+#define REDUCE_ACCUMULATOR(T, A, name) \
+  template <> struct ReduceAccumulator<T> { \
+    typedef A Type; \
+    static const char *Name() { return name; } \
+  };
+REDUCE_ACCUMULATOR(cl_float, cl_float, "float")
+REDUCE_ACCUMULATOR(cl_double, cl_double, "double")
+REDUCE_ACCUMULATOR(cl_int, cl_int, "int")
+REDUCE_ACCUMULATOR(cl_short, cl_int, "int")
+REDUCE_ACCUMULATOR(cl_uchar, cl_uint, "uint")
+#undef REDUCE_ACCUMULATOR
+
+//Reductions of a device array to one value with
+//kernelGen/cl_kernels/reduce.cl: each work-group folds a grid-stride share
+//of the array, four elements per load, then its work-items through
+//__local memory (or sub-group reductions where the device has them) into
+//one partial. The partials are reduced by further passes of at most one
+//work-group, or, for integer sums, minima and maxima, atomically into the
+//result. Only the result is read back. The program is built per element
+//type and op, and cached by the Device under its prelude.
+//Run from the thread that owns the Reduction.
+class Reduction {
+  public:
+    explicit Reduction(Device &device);
+    ~Reduction();
+
+    template <typename T>
+    cl_int Reduce(cl_mem in, size_t n, const ReduceOp &op, typename ReduceAccumulator<T>::Type &result) {
+      return Run(KernelType<T>::Name(), ReduceAccumulator<T>::Name(),
+          sizeof(typename ReduceAccumulator<T>::Type), in, n, op, &result);
+    }
+    template <typename T>
+    cl_int Sum(cl_mem in, size_t n, typename ReduceAccumulator<T>::Type &result) {
+      return Reduce<T>(in, n, ReduceOp::Sum(), result);
+    }
+    template <typename T>
+    cl_int Min(cl_mem in, size_t n, typename ReduceAccumulator<T>::Type &result) {
+      return Reduce<T>(in, n, ReduceOp::Min(), result);
+    }
+    template <typename T>
+    cl_int Max(cl_mem in, size_t n, typename ReduceAccumulator<T>::Type &result) {
+      return Reduce<T>(in, n, ReduceOp::Max(), result);
+    }
+    //The smallest value and its first index. NaNs are never picked; an
+    //array of only NaNs gives index CL_UINT_MAX.
+    template <typename T>
+    cl_int ArgMin(cl_mem in, size_t n, typename ReduceAccumulator<T>::Type &value, cl_uint &index) {
+      return RunArg(KernelType<T>::Name(), ReduceAccumulator<T>::Name(),
+          sizeof(typename ReduceAccumulator<T>::Type), in, n, true, &value, &index);
+    }
+    //The largest value and its first index
+    template <typename T>
+    cl_int ArgMax(cl_mem in, size_t n, typename ReduceAccumulator<T>::Type &value, cl_uint &index) {
+      return RunArg(KernelType<T>::Name(), ReduceAccumulator<T>::Name(),
+          sizeof(typename ReduceAccumulator<T>::Type), in, n, false, &value, &index);
+    }
+
+    cl_command_queue queue;  //CommandQueue unless set
+    size_t localSize;        //work-group size, capped by the device and kernel
+    size_t groupsPerUnit;    //work-groups per compute unit of the first pass
+    bool useSubGroups;       //sub_group_reduce_* for builtin ops, where supported
+    bool useAtomics;         //atomic finishing of int and uint builtin ops
+
+  private:
+    Reduction(const Reduction &);
+    Reduction &operator=(const Reduction &);
+
+    struct ReduceKernel {
+      cl_kernel kernel;
+      size_t maxLocal;  //CL_KERNEL_WORK_GROUP_SIZE
+    };
+
+    cl_int Run(const char *type, const char *acc, size_t accSize, cl_mem in, size_t n,
+        const ReduceOp &op, void *result);
+    cl_int RunArg(const char *type, const char *acc, size_t accSize, cl_mem in, size_t n,
+        bool min, void *value, cl_uint *index);
+    //Kernel name of reduce.cl built with prelude and options, and the
+    //work-group size to run it with; NULL on failure
+    cl_kernel Kernel(const std::string &name, const std::string &prelude, const std::string &options,
+        size_t &local);
+    size_t Groups(size_t items, size_t local) const;
+    bool Fits(size_t n, size_t global) const;
+
+    Device &device;
+    cl_uint computeUnits;
+    size_t maxLocalSize;
+    std::string subGroupPragma;   //enables the sub-group extension, empty without one
+    std::string subGroupOptions;  //the OpenCL C version it needs
+    std::map<std::string, ReduceKernel> kernels;  //by name, options and prelude
+};
+
+#endif //REDUCTION_HPP
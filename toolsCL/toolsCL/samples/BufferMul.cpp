@@ -1,45 +1,52 @@
 #include "../device.hpp"
+#include "../elementwise.hpp"
 
 void BufferMul()
 {
 	Device clDevice;
+	clDevice.EnableProfiling(true);//report printed when clDevice goes away
 	clDevice.Init();
 
 	//! Init data
-	//create input data on CPU
-	int num = 1024;
+	//create input data on CPU, any length: the elementwise kernels handle the tail
+	int num = 1000;
 	float *h_idata = (float*)malloc(sizeof(float)* num);
 	for (int i = 0; i < num; i++){
 		h_idata[i] = i;
 	}
 	//allocate memory for the results on CPU
 	float *h_odata = (float*)malloc(sizeof(float)* num);
-	//allocate memory and data on GPU
-	cl_mem d_idata = clCreateBuffer(clDevice.Context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, sizeof(float)*num, h_idata, NULL);
-	cl_mem d_odata = clCreateBuffer(clDevice.Context, CL_MEM_READ_WRITE, sizeof(float)*num, NULL, NULL);
 
-	//! Get kernel
-	std::string kernel_name = "mul2";
-	cl_kernel Kernel = clDevice.GetKernel(kernel_name);
+	//! Get kernels: vectorized to the device's preferred float width, grid-stride
+	Elementwise elementwise(clDevice);
+	std::cout << "mul2 as scale_v" << elementwise.VectorWidth<cl_float>() << "_float" << std::endl;
 
-	//! Set argments
-	cl_int ret;
-	ret  = clSetKernelArg(Kernel, 0, sizeof(cl_mem), (void*)&d_idata);
-	ret |= clSetKernelArg(Kernel, 1, sizeof(cl_mem), (void*)&d_odata);
-	OCL_CHECK(ret, "mul2: clSetKernelArg");
+	//each request takes its device buffers from the pool and hands them
+	//back at the end of the iteration; only the first one allocates
+	for (int request = 0; request < 10; request++) {
+		//allocate memory and data on GPU
+		BufferLease d_idata = clDevice.Buffers.Acquire(sizeof(float)*num, CL_MEM_READ_ONLY);
+		BufferLease d_odata = clDevice.Buffers.Acquire(sizeof(float)*num, CL_MEM_READ_WRITE);
+		cl_mem idata = d_idata.Get();
+		cl_mem odata = d_odata.Get();
+		OCL_CHECK(
+			clDevice.Staging.Upload(clDevice.CommandQueue, idata, 0, h_idata, sizeof(float)*num),
+			"mul2: write input");
 
-	//! Set global and local work size
-	size_t global_work_size[] = { (size_t)num };
-	size_t local_work_size[] = { 256 };
+		//! Excute kernel, the grid follows the compute units rather than num;
+		//the local size is clDevice.Tuner's, timed in the first request
+		OCL_CHECK(elementwise.Mul2<cl_float>(idata, odata, num), "mul2: kernel");
 
-	//! Excute kernel
-	OCL_CHECK(
-		clEnqueueNDRangeKernel(clDevice.CommandQueue, Kernel, 1, NULL,global_work_size, local_work_size, 0, NULL, NULL), 
-		"mul2: kernel");
-
-	//! Get outputs
-	// copy result from device to host
-	clEnqueueReadBuffer(clDevice.CommandQueue, d_odata, CL_TRUE, 0, num * sizeof(float), h_odata, 0, NULL, NULL);
+		//! Get outputs
+		// copy result from device to host through pinned memory
+		OCL_CHECK(
+			clDevice.Staging.Download(clDevice.CommandQueue, odata, 0, h_odata, num * sizeof(float)),
+			"mul2: read output");
+	}
 	for(int i=0; i<10; i++)
 		std::cout << h_idata[i] << "  " << h_odata[i] << std::endl;
-}
\ No newline at end of file
+	clDevice.Buffers.DisplayStats();
+
+	free(h_idata);
+	free(h_odata);
+}
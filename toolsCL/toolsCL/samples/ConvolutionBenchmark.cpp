@@ -0,0 +1,73 @@
+#include "../device.hpp"
+#include "../convolution.hpp"
+#include "../timer.hpp"
+#include <stdlib.h>
+#include <math.h>
+#include <iomanip>
+#include <algorithm>
+
+//Build-time specialized convolutions against the runtime-generic kernel
+//on a 2048x2048 float image, with the largest difference between them
+int ConvolutionBenchmark()
+{
+	Device clDevice;
+	clDevice.Init();
+	if (clDevice.Context == NULL)
+		return 1;
+	cl_command_queue queue = clDevice.CommandQueue;
+
+	const int width = 2048, height = 2048, runs = 10;
+	size_t bytes = sizeof(float) * width * height;
+	std::vector<float> h_src(width * height), h_a(width * height), h_b(width * height);
+	for (size_t i = 0; i < h_src.size(); i++)
+		h_src[i] = (float) rand() / RAND_MAX;
+	BufferLease src = clDevice.Buffers.Acquire(bytes, CL_MEM_READ_ONLY);
+	BufferLease a = clDevice.Buffers.Acquire(bytes, CL_MEM_READ_WRITE);
+	BufferLease b = clDevice.Buffers.Acquire(bytes, CL_MEM_READ_WRITE);
+	if (src.Get() == NULL || a.Get() == NULL || b.Get() == NULL)
+		return 1;
+	clEnqueueWriteBuffer(queue, src.Get(), CL_TRUE, 0, bytes, &h_src[0], 0, NULL, NULL);
+
+	float custom[25];
+	for (int i = 0; i < 25; i++)
+		custom[i] = (float) ((i * 7) % 5 - 2);
+	const char *names[] = { "box 3x3", "sobel x", "laplacian", "gaussian 5x5", "custom 5x5", "gaussian 15x15" };
+	ConvolutionMask masks[] = { ConvolutionMask::Box(1), ConvolutionMask::SobelX(), ConvolutionMask::Laplacian(),
+		ConvolutionMask::Gaussian(2), ConvolutionMask::Custom(5, 5, custom), ConvolutionMask::Gaussian(7) };
+
+	std::cout << "ms per frame        specialized    generic    speedup   max diff" << std::endl;
+	for (int m = 0; m < 6; m++) {
+		Convolution conv(clDevice, masks[m]);
+		if (!conv.Valid())
+			return 1;
+		//first runs build nothing more, they warm up
+		conv.Run(src.Get(), a.Get(), width, height);
+		conv.RunGeneric(src.Get(), b.Get(), width, height);
+		clFinish(queue);
+
+		Timer timer;
+		for (int r = 0; r < runs; r++)
+			conv.Run(src.Get(), a.Get(), width, height);
+		clFinish(queue);
+		double specialMs = timer.MilliSeconds() / runs;
+		timer.Start();
+		for (int r = 0; r < runs; r++)
+			conv.RunGeneric(src.Get(), b.Get(), width, height);
+		clFinish(queue);
+		double genericMs = timer.MilliSeconds() / runs;
+
+		clEnqueueReadBuffer(queue, a.Get(), CL_TRUE, 0, bytes, &h_a[0], 0, NULL, NULL);
+		clEnqueueReadBuffer(queue, b.Get(), CL_TRUE, 0, bytes, &h_b[0], 0, NULL, NULL);
+		float diff = 0;
+		for (size_t i = 0; i < h_a.size(); i++)
+			diff = std::max(diff, fabsf(h_a[i] - h_b[i]));
+
+		std::cout << std::fixed << std::setprecision(3) << std::left << std::setw(16) << names[m] << std::right
+			<< std::setw(14) << specialMs << std::setw(11) << genericMs
+			<< std::setw(10) << (specialMs > 0 ? genericMs / specialMs : 0) << "x"
+			<< std::scientific << std::setprecision(1) << std::setw(10) << diff << std::endl;
+	}
+	std::cout.unsetf(std::ios::floatfield);
+	std::cout << clDevice.Variants.size() << " program variants built" << std::endl;
+	return 0;
+}
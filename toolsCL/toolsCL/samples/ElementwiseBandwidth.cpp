@@ -0,0 +1,99 @@
+#include "../device.hpp"
+#include "../elementwise.hpp"
+#include "../timer.hpp"
+#include <vector>
+#include <iomanip>
+
+//Grid-stride elementwise kernels at widths 1, 4 and 8 against the one
+//float per work-item mul2 and a device-to-device copy, the practical peak.
+//Lengths that are no multiple of anything check the tails; every result
+//is compared with the host.
+int ElementwiseBandwidth()
+{
+	Device clDevice;
+	clDevice.Init();
+	if (clDevice.Context == NULL)
+		return 1;
+	cl_command_queue queue = clDevice.CommandQueue;
+	Elementwise elementwise(clDevice);
+	const int runs = 10;
+	const size_t lengths[] = { 1, 7, 1000, (1 << 20) + 5, (1 << 24) + 3 };
+	const int widths[] = { 1, 4, 8 };
+	std::cout << "preferred float width picks scale_v" << elementwise.VectorWidth<cl_float>()
+		<< "_float" << std::endl;
+	std::cout << "GB/s        elements    copy    mul2     v1     v4     v8   errors" << std::endl;
+
+	int failed = 0;
+	for (size_t l = 0; l < sizeof(lengths) / sizeof(lengths[0]); l++) {
+		size_t n = lengths[l], bytes = n * sizeof(float);
+		std::vector<float> h_x(n), h_y(n), result(n);
+		for (size_t i = 0; i < n; i++) {
+			h_x[i] = (float) (i % 1000);
+			h_y[i] = (float) (i % 7);
+		}
+		BufferLease x = clDevice.Buffers.Acquire(bytes, CL_MEM_READ_ONLY);
+		BufferLease y = clDevice.Buffers.Acquire(bytes, CL_MEM_READ_WRITE);
+		BufferLease out = clDevice.Buffers.Acquire(bytes, CL_MEM_READ_WRITE);
+		OCL_CHECK(clDevice.Staging.Upload(queue, x.Get(), 0, &h_x[0], bytes), "ElementwiseBandwidth: write x");
+		OCL_CHECK(clDevice.Staging.Upload(queue, y.Get(), 0, &h_y[0], bytes), "ElementwiseBandwidth: write y");
+
+		//! copy, the bandwidth to aim for
+		clEnqueueCopyBuffer(queue, x.Get(), out.Get(), 0, 0, bytes, 0, NULL, NULL);
+		clFinish(queue);
+		Timer timer;
+		for (int r = 0; r < runs; r++)
+			clEnqueueCopyBuffer(queue, x.Get(), out.Get(), 0, 0, bytes, 0, NULL, NULL);
+		clFinish(queue);
+		double copyMs = timer.MilliSeconds() / runs;
+
+		//! mul2, one work-item per element, global size n
+		cl_kernel mul2 = clDevice.GetKernel<cl_float>("mul2");
+		clDevice.Launch(mul2, NDRange(n), x.Get(), out.Get());
+		clFinish(queue);
+		timer.Start();
+		for (int r = 0; r < runs; r++)
+			clDevice.Launch(mul2, NDRange(n), x.Get(), out.Get());
+		clFinish(queue);
+		double mul2Ms = timer.MilliSeconds() / runs;
+
+		//! the grid-stride kernels at each width
+		double ms[3];
+		size_t errors = 0;
+		for (int w = 0; w < 3; w++) {
+			elementwise.forceWidth = widths[w];
+			elementwise.Mul2<cl_float>(x.Get(), out.Get(), n);
+			clFinish(queue);
+			timer.Start();
+			for (int r = 0; r < runs; r++)
+				elementwise.Mul2<cl_float>(x.Get(), out.Get(), n);
+			clFinish(queue);
+			ms[w] = timer.MilliSeconds() / runs;
+			OCL_CHECK(clDevice.Staging.Download(queue, out.Get(), 0, &result[0], bytes), "ElementwiseBandwidth: read");
+			for (size_t i = 0; i < n; i++)
+				errors += result[i] != h_x[i] * 2;
+
+			//add and axpy at the same width; y is restored for the next width
+			elementwise.Add<cl_float>(x.Get(), y.Get(), out.Get(), n);
+			OCL_CHECK(clDevice.Staging.Download(queue, out.Get(), 0, &result[0], bytes), "ElementwiseBandwidth: read");
+			for (size_t i = 0; i < n; i++)
+				errors += result[i] != h_x[i] + h_y[i];
+			elementwise.Axpy<cl_float>(0.5f, x.Get(), y.Get(), n);
+			OCL_CHECK(clDevice.Staging.Download(queue, y.Get(), 0, &result[0], bytes), "ElementwiseBandwidth: read");
+			for (size_t i = 0; i < n; i++)
+				errors += result[i] != 0.5f * h_x[i] + h_y[i];
+			OCL_CHECK(clDevice.Staging.Upload(queue, y.Get(), 0, &h_y[0], bytes), "ElementwiseBandwidth: write y");
+		}
+		elementwise.forceWidth = 0;
+		if (errors != 0)
+			failed = 1;
+
+		//a read and a write per element
+		double gb = 2.0 * bytes / 1e6;
+		std::cout << std::fixed << std::setprecision(2) << std::setw(18) << n
+			<< std::setw(8) << gb / copyMs << std::setw(8) << gb / mul2Ms
+			<< std::setw(7) << gb / ms[0] << std::setw(7) << gb / ms[1] << std::setw(7) << gb / ms[2]
+			<< std::setw(9) << errors << std::endl;
+	}
+	std::cout.unsetf(std::ios::floatfield);
+	return failed;
+}
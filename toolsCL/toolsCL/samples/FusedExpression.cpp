@@ -0,0 +1,88 @@
+#include "../device.hpp"
+#include "../expression.hpp"
+#include "../timer.hpp"
+#include <stdlib.h>
+#include <math.h>
+#include <vector>
+#include <algorithm>
+
+//out = a * 2 + sqrt(b) - c as one fused kernel against the same chain
+//run one operation per pass through temporaries, as separate mul2-like
+//kernels would. Prints the time and global memory traffic of both.
+int FusedExpression(int num)
+{
+	Device clDevice;
+	clDevice.Init();
+	if (clDevice.Context == NULL)
+		return 1;
+	cl_command_queue queue = clDevice.CommandQueue;
+	const int runs = 10;
+	size_t bytes = sizeof(float) * num;
+
+	std::vector<float> h_a(num), h_b(num), h_c(num), fused(num), chained(num);
+	for (int i = 0; i < num; i++) {
+		h_a[i] = (float) rand() / RAND_MAX;
+		h_b[i] = (float) rand() / RAND_MAX * 100.0f;
+		h_c[i] = (float) rand() / RAND_MAX;
+	}
+	BufferLease d_a = clDevice.Buffers.Acquire(bytes, CL_MEM_READ_ONLY);
+	BufferLease d_b = clDevice.Buffers.Acquire(bytes, CL_MEM_READ_ONLY);
+	BufferLease d_c = clDevice.Buffers.Acquire(bytes, CL_MEM_READ_ONLY);
+	BufferLease d_t = clDevice.Buffers.Acquire(bytes, CL_MEM_READ_WRITE);
+	BufferLease d_u = clDevice.Buffers.Acquire(bytes, CL_MEM_READ_WRITE);
+	BufferLease d_out = clDevice.Buffers.Acquire(bytes, CL_MEM_READ_WRITE);
+	OCL_CHECK(clDevice.Staging.Upload(queue, d_a.Get(), 0, &h_a[0], bytes), "FusedExpression: write a");
+	OCL_CHECK(clDevice.Staging.Upload(queue, d_b.Get(), 0, &h_b[0], bytes), "FusedExpression: write b");
+	OCL_CHECK(clDevice.Staging.Upload(queue, d_c.Get(), 0, &h_c[0], bytes), "FusedExpression: write c");
+
+	ExpressionEngine fuse(clDevice);
+	DeviceArray a = fuse.Array(d_a.Get(), num), b = fuse.Array(d_b.Get(), num), c = fuse.Array(d_c.Get(), num);
+	DeviceArray t = fuse.Array(d_t.Get(), num), u = fuse.Array(d_u.Get(), num);
+	DeviceArray out = fuse.Array(d_out.Get(), num);
+
+	//! one pass per operation: 4 kernels, 10 array passes
+	t = a * 2.0f;
+	u = sqrt(b);
+	t = t + u;
+	out = t - c;
+	clFinish(queue);
+	Timer timer;
+	for (int r = 0; r < runs; r++) {
+		t = a * 2.0f;
+		u = sqrt(b);
+		t = t + u;
+		out = t - c;
+	}
+	clFinish(queue);
+	double chainedMs = timer.MilliSeconds() / runs;
+	OCL_CHECK(clDevice.Staging.Download(queue, d_out.Get(), 0, &chained[0], bytes), "FusedExpression: read chained");
+
+	//! fused: one kernel, 3 reads and a write
+	out = a * 2.0f + sqrt(b) - c;
+	clFinish(queue);
+	timer.Start();
+	for (int r = 0; r < runs; r++)
+		out = a * 2.0f + sqrt(b) - c;
+	clFinish(queue);
+	double fusedMs = timer.MilliSeconds() / runs;
+	OCL_CHECK(clDevice.Staging.Download(queue, d_out.Get(), 0, &fused[0], bytes), "FusedExpression: read fused");
+
+	//same shape, other scalar: no new kernel
+	size_t shapes = fuse.Shapes();
+	out = a * 3.0f + sqrt(b) - c;
+	clFinish(queue);
+
+	double maxDiff = 0;
+	for (int i = 0; i < num; i++)
+		maxDiff = std::max(maxDiff, (double) fabs(fused[i] - chained[i]));
+	std::cout << "out = a * 2 + sqrt(b) - c on " << num << " floats" << std::endl;
+	std::cout << "\tchained, 4 kernels:\t" << chainedMs << " ms\t" << ((10 * bytes) >> 20) << " MB moved" << std::endl;
+	std::cout << "\tfused, 1 kernel:\t" << fusedMs << " ms\t" << ((4 * bytes) >> 20) << " MB moved" << std::endl;
+	std::cout << "\tspeedup " << chainedMs / fusedMs << "x, max diff " << maxDiff << ", "
+		<< fuse.Shapes() << " kernels built (" << (fuse.Shapes() == shapes ? "scalar change reused" : "rebuilt")
+		<< "), " << fuse.Launches() << " launches" << std::endl;
+	ExprBuilder shape;
+	(a * 2.0f + sqrt(b) - c).Emit(shape);
+	std::cout << ExpressionEngine::KernelSource(shape);
+	return maxDiff < 1e-4 ? 0 : 1;
+}
@@ -0,0 +1,105 @@
+#include "../device.hpp"
+#include "../gaussian.hpp"
+#include "../timer.hpp"
+#include <stdlib.h>
+#include <iomanip>
+#include <algorithm>
+
+//The 3x3 gaussian_filter against the separable tiled filter on RGBA8
+//images up to 4K. At radius 1 the separable taps are set to 1 2 1 / 4,
+//the same filter, and the outputs are compared; larger radii have no
+//counterpart in the old kernel.
+int GaussianBenchmark()
+{
+	Device clDevice;
+	clDevice.Init();
+	if (clDevice.Context == NULL)
+		return 1;
+	cl_command_queue queue = clDevice.CommandQueue;
+	cl_kernel stencil = clDevice.GetKernel("gaussian_filter");
+	if (stencil == NULL)
+		return 1;
+	cl_int err = CL_SUCCESS;
+	cl_sampler sampler = clCreateSampler(clDevice.Context, CL_FALSE, CL_ADDRESS_CLAMP_TO_EDGE,
+		CL_FILTER_NEAREST, &err);
+	OCL_CHECK(err, "GaussianBenchmark: sampler");
+
+	const int sizes[][2] = { { 512, 512 }, { 1920, 1080 }, { 3840, 2160 } };
+	const int radii[] = { 1, 5, 15 };
+	const int runs = 10;
+	std::cout << "ms per frame          3x3 stencil  separable r=1  r=5  r=15   max diff r=1" << std::endl;
+	for (int s = 0; s < 3; s++) {
+		int width = sizes[s][0], height = sizes[s][1];
+		std::vector<unsigned char> pixels((size_t) width * height * 4);
+		for (size_t i = 0; i < pixels.size(); i++)
+			pixels[i] = (unsigned char) (rand() & 0xff);
+		cl_image_format format;
+		format.image_channel_order = CL_RGBA;
+		format.image_channel_data_type = CL_UNORM_INT8;
+		cl_mem src = clCreateImage2D(clDevice.Context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, &format,
+			width, height, 0, &pixels[0], &err);
+		cl_mem dst[2];
+		for (int i = 0; i < 2; i++)
+			dst[i] = clCreateImage2D(clDevice.Context, CL_MEM_WRITE_ONLY, &format, width, height, 0, NULL, &err);
+		if (src == NULL || dst[0] == NULL || dst[1] == NULL) {
+			std::cout << "Err: GaussianBenchmark images ( Err = " << err << " )" << std::endl;
+			return 1;
+		}
+
+		//! old kernel: 16x16 groups as the sample used to launch it
+		size_t local[2] = { 16, 16 };
+		size_t global[2] = { (size_t) (width + 15) / 16 * 16, (size_t) (height + 15) / 16 * 16 };
+		clDevice.SetArgs(stencil, src, dst[0], sampler, (cl_int) width, (cl_int) height);
+		clEnqueueNDRangeKernel(queue, stencil, 2, NULL, global, local, 0, NULL, NULL);
+		clFinish(queue);
+		Timer timer;
+		for (int r = 0; r < runs; r++)
+			clEnqueueNDRangeKernel(queue, stencil, 2, NULL, global, local, 0, NULL, NULL);
+		clFinish(queue);
+		double stencilMs = timer.MilliSeconds() / runs;
+
+		//! separable, radius 1 with the same taps, then real Gaussians
+		double separableMs[3];
+		int maxDiff = 0;
+		for (int k = 0; k < 3; k++) {
+			SeparableGaussian blur(clDevice, radii[k]);
+			if (k == 0) {
+				std::vector<float> binomial(3, 0.25f);
+				binomial[1] = 0.5f;
+				blur.SetWeights(binomial);
+			}
+			if (blur.Run(src, dst[1], width, height) != CL_SUCCESS)
+				return 1;
+			clFinish(queue);
+			timer.Start();
+			for (int r = 0; r < runs; r++)
+				blur.Run(src, dst[1], width, height);
+			clFinish(queue);
+			separableMs[k] = timer.MilliSeconds() / runs;
+			if (k == 0) {
+				//compare before dst[1] is overwritten
+				std::vector<unsigned char> a(pixels.size()), b(pixels.size());
+				size_t origin[3] = { 0, 0, 0 };
+				size_t region[3] = { (size_t) width, (size_t) height, 1 };
+				clEnqueueReadImage(queue, dst[0], CL_TRUE, origin, region, 0, 0, &a[0], 0, NULL, NULL);
+				clEnqueueReadImage(queue, dst[1], CL_TRUE, origin, region, 0, 0, &b[0], 0, NULL, NULL);
+				for (size_t i = 0; i < a.size(); i++)
+					maxDiff = std::max(maxDiff, abs((int) a[i] - (int) b[i]));
+			}
+		}
+
+		std::cout << std::fixed << std::setprecision(3)
+			<< std::setw(5) << width << "x" << std::setw(4) << height
+			<< std::setw(20) << stencilMs
+			<< std::setw(15) << separableMs[0]
+			<< std::setw(8) << separableMs[1]
+			<< std::setw(8) << separableMs[2]
+			<< std::setw(10) << maxDiff << std::endl;
+		clReleaseMemObject(src);
+		clReleaseMemObject(dst[0]);
+		clReleaseMemObject(dst[1]);
+	}
+	std::cout.unsetf(std::ios::floatfield);
+	clReleaseSampler(sampler);
+	return 0;
+}
@@ -0,0 +1,113 @@
+#include "../device.hpp"
+#include "../half_storage.hpp"
+#include "../gaussian.hpp"
+#include "../timer.hpp"
+#include <stdlib.h>
+#include <vector>
+
+//fp32 against fp16 storage, both computing in fp32: mul2 on buffers,
+//then the 3x3 gaussian_filter and the separable Gaussian on RGBA images.
+//Prints the device bytes and time of each and the error of the half path.
+int HalfStorage(int num)
+{
+	Device clDevice;
+	clDevice.Init();
+	if (clDevice.Context == NULL)
+		return 1;
+	cl_command_queue queue = clDevice.CommandQueue;
+	const int runs = 10;
+	const StoragePrecision modes[2] = { STORAGE_FLOAT, STORAGE_HALF };
+	std::cout << "fp16 storage on " << clDevice.GetSelected().deviceName
+		<< (HalfArithmetic(clDevice.pDevices[0]) ? ", cl_khr_fp16" : ", no cl_khr_fp16 (storage only)") << std::endl;
+
+	//! mul2 on buffers
+	std::vector<float> h_idata(num), output[2];
+	for (int i = 0; i < num; i++)
+		h_idata[i] = (float) rand() / RAND_MAX * 100.0f - 50.0f;
+	const char *names[2] = { "mul2_float", "mul2_half" };
+	double ms[2];
+	for (int m = 0; m < 2; m++) {
+		size_t bytes = StorageSize(modes[m]) * num;
+		BufferLease in = clDevice.Buffers.Acquire(bytes, CL_MEM_READ_ONLY);
+		BufferLease out = clDevice.Buffers.Acquire(bytes, CL_MEM_READ_WRITE);
+		cl_mem d_idata = in.Get(), d_odata = out.Get();
+		OCL_CHECK(UploadFloats(clDevice, d_idata, modes[m], &h_idata[0], num), "HalfStorage: write input");
+		cl_kernel kernel = clDevice.GetKernel(names[m]);
+		if (kernel == NULL)
+			return 1;
+		clDevice.Launch(kernel, NDRange(num), d_idata, d_odata);
+		clFinish(queue);
+		Timer timer;
+		for (int r = 0; r < runs; r++)
+			clDevice.Launch(kernel, NDRange(num), d_idata, d_odata);
+		clFinish(queue);
+		ms[m] = timer.MilliSeconds() / runs;
+		output[m].resize(num);
+		OCL_CHECK(DownloadFloats(clDevice, d_odata, modes[m], &output[m][0], num), "HalfStorage: read output");
+		std::cout << "\t" << names[m] << ":\t" << ((2 * bytes) >> 20) << " MB on the device\t" << ms[m] << " ms" << std::endl;
+	}
+	std::cout << "\tmul2_half speedup: " << ms[0] / ms[1] << "x" << std::endl;
+	ComparePrecision(&output[0][0], &output[1][0], num).Display("mul2_half");
+
+	//! RGBA images, CL_FLOAT against CL_HALF_FLOAT
+	if (!HalfImageSupport(clDevice.Context)) {
+		std::cout << "\tno CL_HALF_FLOAT images on this device" << std::endl;
+		return 0;
+	}
+	cl_kernel stencil = clDevice.GetKernel("gaussian_filter");
+	cl_int err = CL_SUCCESS;
+	cl_sampler sampler = clCreateSampler(clDevice.Context, CL_FALSE, CL_ADDRESS_CLAMP_TO_EDGE,
+		CL_FILTER_NEAREST, &err);
+	OCL_CHECK(err, "HalfStorage: sampler");
+	if (stencil == NULL || sampler == NULL)
+		return 1;
+	const int width = 1920, height = 1080;
+	size_t count = (size_t) width * height * 4;
+	std::vector<float> pixels(count), stencilOut[2], blurOut[2];
+	for (size_t i = 0; i < count; i++)
+		pixels[i] = (float) rand() / RAND_MAX;
+	NDRange range = NDRange((width + 15) / 16 * 16, (height + 15) / 16 * 16).Local(16, 16);
+	double stencilMs[2], blurMs[2];
+	for (int m = 0; m < 2; m++) {
+		cl_mem src = CreateFloatImage(clDevice, modes[m], width, height, CL_MEM_READ_ONLY, &pixels[0]);
+		cl_mem dst = CreateFloatImage(clDevice, modes[m], width, height, CL_MEM_READ_WRITE);
+		if (src == NULL || dst == NULL)
+			return 1;
+
+		clDevice.Launch(stencil, range, src, dst, sampler, (cl_int) width, (cl_int) height);
+		clFinish(queue);
+		Timer timer;
+		for (int r = 0; r < runs; r++)
+			clDevice.Launch(stencil, range, src, dst, sampler, (cl_int) width, (cl_int) height);
+		clFinish(queue);
+		stencilMs[m] = timer.MilliSeconds() / runs;
+		stencilOut[m].resize(count);
+		ReadFloatImage(clDevice, dst, modes[m], width, height, &stencilOut[m][0]);
+
+		//the intermediate image follows the storage mode too
+		SeparableGaussian blur(clDevice, 7);
+		blur.precision = modes[m];
+		if (blur.Run(src, dst, width, height) != CL_SUCCESS)
+			return 1;
+		clFinish(queue);
+		timer.Start();
+		for (int r = 0; r < runs; r++)
+			blur.Run(src, dst, width, height);
+		clFinish(queue);
+		blurMs[m] = timer.MilliSeconds() / runs;
+		blurOut[m].resize(count);
+		ReadFloatImage(clDevice, dst, modes[m], width, height, &blurOut[m][0]);
+
+		std::cout << "\t" << (m == 0 ? "CL_FLOAT" : "CL_HALF_FLOAT") << " " << width << "x" << height << ":\t"
+			<< ((2 * count * StorageSize(modes[m])) >> 20) << " MB on the device\tgaussian_filter "
+			<< stencilMs[m] << " ms\tseparable r=7 " << blurMs[m] << " ms" << std::endl;
+		clReleaseMemObject(src);
+		clReleaseMemObject(dst);
+	}
+	std::cout << "\thalf speedup: gaussian_filter " << stencilMs[0] / stencilMs[1]
+		<< "x, separable " << blurMs[0] / blurMs[1] << "x" << std::endl;
+	ComparePrecision(&stencilOut[0][0], &stencilOut[1][0], count).Display("gaussian_filter half");
+	ComparePrecision(&blurOut[0][0], &blurOut[1][0], count).Display("separable half");
+	clReleaseSampler(sampler);
+	return 0;
+}
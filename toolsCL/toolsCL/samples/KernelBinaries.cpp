@@ -0,0 +1,17 @@
+#include "../device.hpp"
+
+//Write the binaries of every kernel file for the selected device, to be
+//embedded by "kernelGen/cl_kernels.sh -b ./cl_binaries" and loaded by the
+//RUN_Android build without running the compiler
+int KernelBinaries()
+{
+	Device clDevice;
+	clDevice.Init();
+
+	if (!clDevice.DumpBinaries("./kernelGen/cl_binaries/"))
+	{
+		std::cerr << "Failed to dump kernel binaries." << std::endl;
+		return 1;
+	}
+	return 0;
+}
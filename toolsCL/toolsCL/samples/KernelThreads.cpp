@@ -0,0 +1,87 @@
+#include "../device.hpp"
+#include "../timer.hpp"
+#include <thread>
+#include <atomic>
+
+//Request threads sharing one Device. Stress: each thread runs mul2 on
+//its own values with its own kernel instance from GetKernel, so any
+//argument crossing between threads shows up as wrong results.
+//Benchmark: launches/sec of set-args + enqueue against thread count.
+int KernelThreads(int maxThreads)
+{
+	Device clDevice;
+	clDevice.Init();
+	if (clDevice.Context == NULL)
+		return 1;
+	cl_command_queue queue = clDevice.CommandQueue;
+	const int num = 4096;
+	const size_t bytes = sizeof(float) * num;
+
+	//! stress: verify every result
+	std::atomic<int> errors(0), failures(0);
+	std::vector<std::thread> threads;
+	for (int t = 0; t < maxThreads; t++) {
+		threads.push_back(std::thread([&, t]() {
+			std::vector<float> h_idata(num), h_odata(num);
+			for (int iter = 0; iter < 200; iter++) {
+				cl_kernel kernel = clDevice.GetKernel<cl_float>("mul2");
+				BufferLease d_idata = clDevice.Buffers.Acquire(bytes, CL_MEM_READ_ONLY);
+				BufferLease d_odata = clDevice.Buffers.Acquire(bytes, CL_MEM_WRITE_ONLY);
+				cl_mem idata = d_idata.Get(), odata = d_odata.Get();
+				if (kernel == NULL || idata == NULL || odata == NULL) {
+					failures++;
+					return;
+				}
+				float base = (float) (t * 100000 + iter);
+				for (int i = 0; i < num; i++)
+					h_idata[i] = base + i;
+				size_t global_work_size[] = { (size_t)num };
+				cl_int err = clEnqueueWriteBuffer(queue, idata, CL_FALSE, 0, bytes, &h_idata[0], 0, NULL, NULL);
+				err |= clSetKernelArg(kernel, 0, sizeof(cl_mem), &idata);
+				err |= clSetKernelArg(kernel, 1, sizeof(cl_mem), &odata);
+				//give another thread the chance to overwrite the arguments
+				std::this_thread::yield();
+				err |= clEnqueueNDRangeKernel(queue, kernel, 1, NULL, global_work_size, NULL, 0, NULL, NULL);
+				err |= clEnqueueReadBuffer(queue, odata, CL_TRUE, 0, bytes, &h_odata[0], 0, NULL, NULL);
+				if (err != CL_SUCCESS)
+					failures++;
+				for (int i = 0; i < num; i++)
+					errors += h_odata[i] != h_idata[i] * 2;
+			}
+		}));
+	}
+	for (size_t t = 0; t < threads.size(); t++)
+		threads[t].join();
+	threads.clear();
+	std::cout << "stress: " << maxThreads << " threads x 200 launches, " << errors << " wrong values, "
+		<< failures << " failed calls, " << clDevice.KernelInstances.size() << " kernel instances" << std::endl;
+
+	//! benchmark: launch rate, tiny kernels so the host side dominates
+	BufferLease d_idata = clDevice.Buffers.Acquire(bytes, CL_MEM_READ_ONLY);
+	BufferLease d_odata = clDevice.Buffers.Acquire(bytes, CL_MEM_WRITE_ONLY);
+	cl_mem idata = d_idata.Get(), odata = d_odata.Get();
+	const int launches = 20000;
+	std::cout << "threads  launches/s" << std::endl;
+	for (int n = 1; n <= maxThreads; n *= 2) {
+		clFinish(queue);
+		Timer timer;
+		for (int t = 0; t < n; t++) {
+			threads.push_back(std::thread([&]() {
+				size_t global_work_size[] = { 256 };
+				for (int i = 0; i < launches / n; i++) {
+					cl_kernel kernel = clDevice.GetKernel<cl_float>("mul2");
+					clSetKernelArg(kernel, 0, sizeof(cl_mem), &idata);
+					clSetKernelArg(kernel, 1, sizeof(cl_mem), &odata);
+					clEnqueueNDRangeKernel(queue, kernel, 1, NULL, global_work_size, NULL, 0, NULL, NULL);
+				}
+			}));
+		}
+		for (size_t t = 0; t < threads.size(); t++)
+			threads[t].join();
+		threads.clear();
+		clFinish(queue);
+		double ms = timer.MilliSeconds();
+		std::cout << n << "\t " << (ms > 0 ? (launches / n) * n / (ms / 1000) : 0) << std::endl;
+	}
+	return errors == 0 && failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,75 @@
+#include "../device.hpp"
+#include "../timer.hpp"
+
+//Host cost of a launch: clSetKernelArg for every argument each time
+//against Device::Launch, which checks the arguments, sets the buffers and
+//only the by-value ones that changed, and takes the Tuner's local size
+//(timed before the runs counted here). Tiny kernels, so the host side
+//dominates. Ends with a mismatched launch that Launch refuses instead of
+//running.
+int LaunchOverhead()
+{
+	Device clDevice;
+	clDevice.Init();
+	if (clDevice.Context == NULL)
+		return 1;
+	cl_command_queue queue = clDevice.CommandQueue;
+	cl_kernel kernel = clDevice.GetKernel<cl_float>("mul2");
+	if (kernel == NULL)
+		return 1;
+
+	const size_t num = 256;
+	BufferLease a = clDevice.Buffers.Acquire(sizeof(float) * num);
+	BufferLease b = clDevice.Buffers.Acquire(sizeof(float) * num);
+	cl_mem d_a = a.Get(), d_b = b.Get();
+	const int launches = 20000;
+	size_t global_work_size[] = { num };
+
+	clFinish(queue);
+	Timer timer;
+	for (int i = 0; i < launches; i++) {
+		clSetKernelArg(kernel, 0, sizeof(cl_mem), &d_a);
+		clSetKernelArg(kernel, 1, sizeof(cl_mem), &d_b);
+		clEnqueueNDRangeKernel(queue, kernel, 1, NULL, global_work_size, NULL, 0, NULL, NULL);
+	}
+	clFinish(queue);
+	double manualMs = timer.MilliSeconds();
+
+	//the state remembers nothing set by hand above
+	ForgetKernelArgs(clDevice.generation, kernel);
+	//the first launch without a local size tunes it
+	clDevice.Launch(kernel, NDRange(num), d_a, d_b);
+	clFinish(queue);
+	timer.Start();
+	for (int i = 0; i < launches; i++)
+		clDevice.Launch(kernel, NDRange(num), d_a, d_b);
+	clFinish(queue);
+	double sameMs = timer.MilliSeconds();
+
+	//ping-pong: both arguments change every launch
+	timer.Start();
+	for (int i = 0; i < launches; i++) {
+		if (i & 1)
+			clDevice.Launch(kernel, NDRange(num), d_b, d_a);
+		else
+			clDevice.Launch(kernel, NDRange(num), d_a, d_b);
+	}
+	clFinish(queue);
+	double changedMs = timer.MilliSeconds();
+
+	KernelArgState &state = GetKernelArgState(clDevice.generation, kernel);
+	std::cout << "launches/s of mul2 (" << launches << " launches)" << std::endl;
+	std::cout << "\tclSetKernelArg each launch:\t" << launches / (manualMs / 1000) << std::endl;
+	std::cout << "\tLaunch, same arguments:\t\t" << launches / (sameMs / 1000) << std::endl;
+	std::cout << "\tLaunch, changed arguments:\t" << launches / (changedMs / 1000) << std::endl;
+	std::cout << "\targuments set: " << state.sets << ", skipped: " << state.skips
+		<< (state.address.empty() ? " (no kernel arg info, count checks only)" : "") << std::endl;
+	std::cout << "\ttuned local size: " << (state.tunedLocal.dims == 0 ? 0 : state.tunedLocal.size[0])
+		<< (state.tunedLocal.dims == 0 ? " (NULL, the driver's)" : "") << std::endl;
+
+	//wrong count, then a float where mul2 wants a buffer
+	cl_int countErr = clDevice.Launch(kernel, NDRange(num), d_a);
+	cl_int typeErr = clDevice.Launch(kernel, NDRange(num), d_a, 2.0f);
+	std::cout << "\tmismatched launches: " << countErr << ", " << typeErr << std::endl;
+	return 0;
+}
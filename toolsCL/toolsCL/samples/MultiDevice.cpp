@@ -0,0 +1,103 @@
+#include "../device.hpp"
+#include "../ndrange_split.hpp"
+#include <math.h>
+#include <stdlib.h>
+#include <algorithm>
+
+//3x3 gaussian of gaussian_filter on the host, edges clamped
+static void GaussianReference(const unsigned char *src, unsigned char *dst, int width, int height)
+{
+	const float weights[9] = { 1, 2, 1, 2, 4, 2, 1, 2, 1 };
+	for (int y = 0; y < height; y++) {
+		for (int x = 0; x < width; x++) {
+			for (int c = 0; c < 4; c++) {
+				float sum = 0;
+				for (int k = 0; k < 9; k++) {
+					int sx = std::min(std::max(x + k % 3 - 1, 0), width - 1);
+					int sy = std::min(std::max(y + k / 3 - 1, 0), height - 1);
+					sum += src[(sy * width + sx) * 4 + c] / 255.0f * (weights[k] / 16.0f);
+				}
+				dst[(y * width + x) * 4 + c] = (unsigned char) (sum * 255.0f + 0.5f);
+			}
+		}
+	}
+}
+
+//Split mul2 and gaussian_filter across every device of the context.
+//subDevices > 0 cuts the picked device into that many sub-devices,
+//which lets a single CPU runtime such as POCL exercise the split.
+int MultiDevice(int subDevices)
+{
+	Device clDevice;
+	if (subDevices > 0)
+		clDevice.InitSubDevices(subDevices);
+	else
+		clDevice.InitMulti();
+	if (clDevice.Context == NULL)
+		return 1;
+
+	NDRangeSplitter splitter(clDevice);
+	std::cout << "Initial shares:" << std::endl;
+	splitter.Display();
+
+	//! mul2, 1D
+	int num = 1 << 22;
+	std::vector<float> h_idata(num), h_odata(num);
+	for (int i = 0; i < num; i++)
+		h_idata[i] = (float) i;
+	cl_kernel mul2 = clDevice.GetKernel<cl_float>("mul2");
+	if (mul2 == NULL)
+		return 1;
+	std::vector<SplitBuffer> buffers;
+	buffers.push_back(SplitBuffer(0, &h_idata[0], sizeof(float), CL_MEM_READ_ONLY));
+	buffers.push_back(SplitBuffer(1, &h_odata[0], sizeof(float), CL_MEM_WRITE_ONLY));
+	for (int run = 0; run < 5; run++) {
+		std::fill(h_odata.begin(), h_odata.end(), 0.0f);
+		if (splitter.Run1D(mul2, num, 256, buffers) != CL_SUCCESS)
+			return 1;
+		int errors = 0;
+		for (int i = 0; i < num; i++)
+			errors += h_odata[i] != h_idata[i] * 2;
+		std::cout << "mul2 run " << run << ": " << errors << " errors" << std::endl;
+		splitter.Display();
+	}
+
+	//! gaussian_filter, 2D with one halo row
+	cl_bool imageSupport = CL_TRUE;
+	for (cl_uint d = 0; d < clDevice.numContextDevices; d++) {
+		cl_bool support = CL_FALSE;
+		clGetDeviceInfo(clDevice.pDevices[d], CL_DEVICE_IMAGE_SUPPORT, sizeof(cl_bool), &support, NULL);
+		imageSupport = imageSupport && support;
+	}
+	if (imageSupport != CL_TRUE) {
+		std::cout << "Skipping gaussian_filter: images not supported" << std::endl;
+		return 0;
+	}
+	int width = 1024, height = 768;
+	std::vector<unsigned char> src(width * height * 4), dst(width * height * 4), ref(width * height * 4);
+	for (size_t i = 0; i < src.size(); i++)
+		src[i] = (unsigned char) ((i * 7) ^ (i >> 9));
+	GaussianReference(&src[0], &ref[0], width, height);
+
+	cl_kernel gaussian = clDevice.GetKernel("gaussian_filter");
+	cl_sampler sampler = clCreateSampler(clDevice.Context, CL_FALSE, CL_ADDRESS_CLAMP_TO_EDGE,
+		CL_FILTER_NEAREST, NULL);
+	if (gaussian == NULL || sampler == NULL)
+		return 1;
+	clSetKernelArg(gaussian, 2, sizeof(cl_sampler), &sampler);
+	clSetKernelArg(gaussian, 3, sizeof(cl_int), &width);
+	cl_image_format format;
+	format.image_channel_order = CL_RGBA;
+	format.image_channel_data_type = CL_UNORM_INT8;
+	for (int run = 0; run < 5; run++) {
+		if (splitter.RunImage2D(gaussian, width, height, 1, format, 4, &src[0], &dst[0], 0, 1, 4) != CL_SUCCESS)
+			break;
+		int errors = 0;
+		for (size_t i = 0; i < dst.size(); i++)
+			errors += abs(dst[i] - ref[i]) > 1;
+		std::cout << "gaussian_filter run " << run << ": " << errors << " errors" << std::endl;
+		splitter.Display();
+	}
+	clReleaseSampler(sampler);
+	return 0;
+}
@@ -0,0 +1,124 @@
+#include "../device.hpp"
+#include "../reduction.hpp"
+#include "../timer.hpp"
+#include <vector>
+#include <numeric>
+#include <algorithm>
+#include <limits>
+#include <cmath>
+
+//Milliseconds per call of f, the first call (the build) not counted
+template <typename F>
+static double TimeRuns(cl_command_queue queue, int runs, F f)
+{
+	f();
+	clFinish(queue);
+	Timer timer;
+	for (int r = 0; r < runs; r++)
+		f();
+	clFinish(queue);
+	return timer.MilliSeconds() / runs;
+}
+
+//Sum, Min, Max, ArgMin and ArgMax of T on the device, where only the
+//result comes back, against reading the whole array back and reducing it
+//with std::accumulate / std::min_element on the host.
+template <typename T>
+static bool ReduceTyped(Device &clDevice, Reduction &reduction, size_t num, int runs)
+{
+	typedef typename ReduceAccumulator<T>::Type Acc;
+	cl_command_queue queue = clDevice.CommandQueue;
+	std::vector<T> h_data(num), h_read(num);
+	for (size_t i = 0; i < num; i++) {
+		h_data[i] = (T) ((i * 7919) % 200);
+		if ((T) -1 < (T) 0)
+			h_data[i] -= (T) 100;
+	}
+	size_t bytes = sizeof(T) * num;
+	BufferLease d_data = clDevice.Buffers.Acquire(bytes, CL_MEM_READ_ONLY);
+	OCL_CHECK(clDevice.Staging.Upload(queue, d_data.Get(), 0, &h_data[0], bytes), "ReduceBenchmark: write");
+
+	Acc sum = 0, minimum = 0, maximum = 0, minValue = 0, maxValue = 0;
+	cl_uint minIndex = 0, maxIndex = 0;
+	cl_int err = reduction.Sum<T>(d_data.Get(), num, sum);
+	if (err != CL_SUCCESS) {
+		std::cout << "\t" << KernelType<T>::Name() << ":\tnot available (" << err << ")" << std::endl;
+		return false;
+	}
+	double deviceMs = TimeRuns(queue, runs, [&]() { reduction.Sum<T>(d_data.Get(), num, sum); });
+	double hostMs = TimeRuns(queue, runs, [&]() {
+		clDevice.Staging.Download(queue, d_data.Get(), 0, &h_read[0], bytes);
+		std::accumulate(h_read.begin(), h_read.end(), (Acc) 0);
+	});
+	reduction.Min<T>(d_data.Get(), num, minimum);
+	reduction.Max<T>(d_data.Get(), num, maximum);
+	reduction.ArgMin<T>(d_data.Get(), num, minValue, minIndex);
+	reduction.ArgMax<T>(d_data.Get(), num, maxValue, maxIndex);
+
+	//the reference in double, exact for the integer types; float sums
+	//differ by the order of the additions
+	double reference = std::accumulate(h_data.begin(), h_data.end(), 0.0);
+	double tolerance = std::numeric_limits<Acc>::is_integer ? 0 : 1e-5 * 100 * num;
+	size_t first = std::min_element(h_data.begin(), h_data.end()) - h_data.begin();
+	size_t last = std::max_element(h_data.begin(), h_data.end()) - h_data.begin();
+	int errors = 0;
+	errors += std::fabs((double) sum - reference) > tolerance;
+	errors += minimum != (Acc) h_data[first] || maximum != (Acc) h_data[last];
+	errors += minValue != (Acc) h_data[first] || minIndex != first;
+	errors += maxValue != (Acc) h_data[last] || maxIndex != last;
+	std::cout << "\t" << KernelType<T>::Name() << ":\tsum " << deviceMs << " ms (" << bytes / (deviceMs * 1e6)
+		<< " GB/s)\treadback + accumulate " << hostMs << " ms\t" << errors << " errors" << std::endl;
+	return errors == 0;
+}
+
+int ReduceBenchmark(int num)
+{
+	Device clDevice;
+	clDevice.Init();
+	if (clDevice.Context == NULL)
+		return 1;
+	cl_command_queue queue = clDevice.CommandQueue;
+	Reduction reduction(clDevice);
+	const int runs = 10;
+	std::cout << "reductions of " << num << " elements, " << clDevice.GetSelected().deviceName << std::endl;
+	bool ok = ReduceTyped<cl_uchar>(clDevice, reduction, num, runs);
+	ok &= ReduceTyped<cl_short>(clDevice, reduction, num, runs);
+	ok &= ReduceTyped<cl_int>(clDevice, reduction, num, runs);
+	ok &= ReduceTyped<cl_float>(clDevice, reduction, num, runs);
+	std::string extensions = Device::GetDeviceString(clDevice.pDevices[0], CL_DEVICE_EXTENSIONS);
+	if (extensions.find("fp64") != std::string::npos)
+		ok &= ReduceTyped<cl_double>(clDevice, reduction, num, runs);
+
+	//! finishing: partials pass against atomics, tree against sub-groups
+	std::vector<cl_int> h_ints(num, 1);
+	std::vector<cl_float> h_floats(num);
+	for (int i = 0; i < num; i++)
+		h_floats[i] = (float) ((i * 7919) % 2001 - 1000);
+	BufferLease d_ints = clDevice.Buffers.Acquire(sizeof(cl_int) * num, CL_MEM_READ_ONLY);
+	BufferLease d_floats = clDevice.Buffers.Acquire(sizeof(cl_float) * num, CL_MEM_READ_ONLY);
+	OCL_CHECK(clDevice.Staging.Upload(queue, d_ints.Get(), 0, &h_ints[0], sizeof(cl_int) * num), "ReduceBenchmark: write");
+	OCL_CHECK(clDevice.Staging.Upload(queue, d_floats.Get(), 0, &h_floats[0], sizeof(cl_float) * num), "ReduceBenchmark: write");
+	cl_int intSum = 0;
+	for (int mode = 0; mode < 4; mode++) {
+		reduction.useAtomics = (mode & 1) != 0;
+		reduction.useSubGroups = (mode & 2) != 0;
+		double ms = TimeRuns(queue, runs, [&]() { reduction.Sum<cl_int>(d_ints.Get(), num, intSum); });
+		std::cout << "\tsum int, " << (reduction.useAtomics ? "atomics" : "partials pass") << ", "
+			<< (reduction.useSubGroups ? "sub-groups" : "local tree") << ":\t" << ms << " ms\t"
+			<< (intSum == num ? "ok" : "wrong") << std::endl;
+		ok &= intSum == num;
+	}
+	reduction.useAtomics = reduction.useSubGroups = true;
+
+	//! a custom op: the largest magnitude
+	float maxAbs = 0;
+	ReduceOp absMax = ReduceOp::Custom("fmax(fabs(a), fabs(b))", "0");
+	double ms = TimeRuns(queue, runs, [&]() { reduction.Reduce<cl_float>(d_floats.Get(), num, absMax, maxAbs); });
+	float expected = 0;
+	for (int i = 0; i < num; i++)
+		expected = std::max(expected, std::fabs(h_floats[i]));
+	std::cout << "\tcustom fmax(fabs(a), fabs(b)):\t" << ms << " ms\t" << maxAbs
+		<< (maxAbs == expected ? " ok" : " wrong") << std::endl;
+	ok &= maxAbs == expected;
+	return ok ? 0 : 1;
+}
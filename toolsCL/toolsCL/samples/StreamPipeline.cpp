@@ -0,0 +1,40 @@
+#include "../device.hpp"
+#include "../stream_executor.hpp"
+#include <algorithm>
+
+//mul2 over an array far larger than one chunk, serial against the
+//double-buffered pipeline on CommandQueue and CommandQueue_helper
+int StreamPipeline()
+{
+	Device clDevice;
+	clDevice.EnableTrace("stream_trace.json");//open in chrome://tracing or ui.perfetto.dev
+	clDevice.Init();
+	if (clDevice.Context == NULL)
+		return 1;
+	cl_kernel kernel = clDevice.GetKernel<cl_float>("mul2");
+	if (kernel == NULL)
+		return 1;
+
+	size_t num = (size_t) 1 << 25;
+	std::vector<float> h_idata(num), h_odata(num);
+	for (size_t i = 0; i < num; i++)
+		h_idata[i] = (float) (i & 0xffff);
+	std::vector<SplitBuffer> buffers;
+	buffers.push_back(SplitBuffer(0, &h_idata[0], sizeof(float), CL_MEM_READ_ONLY));
+	buffers.push_back(SplitBuffer(1, &h_odata[0], sizeof(float), CL_MEM_WRITE_ONLY));
+
+	StreamExecutor stream(clDevice, 1 << 21);
+	for (int overlap = 0; overlap < 2; overlap++) {
+		std::fill(h_odata.begin(), h_odata.end(), 0.0f);
+		cl_int err = overlap ? stream.Run(kernel, num, 256, buffers)
+			: stream.RunSerial(kernel, num, 256, buffers);
+		if (err != CL_SUCCESS)
+			return 1;
+		size_t errors = 0;
+		for (size_t i = 0; i < num; i++)
+			errors += h_odata[i] != h_idata[i] * 2;
+		stream.Display(overlap ? "pipelined" : "serial   ");
+		std::cout << "\t" << errors << " errors" << std::endl;
+	}
+	return 0;
+}
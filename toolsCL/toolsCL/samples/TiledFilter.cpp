@@ -0,0 +1,68 @@
+#include "../device.hpp"
+#include "../gaussian.hpp"
+#include "../tiler.hpp"
+#include "../timer.hpp"
+#include <stdlib.h>
+#include <algorithm>
+
+//Gaussian blur through ImageTiler. First a seam check: a generated image
+//blurred whole and in 256-pixel tiles must match exactly. Then, given an
+//input file, the file is blurred tile by tile into output without ever
+//being held in host memory.
+int TiledFilter(const char *input, const char *output, int radius)
+{
+	Device clDevice;
+	clDevice.Init();
+	if (clDevice.Context == NULL)
+		return 1;
+	SeparableGaussian blur(clDevice, radius);
+	TileFilter filter = [&](cl_mem src, cl_mem dst, int width, int height) {
+		return blur.Run(src, dst, width, height);
+	};
+
+	//! seams: whole image against tiles
+	MemoryImage image(1500, 1100), tiled(1500, 1100);
+	for (size_t i = 0; i < image.pixels.size(); i++)
+		image.pixels[i] = (unsigned char) (rand() & 0xff);
+	cl_image_format format;
+	format.image_channel_order = CL_RGBA;
+	format.image_channel_data_type = CL_UNORM_INT8;
+	cl_int err = CL_SUCCESS;
+	cl_mem src = clCreateImage2D(clDevice.Context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, &format,
+		image.width, image.height, 0, &image.pixels[0], &err);
+	cl_mem dst = clCreateImage2D(clDevice.Context, CL_MEM_WRITE_ONLY, &format, image.width, image.height, 0, NULL, &err);
+	if (src == NULL || dst == NULL)
+		return 1;
+	std::vector<unsigned char> whole(image.pixels.size());
+	size_t origin[3] = { 0, 0, 0 };
+	size_t region[3] = { (size_t) image.width, (size_t) image.height, 1 };
+	blur.Run(src, dst, image.width, image.height);
+	clEnqueueReadImage(clDevice.CommandQueue, dst, CL_TRUE, origin, region, 0, 0, &whole[0], 0, NULL, NULL);
+	clReleaseMemObject(src);
+	clReleaseMemObject(dst);
+
+	ImageTiler tiler(clDevice, blur.Radius());
+	tiler.maxTile = 256;
+	err = tiler.Run(image, tiled, filter);
+	int diff = 0;
+	for (size_t i = 0; i < whole.size(); i++)
+		diff = std::max(diff, abs((int) whole[i] - (int) tiled.pixels[i]));
+	std::cout << "seam check: " << tiler.tiles << " tiles of " << tiler.tileWidth << "x" << tiler.tileHeight
+		<< ", max diff to the whole image " << diff << " ( Err = " << err << " )" << std::endl;
+	if (input == NULL)
+		return diff == 0 && err == CL_SUCCESS ? 0 : 1;
+
+	//! file to file
+	ImageFileSource in;
+	ImageFileSink out;
+	if (!in.Open(input) || !out.Create(output, in.Width(), in.Height()))
+		return 1;
+	tiler.maxTile = 2048;
+	Timer timer;
+	err = tiler.Run(in, out, filter);
+	double ms = timer.MilliSeconds();
+	std::cout << input << " (" << in.Width() << "x" << in.Height() << ") -> " << output << ": "
+		<< tiler.tiles << " tiles of " << tiler.tileWidth << "x" << tiler.tileHeight << ", " << ms << " ms, "
+		<< (ms > 0 ? (double) in.Width() * in.Height() / (ms * 1000) : 0) << " MPixel/s" << std::endl;
+	return err == CL_SUCCESS ? 0 : 1;
+}
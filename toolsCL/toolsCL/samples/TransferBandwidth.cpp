@@ -0,0 +1,88 @@
+#include "../device.hpp"
+#include "../timer.hpp"
+#include <stdlib.h>
+#include <string.h>
+#include <iomanip>
+
+//Best time of a few runs of one transfer, in ms
+template <typename F>
+static double BestOf(int runs, F transfer)
+{
+	double best = 0;
+	for (int r = 0; r < runs; r++) {
+		Timer timer;
+		transfer();
+		double ms = timer.MilliSeconds();
+		if (r == 0 || ms < best)
+			best = ms;
+	}
+	return best;
+}
+
+static double GBs(size_t bytes, double ms)
+{
+	return ms > 0 ? bytes / (ms * 1e6) : 0;
+}
+
+//Host<->device bandwidth from pageable malloc memory against the pinned
+//staging pool, for transfer sizes from 4 KB to 64 MB. "direct" writes
+//straight from a mapped pinned chunk, the ceiling the pool aims for.
+int TransferBandwidth()
+{
+	Device clDevice;
+	clDevice.Init();
+	if (clDevice.Context == NULL)
+		return 1;
+
+	const size_t maxBytes = 64 << 20;
+	cl_command_queue queue = clDevice.CommandQueue;
+	char *pageable = (char *) malloc(maxBytes);
+	memset(pageable, 1, maxBytes);
+	BufferLease device = clDevice.Buffers.Acquire(maxBytes);
+	cl_mem mem = device.Get();
+	if (mem == NULL || !clDevice.Staging.Allocate()) {
+		free(pageable);
+		return 1;
+	}
+	void *direct = clDevice.Staging.Chunk(0);
+	size_t directMax = clDevice.Staging.chunkSize;
+
+	std::cout << "GB/s        size  pageable-up  pinned-up  direct-up  pageable-down  pinned-down" << std::endl;
+	for (size_t bytes = 4 << 10; bytes <= maxBytes; bytes <<= 2) {
+		int runs = bytes < (1 << 20) ? 50 : 5;
+		double pageUp = BestOf(runs, [&]() {
+			clEnqueueWriteBuffer(queue, mem, CL_TRUE, 0, bytes, pageable, 0, NULL, NULL);
+		});
+		double pinUp = BestOf(runs, [&]() {
+			clDevice.Staging.Upload(queue, mem, 0, pageable, bytes);
+			clFinish(queue);
+		});
+		double directUp = 0;
+		if (bytes <= directMax) {
+			directUp = BestOf(runs, [&]() {
+				clEnqueueWriteBuffer(queue, mem, CL_TRUE, 0, bytes, direct, 0, NULL, NULL);
+			});
+		}
+		double pageDown = BestOf(runs, [&]() {
+			clEnqueueReadBuffer(queue, mem, CL_TRUE, 0, bytes, pageable, 0, NULL, NULL);
+		});
+		double pinDown = BestOf(runs, [&]() {
+			clDevice.Staging.Download(queue, mem, 0, pageable, bytes);
+		});
+
+		std::cout << std::fixed << std::setprecision(2)
+			<< std::setw(10) << (bytes >> 10) << " KB"
+			<< std::setw(13) << GBs(bytes, pageUp)
+			<< std::setw(11) << GBs(bytes, pinUp);
+		if (directUp > 0)
+			std::cout << std::setw(11) << GBs(bytes, directUp);
+		else
+			std::cout << std::setw(11) << "-";
+		std::cout << std::setw(15) << GBs(bytes, pageDown)
+			<< std::setw(13) << GBs(bytes, pinDown) << std::endl;
+	}
+	std::cout.unsetf(std::ios::floatfield);
+
+	free(pageable);
+	return 0;
+}
@@ -0,0 +1,63 @@
+#include "../device.hpp"
+#include "../timer.hpp"
+#include <vector>
+
+//mul2 in every element type, on the data as it comes instead of widened
+//to float: uchar moves a quarter of the bytes. Checks the results and
+//prints the effective bandwidth of each instantiation.
+template <typename T>
+static bool RunTyped(Device &clDevice, size_t num, int repeats)
+{
+	std::vector<T> h_idata(num), h_odata(num);
+	for (size_t i = 0; i < num; i++)
+		h_idata[i] = (T)(i % 100);
+	size_t bytes = sizeof(T) * num;
+	BufferLease in = clDevice.Buffers.Acquire(bytes, CL_MEM_READ_ONLY);
+	BufferLease out = clDevice.Buffers.Acquire(bytes, CL_MEM_READ_WRITE);
+	cl_mem d_idata = in.Get(), d_odata = out.Get();
+	OCL_CHECK(clDevice.Staging.Upload(clDevice.CommandQueue, d_idata, 0, &h_idata[0], bytes), "TypedKernels: write input");
+
+	//the first launch builds mul2.cl, keep it out of the timing
+	cl_int err = clDevice.Run<T>("mul2", NDRange(num), d_idata, d_odata);
+	if (err != CL_SUCCESS) {
+		std::cout << "\t" << TemplateName<T>("mul2") << ":\tnot available (" << err << ")" << std::endl;
+		return false;
+	}
+	clFinish(clDevice.CommandQueue);
+	Timer timer;
+	for (int r = 0; r < repeats; r++)
+		clDevice.Run<T>("mul2", NDRange(num), d_idata, d_odata);
+	clFinish(clDevice.CommandQueue);
+	double ms = timer.MilliSeconds() / repeats;
+
+	OCL_CHECK(clDevice.Staging.Download(clDevice.CommandQueue, d_odata, 0, &h_odata[0], bytes), "TypedKernels: read output");
+	size_t errors = 0;
+	for (size_t i = 0; i < num; i++) {
+		if (h_odata[i] != (T)(h_idata[i] * 2))
+			errors++;
+	}
+	std::cout << "\t" << TemplateName<T>("mul2") << ":\t" << ms << " ms\t"
+		<< 2.0 * bytes / (ms * 1e6) << " GB/s\t" << errors << " errors" << std::endl;
+	return errors == 0;
+}
+
+int TypedKernels(int num)
+{
+	Device clDevice;
+	clDevice.Init();
+	if (clDevice.Context == NULL)
+		return 1;
+	const int repeats = 20;
+	std::cout << "mul2 on " << num << " elements, " << clDevice.GetSelected().deviceName << std::endl;
+	bool ok = RunTyped<cl_uchar>(clDevice, num, repeats);
+	ok &= RunTyped<cl_short>(clDevice, num, repeats);
+	ok &= RunTyped<cl_int>(clDevice, num, repeats);
+	ok &= RunTyped<cl_float>(clDevice, num, repeats);
+	//only instantiated on devices with cl_khr_fp64 or cl_amd_fp64
+	std::string extensions = Device::GetDeviceString(clDevice.pDevices[0], CL_DEVICE_EXTENSIONS);
+	if (extensions.find("fp64") != std::string::npos)
+		ok &= RunTyped<cl_double>(clDevice, num, repeats);
+	else
+		std::cout << "\tmul2_double:\tno fp64 on this device" << std::endl;
+	return ok ? 0 : 1;
+}
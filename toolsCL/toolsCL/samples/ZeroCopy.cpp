@@ -0,0 +1,79 @@
+#include "../device.hpp"
+#include "../shared_buffer.hpp"
+#include "../timer.hpp"
+
+//mul2 with copies in and out against mul2 on mapped SharedBuffers.
+//unifiedOnly picks an integrated GPU or CPU runtime, where the mapped
+//path is zero-copy; otherwise the best device runs the same code.
+int ZeroCopy(bool unifiedOnly)
+{
+	Device clDevice;
+	if (unifiedOnly)
+		clDevice.SetDevicePolicy(POLICY_UNIFIED);
+	clDevice.Init();
+	if (clDevice.Context == NULL)
+		return 1;
+	cl_command_queue queue = clDevice.CommandQueue;
+	cl_kernel kernel = clDevice.GetKernel<cl_float>("mul2");
+	if (kernel == NULL)
+		return 1;
+
+	int num = 1 << 24;
+	size_t bytes = sizeof(float) * num;
+	size_t global_work_size[] = { (size_t)num };
+	size_t local_work_size[] = { 256 };
+	const int runs = 10;
+
+	//! copy path: write, kernel, read
+	std::vector<float> h_idata(num), h_odata(num);
+	BufferLease d_idata = clDevice.Buffers.Acquire(bytes, CL_MEM_READ_ONLY);
+	BufferLease d_odata = clDevice.Buffers.Acquire(bytes, CL_MEM_WRITE_ONLY);
+	cl_mem idata = d_idata.Get(), odata = d_odata.Get();
+	clSetKernelArg(kernel, 0, sizeof(cl_mem), &idata);
+	clSetKernelArg(kernel, 1, sizeof(cl_mem), &odata);
+	int copyErrors = 0;
+	Timer timer;
+	for (int run = 0; run < runs; run++) {
+		for (int i = 0; i < num; i++)
+			h_idata[i] = (float) (i + run);
+		clEnqueueWriteBuffer(queue, idata, CL_FALSE, 0, bytes, &h_idata[0], 0, NULL, NULL);
+		clEnqueueNDRangeKernel(queue, kernel, 1, NULL, global_work_size, local_work_size, 0, NULL, NULL);
+		clEnqueueReadBuffer(queue, odata, CL_TRUE, 0, bytes, &h_odata[0], 0, NULL, NULL);
+		for (int i = 0; i < num; i++)
+			copyErrors += h_odata[i] != (float) (i + run) * 2;
+	}
+	double copyMs = timer.MilliSeconds() / runs;
+
+	//! mapped path: fill and read the device buffers in place
+	SharedBuffer in(clDevice, bytes, CL_MEM_READ_ONLY);
+	SharedBuffer out(clDevice, bytes, CL_MEM_WRITE_ONLY);
+	idata = in.Get();
+	odata = out.Get();
+	clSetKernelArg(kernel, 0, sizeof(cl_mem), &idata);
+	clSetKernelArg(kernel, 1, sizeof(cl_mem), &odata);
+	int errors = 0;
+	timer.Start();
+	for (int run = 0; run < runs; run++) {
+		float *p = (float *) in.Map(queue, CL_MAP_WRITE);
+		if (p == NULL)
+			return 1;
+		for (int i = 0; i < num; i++)
+			p[i] = (float) (i + run);
+		in.Unmap(queue);
+		clEnqueueNDRangeKernel(queue, kernel, 1, NULL, global_work_size, local_work_size, 0, NULL, NULL);
+		const float *q = (const float *) out.Map(queue, CL_MAP_READ);
+		if (q == NULL)
+			return 1;
+		for (int i = 0; i < num; i++)
+			errors += q[i] != (float) (i + run) * 2;
+		out.Unmap(queue);
+	}
+	clFinish(queue);
+	double mapMs = timer.MilliSeconds() / runs;
+
+	std::cout << "mul2 on " << (bytes >> 20) << " MB, " << clDevice.GetSelected().deviceName << std::endl;
+	std::cout << "\tcopy in/out:\t" << copyMs << " ms, " << copyErrors << " errors" << std::endl;
+	std::cout << "\tmapped (" << (in.ZeroCopy() ? "zero-copy" : "driver copy") << "):\t"
+		<< mapMs << " ms, " << errors << " errors" << std::endl;
+	return 0;
+}
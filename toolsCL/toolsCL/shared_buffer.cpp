@@ -0,0 +1,76 @@
+#include "shared_buffer.hpp"
+#include "device.hpp"
+#include <stdlib.h>
+#include <iostream>
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+//Zero-copy needs the host pointer on a page boundary and the size in
+//whole cache lines on most integrated GPUs
+static const size_t pageSize = 4096;
+static const size_t cacheLine = 64;
+
+static void *AlignedAlloc(size_t bytes, size_t alignment)
+{
+#ifdef _WIN32
+  return _aligned_malloc(bytes, alignment);
+#else
+  void *p = NULL;
+  return posix_memalign(&p, alignment, bytes) == 0 ? p : NULL;
+#endif
+}
+
+static void AlignedFree(void *p)
+{
+#ifdef _WIN32
+  _aligned_free(p);
+#else
+  free(p);
+#endif
+}
+
+SharedBuffer::SharedBuffer(Device &device, size_t bytes, cl_mem_flags flags)
+    : mem(NULL), size(bytes), hostMemory(NULL), mapped(NULL), profiler(device.Prof) {
+  cl_int err = CL_SUCCESS;
+  if (device.UnifiedMemory()) {
+    size_t rounded = (bytes + cacheLine - 1) / cacheLine * cacheLine;
+    hostMemory = AlignedAlloc(rounded, pageSize);
+    if (hostMemory != NULL)
+      mem = clCreateBuffer(device.Context, flags | CL_MEM_USE_HOST_PTR, rounded, hostMemory, &err);
+    if (mem != NULL)
+      return;
+    AlignedFree(hostMemory);
+    hostMemory = NULL;
+  }
+  mem = clCreateBuffer(device.Context, flags | CL_MEM_ALLOC_HOST_PTR, bytes, NULL, &err);
+  OCL_CHECK(err, "SharedBuffer: clCreateBuffer");
+}
+
+SharedBuffer::~SharedBuffer() {
+  if (mem != NULL)
+    clReleaseMemObject(mem);
+  if (hostMemory != NULL)
+    AlignedFree(hostMemory);
+}
+
+void *SharedBuffer::Map(cl_command_queue queue, cl_map_flags flags) {
+  if (mapped != NULL)
+    return mapped;
+  cl_int err = CL_SUCCESS;
+  HostSpan span(profiler, "map wait");
+  ProfileEvent pe(profiler, "map", PROFILE_MAP, ZeroCopy() ? 0 : size);
+  mapped = clEnqueueMapBuffer(queue, mem, CL_TRUE, flags, 0, size, 0, NULL, pe.Out(), &err);
+  OCL_CHECK(err, "SharedBuffer: clEnqueueMapBuffer");
+  return mapped;
+}
+
+cl_int SharedBuffer::Unmap(cl_command_queue queue) {
+  if (mapped == NULL)
+    return CL_SUCCESS;
+  ProfileEvent pe(profiler, "unmap", PROFILE_MAP, ZeroCopy() ? 0 : size);
+  cl_int err = clEnqueueUnmapMemObject(queue, mem, mapped, 0, NULL, pe.Out());
+  mapped = NULL;
+  clFlush(queue);
+  return err;
+}
@@ -0,0 +1,38 @@
+#ifndef SHARED_BUFFER_HPP
+#define SHARED_BUFFER_HPP
+#include <CL/cl.h>
+
+class Device;
+class Profiler;
+
+//A buffer the host reaches through Map/Unmap instead of read/write
+//copies. On a unified-memory device it wraps page-aligned host memory
+//(CL_MEM_USE_HOST_PTR), so mapping hands back that memory with no copy.
+//Elsewhere it is a CL_MEM_ALLOC_HOST_PTR buffer and the driver copies
+//on map/unmap; the calling code is the same on both.
+class SharedBuffer {
+  public:
+    SharedBuffer(Device &device, size_t bytes, cl_mem_flags flags = CL_MEM_READ_WRITE);
+    ~SharedBuffer();
+
+    cl_mem Get() const { return mem; }
+    size_t Size() const { return size; }
+    bool ZeroCopy() const { return hostMemory != NULL; }
+
+    //Blocking map of the whole buffer, NULL on failure. Unmap before the
+    //next kernel uses the buffer.
+    void *Map(cl_command_queue queue, cl_map_flags flags = CL_MAP_READ | CL_MAP_WRITE);
+    cl_int Unmap(cl_command_queue queue);
+
+  private:
+    SharedBuffer(const SharedBuffer &);
+    SharedBuffer &operator=(const SharedBuffer &);
+
+    cl_mem mem;
+    size_t size;
+    void *hostMemory;   //owned page-aligned memory behind a zero-copy buffer
+    void *mapped;
+    Profiler &profiler;
+};
+
+#endif //SHARED_BUFFER_HPP
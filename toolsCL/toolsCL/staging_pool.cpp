@@ -0,0 +1,138 @@
+#include "staging_pool.hpp"
+#include <string.h>
+#include <iostream>
+#include <algorithm>
+
+//stands in when the pool has no profiler
+static Profiler noProfiler;
+
+void StagingPool::SetContext(cl_context ctx, cl_command_queue queue, Profiler *prof) {
+  if (ctx != context)
+    Release();
+  std::lock_guard<std::mutex> guard(mutex);
+  context = ctx;
+  mapQueue = queue;
+  profiler = prof;
+}
+
+bool StagingPool::Allocate() {
+  std::lock_guard<std::mutex> guard(mutex);
+  return AllocateLocked();
+}
+
+bool StagingPool::AllocateLocked() {
+  if (!chunks.empty())
+    return true;
+  if (context == NULL || chunkSize == 0 || numChunks == 0)
+    return false;
+  for (size_t i = 0; i < numChunks; i++) {
+    cl_int err = CL_SUCCESS;
+    Staging chunk;
+    chunk.pending = NULL;
+    chunk.mem = clCreateBuffer(context, CL_MEM_READ_WRITE | CL_MEM_ALLOC_HOST_PTR,
+        chunkSize, NULL, &err);
+    chunk.host = NULL;
+    if (chunk.mem != NULL)
+      chunk.host = clEnqueueMapBuffer(mapQueue, chunk.mem, CL_TRUE, CL_MAP_READ | CL_MAP_WRITE,
+          0, chunkSize, 0, NULL, NULL, &err);
+    if (chunk.host == NULL) {
+      std::cout << "Err: StagingPool failed to map a " << chunkSize << " byte chunk ( Err = "
+          << err << " )" << std::endl;
+      if (chunk.mem != NULL)
+        clReleaseMemObject(chunk.mem);
+      break;
+    }
+    chunks.push_back(chunk);
+  }
+  return !chunks.empty();
+}
+
+void *StagingPool::Chunk(size_t index) {
+  std::lock_guard<std::mutex> guard(mutex);
+  if (!AllocateLocked() || index >= chunks.size())
+    return NULL;
+  WaitChunk(chunks[index]);
+  return chunks[index].host;
+}
+
+cl_int StagingPool::WaitChunk(Staging &chunk) {
+  cl_int err = CL_SUCCESS;
+  if (chunk.pending != NULL) {
+    HostSpan span(profiler ? *profiler : noProfiler, "wait staging chunk");
+    err = clWaitForEvents(1, &chunk.pending);
+    clReleaseEvent(chunk.pending);
+    chunk.pending = NULL;
+  }
+  return err;
+}
+
+cl_int StagingPool::Upload(cl_command_queue queue, cl_mem dst, size_t offset,
+    const void *src, size_t bytes) {
+  std::lock_guard<std::mutex> guard(mutex);
+  if (!AllocateLocked())
+    return CL_MEM_OBJECT_ALLOCATION_FAILURE;
+  cl_int err = CL_SUCCESS;
+  size_t done = 0;
+  for (size_t k = 0; done < bytes && err == CL_SUCCESS; k++) {
+    Staging &chunk = chunks[k % chunks.size()];
+    WaitChunk(chunk);
+    size_t n = std::min(chunkSize, bytes - done);
+    memcpy(chunk.host, (const char *) src + done, n);
+    ProfileEvent pe(profiler ? *profiler : noProfiler, "staging upload", PROFILE_WRITE, n, &chunk.pending);
+    err = clEnqueueWriteBuffer(queue, dst, CL_FALSE, offset + done, n, chunk.host,
+        0, NULL, pe.Out());
+    clFlush(queue);
+    done += n;
+  }
+  return err;
+}
+
+cl_int StagingPool::Download(cl_command_queue queue, cl_mem src, size_t offset,
+    void *dst, size_t bytes) {
+  std::lock_guard<std::mutex> guard(mutex);
+  if (!AllocateLocked())
+    return CL_MEM_OBJECT_ALLOCATION_FAILURE;
+  size_t pieces = (bytes + chunkSize - 1) / chunkSize;
+  size_t n = chunks.size();
+  cl_int err = CL_SUCCESS;
+  //keep every chunk busy, copy each piece out as soon as it lands
+  Profiler &prof = profiler ? *profiler : noProfiler;
+  for (size_t p = 0; p < std::min(n, pieces) && err == CL_SUCCESS; p++) {
+    WaitChunk(chunks[p]);
+    size_t len = std::min(chunkSize, bytes - p * chunkSize);
+    ProfileEvent pe(prof, "staging download", PROFILE_READ, len, &chunks[p].pending);
+    err = clEnqueueReadBuffer(queue, src, CL_FALSE, offset + p * chunkSize,
+        len, chunks[p].host, 0, NULL, pe.Out());
+  }
+  clFlush(queue);
+  for (size_t p = 0; p < pieces && err == CL_SUCCESS; p++) {
+    Staging &chunk = chunks[p % n];
+    err = WaitChunk(chunk);
+    memcpy((char *) dst + p * chunkSize, chunk.host, std::min(chunkSize, bytes - p * chunkSize));
+    size_t next = p + n;
+    if (next < pieces && err == CL_SUCCESS) {
+      size_t len = std::min(chunkSize, bytes - next * chunkSize);
+      ProfileEvent pe(prof, "staging download", PROFILE_READ, len, &chunk.pending);
+      err = clEnqueueReadBuffer(queue, src, CL_FALSE, offset + next * chunkSize,
+          len, chunk.host, 0, NULL, pe.Out());
+      clFlush(queue);
+    }
+  }
+  //a failed piece leaves reads in flight on the other chunks
+  for (size_t i = 0; i < n; i++)
+    WaitChunk(chunks[i]);
+  return err;
+}
+
+void StagingPool::Release() {
+  std::lock_guard<std::mutex> guard(mutex);
+  for (size_t i = 0; i < chunks.size(); i++) {
+    WaitChunk(chunks[i]);
+    clEnqueueUnmapMemObject(mapQueue, chunks[i].mem, chunks[i].host, 0, NULL, NULL);
+  }
+  if (!chunks.empty())
+    clFinish(mapQueue);
+  for (size_t i = 0; i < chunks.size(); i++)
+    clReleaseMemObject(chunks[i].mem);
+  chunks.clear();
+}
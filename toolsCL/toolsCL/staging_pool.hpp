@@ -0,0 +1,49 @@
+#ifndef STAGING_POOL_HPP
+#define STAGING_POOL_HPP
+#include <vector>
+#include <mutex>
+#include <CL/cl.h>
+#include "profiler.hpp"
+
+//Pinned host memory for transfers: CL_MEM_ALLOC_HOST_PTR buffers,
+//mapped once and kept mapped. Upload/Download move user data through
+//the chunks in turn, so the memcpy into one chunk overlaps the DMA of
+//the previous one, and the driver never bounces through its own copy
+//of pageable memory. The chunks are allocated on first use.
+class StagingPool {
+  public:
+    StagingPool()
+        : chunkSize(4 << 20), numChunks(3), context(NULL), mapQueue(NULL), profiler(NULL) {
+    }
+    ~StagingPool() { Release(); }
+
+    size_t chunkSize;   //bytes per chunk, set before first use
+    size_t numChunks;   //chunks in flight
+
+    void SetContext(cl_context ctx, cl_command_queue queue, Profiler *prof = NULL);
+    //Copy bytes from host src to dst at offset. Returns once src may be reused.
+    cl_int Upload(cl_command_queue queue, cl_mem dst, size_t offset, const void *src, size_t bytes);
+    //Copy bytes of src at offset to host dst. Blocking.
+    cl_int Download(cl_command_queue queue, cl_mem src, size_t offset, void *dst, size_t bytes);
+    //A mapped chunk for callers that fill pinned memory themselves
+    void *Chunk(size_t index);
+    bool Allocate();
+    void Release();
+
+  private:
+    struct Staging {
+      cl_mem mem;
+      void *host;       //persistent mapping of mem
+      cl_event pending; //last transfer that used the chunk
+    };
+    cl_int WaitChunk(Staging &chunk);
+    bool AllocateLocked();
+
+    cl_context context;
+    cl_command_queue mapQueue;
+    Profiler *profiler;
+    std::vector<Staging> chunks;
+    std::mutex mutex;
+};
+
+#endif //STAGING_POOL_HPP
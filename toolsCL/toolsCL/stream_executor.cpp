@@ -0,0 +1,186 @@
+#include "stream_executor.hpp"
+#include "device.hpp"
+#include "timer.hpp"
+#include <iostream>
+#include <algorithm>
+
+//One command of a run, kept for the profiling figures
+struct StreamEvent {
+  cl_event event;
+  bool kernel;
+};
+
+cl_int StreamExecutor::Run(cl_kernel kernel, size_t num, size_t local,
+    const std::vector<SplitBuffer> &buffers) {
+  return Execute(kernel, num, local, buffers, true);
+}
+
+cl_int StreamExecutor::RunSerial(cl_kernel kernel, size_t num, size_t local,
+    const std::vector<SplitBuffer> &buffers) {
+  return Execute(kernel, num, local, buffers, false);
+}
+
+cl_int StreamExecutor::Execute(cl_kernel kernel, size_t num, size_t local,
+    const std::vector<SplitBuffer> &buffers, bool overlap) {
+  stats = StreamStats();
+  size_t chunk = chunkElements > 0 ? chunkElements : num;
+  if (local > 0)
+    chunk = std::max(local, chunk / local * local);
+  size_t count = (num + chunk - 1) / chunk;
+  cl_command_queue compute = dev.CommandQueue;
+  cl_command_queue transfer = overlap ? dev.CommandQueue_helper : dev.CommandQueue;
+
+  //two sets of device buffers, chunk i uses set i % 2
+  std::vector<BufferLease> slots[2];
+  for (int s = 0; s < 2; s++) {
+    for (size_t b = 0; b < buffers.size(); b++) {
+      slots[s].push_back(dev.Buffers.Acquire(chunk * buffers[b].elementSize, buffers[b].flags));
+      if (!slots[s].back().Valid())
+        return CL_MEM_OBJECT_ALLOCATION_FAILURE;
+    }
+  }
+
+  std::vector<cl_event> lastWrite(count, (cl_event) NULL), kernelDone(count, (cl_event) NULL),
+      lastRead(count, (cl_event) NULL);
+  std::vector<StreamEvent> all;
+  cl_int err = CL_SUCCESS;
+
+  //inputs of chunk i, once the kernel that last read the slot is done
+  auto write = [&](size_t i) {
+    size_t n = std::min(chunk, num - i * chunk);
+    std::vector<cl_event> wait;
+    if (i >= 2 && kernelDone[i - 2] != NULL)
+      wait.push_back(kernelDone[i - 2]);
+    for (size_t b = 0; b < buffers.size() && err == CL_SUCCESS; b++) {
+      const SplitBuffer &sb = buffers[b];
+      if (sb.flags & CL_MEM_WRITE_ONLY)
+        continue;
+      cl_event event = NULL;
+      ProfileEvent pe(dev.Prof, "stream write", PROFILE_WRITE, n * sb.elementSize, &event);
+      err = clEnqueueWriteBuffer(transfer, slots[i % 2][b].Get(), CL_FALSE, 0, n * sb.elementSize,
+          (const char *) sb.host + i * chunk * sb.elementSize, (cl_uint) wait.size(),
+          wait.empty() ? NULL : &wait[0], pe.Out());
+      if (err != CL_SUCCESS)
+        break;
+      StreamEvent se = { event, false };
+      all.push_back(se);
+      lastWrite[i] = event;
+      stats.bytes += n * sb.elementSize;
+    }
+    clFlush(transfer);
+  };
+  //kernel on chunk i, once its inputs landed and the slot's outputs were read
+  auto launch = [&](size_t i) {
+    size_t n = std::min(chunk, num - i * chunk);
+    std::vector<cl_event> wait;
+    if (lastWrite[i] != NULL)
+      wait.push_back(lastWrite[i]);
+    if (i >= 2 && lastRead[i - 2] != NULL)
+      wait.push_back(lastRead[i - 2]);
+    for (size_t b = 0; b < buffers.size() && err == CL_SUCCESS; b++) {
+      cl_mem mem = slots[i % 2][b].Get();
+      err = clSetKernelArg(kernel, buffers[b].arg, sizeof(cl_mem), &mem);
+    }
+    if (err != CL_SUCCESS)
+      return;
+    //a partial last chunk lets the runtime pick the work-group size
+    size_t global = n;
+    {
+      ProfileEvent pe(dev.Prof, kernel, &kernelDone[i]);
+      err = clEnqueueNDRangeKernel(compute, kernel, 1, NULL, &global,
+          (local > 0 && n % local == 0) ? &local : NULL, (cl_uint) wait.size(),
+          wait.empty() ? NULL : &wait[0], pe.Out());
+    }
+    if (err != CL_SUCCESS)
+      return;
+    StreamEvent se = { kernelDone[i], true };
+    all.push_back(se);
+    clFlush(compute);
+  };
+  //outputs of chunk i, once its kernel is done
+  auto read = [&](size_t i) {
+    size_t n = std::min(chunk, num - i * chunk);
+    for (size_t b = 0; b < buffers.size() && err == CL_SUCCESS; b++) {
+      const SplitBuffer &sb = buffers[b];
+      if (sb.flags & CL_MEM_READ_ONLY)
+        continue;
+      cl_event event = NULL;
+      ProfileEvent pe(dev.Prof, "stream read", PROFILE_READ, n * sb.elementSize, &event);
+      err = clEnqueueReadBuffer(transfer, slots[i % 2][b].Get(), CL_FALSE, 0, n * sb.elementSize,
+          (char *) sb.host + i * chunk * sb.elementSize, 1, &kernelDone[i], pe.Out());
+      if (err != CL_SUCCESS)
+        break;
+      StreamEvent se = { event, false };
+      all.push_back(se);
+      lastRead[i] = event;
+      stats.bytes += n * sb.elementSize;
+    }
+    clFlush(transfer);
+  };
+
+  Timer wall;
+  if (overlap) {
+    //transfer queue order: w0 w1 r0 w2 r1 ..., so w(i+1) and r(i-1)
+    //run while kernel i computes
+    if (count > 0)
+      write(0);
+    for (size_t i = 0; i < count && err == CL_SUCCESS; i++) {
+      launch(i);
+      if (i + 1 < count && err == CL_SUCCESS)
+        write(i + 1);
+      if (err == CL_SUCCESS)
+        read(i);
+    }
+  } else {
+    for (size_t i = 0; i < count && err == CL_SUCCESS; i++) {
+      write(i);
+      if (err == CL_SUCCESS)
+        launch(i);
+      if (err == CL_SUCCESS)
+        read(i);
+      HostSpan span(dev.Prof, "wait chunk");
+      clFinish(transfer);
+    }
+  }
+  {
+    HostSpan span(dev.Prof, "wait stream");
+    clFinish(transfer);
+    clFinish(compute);
+  }
+  stats.wallMs = wall.MilliSeconds();
+  stats.chunks = count;
+  OCL_CHECK(err, "StreamExecutor");
+
+  //device time per kind, and the union of all intervals
+  std::vector<std::pair<cl_ulong, cl_ulong> > spans;
+  for (size_t i = 0; i < all.size(); i++) {
+    cl_ulong start = 0, end = 0;
+    clGetEventProfilingInfo(all[i].event, CL_PROFILING_COMMAND_START, sizeof(cl_ulong), &start, NULL);
+    clGetEventProfilingInfo(all[i].event, CL_PROFILING_COMMAND_END, sizeof(cl_ulong), &end, NULL);
+    clReleaseEvent(all[i].event);
+    if (end <= start)
+      continue;
+    double ms = (end - start) / 1e6;
+    if (all[i].kernel)
+      stats.kernelMs += ms;
+    else
+      stats.transferMs += ms;
+    spans.push_back(std::make_pair(start, end));
+  }
+  std::sort(spans.begin(), spans.end());
+  cl_ulong busy = 0, coveredTo = 0;
+  for (size_t i = 0; i < spans.size(); i++) {
+    cl_ulong begin = std::max(spans[i].first, coveredTo);
+    if (spans[i].second > begin)
+      busy += spans[i].second - begin;
+    coveredTo = std::max(coveredTo, spans[i].second);
+  }
+  stats.busyMs = busy / 1e6;
+  return err;
+}
+
+void StreamExecutor::Display(const char *label) {
+  std::cout << label << ": " << stats.chunks << " chunks, wall " << stats.wallMs << " ms, "
+      << stats.GBs() << " GB/s, transfer " << stats.transferMs << " ms, kernel "
+      << stats.kernelMs << " ms, transfer hidden " << stats.HiddenPercent() << " %" << std::endl;
+}
@@ -0,0 +1,50 @@
+#ifndef STREAM_EXECUTOR_HPP
+#define STREAM_EXECUTOR_HPP
+#include <vector>
+#include <CL/cl.h>
+#include "ndrange_split.hpp"
+
+class Device;
+
+struct StreamStats {
+  StreamStats() : chunks(0), bytes(0), wallMs(0), transferMs(0), kernelMs(0), busyMs(0) {}
+  size_t chunks;
+  size_t bytes;        //moved host<->device
+  double wallMs;       //host time of the whole run
+  double transferMs;   //device time spent in writes and reads
+  double kernelMs;     //device time spent in kernels
+  double busyMs;       //device time with at least one command running
+  //share of the transfer time that ran under a kernel
+  double HiddenPercent() const {
+    return transferMs > 0 ? 100.0 * (transferMs + kernelMs - busyMs) / transferMs : 0;
+  }
+  double GBs() const { return wallMs > 0 ? bytes / (wallMs * 1e6) : 0; }
+};
+
+//Streams an elementwise kernel over host arrays too large for one
+//launch, chunkElements work-items at a time. Run double-buffers: writes
+//and reads go to CommandQueue_helper and kernels to CommandQueue, linked
+//by events, so chunk i+1 uploads and chunk i-1 downloads while chunk i
+//computes. RunSerial does write, kernel, blocking read per chunk on one
+//queue for comparison. Arguments that are not split must be set on the
+//kernel beforehand.
+class StreamExecutor {
+  public:
+    StreamExecutor(Device &device, size_t chunkElements = 1 << 20)
+        : chunkElements(chunkElements), dev(device) {
+    }
+
+    size_t chunkElements;
+    StreamStats stats;   //of the last run
+
+    cl_int Run(cl_kernel kernel, size_t num, size_t local, const std::vector<SplitBuffer> &buffers);
+    cl_int RunSerial(cl_kernel kernel, size_t num, size_t local, const std::vector<SplitBuffer> &buffers);
+    void Display(const char *label);
+
+  private:
+    cl_int Execute(cl_kernel kernel, size_t num, size_t local,
+        const std::vector<SplitBuffer> &buffers, bool overlap);
+    Device &dev;
+};
+
+#endif //STREAM_EXECUTOR_HPP
@@ -0,0 +1,57 @@
+#include "thread_pool.hpp"
+
+ThreadPool::ThreadPool(size_t threads) : active(0), stop(false) {
+  if (threads == 0)
+    threads = std::thread::hardware_concurrency();
+  if (threads == 0)
+    threads = 1;
+  for (size_t i = 0; i < threads; i++)
+    workers.push_back(std::thread(&ThreadPool::Worker, this));
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    stop = true;
+  }
+  taskReady.notify_all();
+  for (size_t i = 0; i < workers.size(); i++)
+    workers[i].join();
+}
+
+void ThreadPool::Enqueue(std::function<void()> task) {
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    tasks.push(task);
+  }
+  taskReady.notify_one();
+}
+
+void ThreadPool::Wait() {
+  std::unique_lock<std::mutex> lock(mutex);
+  while (!tasks.empty() || active > 0)
+    allDone.wait(lock);
+}
+
+void ThreadPool::Worker() {
+  for (;;) {
+    std::function<void()> task;
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      while (!stop && tasks.empty())
+        taskReady.wait(lock);
+      if (stop && tasks.empty())
+        return;
+      task = tasks.front();
+      tasks.pop();
+      active++;
+    }
+    task();
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      active--;
+      if (tasks.empty() && active == 0)
+        allDone.notify_all();
+    }
+  }
+}
@@ -0,0 +1,34 @@
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+#include <vector>
+#include <queue>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+//Fixed set of host worker threads running queued tasks
+class ThreadPool {
+  public:
+    //threads == 0 uses one worker per hardware thread
+    explicit ThreadPool(size_t threads = 0);
+    ~ThreadPool();
+
+    void Enqueue(std::function<void()> task);
+    //Block until every queued task has finished
+    void Wait();
+    size_t Size() const { return workers.size(); }
+
+  private:
+    void Worker();
+
+    std::vector<std::thread> workers;
+    std::queue<std::function<void()> > tasks;
+    std::mutex mutex;
+    std::condition_variable taskReady;
+    std::condition_variable allDone;
+    size_t active;
+    bool stop;
+};
+
+#endif //THREAD_POOL_HPP
@@ -0,0 +1,264 @@
+#include "tiler.hpp"
+#include "device.hpp"
+#include "timer.hpp"
+#include <string.h>
+#include <algorithm>
+
+#ifdef _WIN32
+#define fseek64 _fseeki64
+#define ftell64 _ftelli64
+#else
+#define fseek64 fseeko
+#define ftell64 ftello
+#endif
+
+bool MemoryImage::Read(int x, int y, int w, int h, unsigned char *rgba, size_t pitch) {
+  for (int j = 0; j < h; j++)
+    memcpy(rgba + pitch * j, &pixels[((size_t) (y + j) * width + x) * 4], (size_t) w * 4);
+  return true;
+}
+
+bool MemoryImage::Write(int x, int y, int w, int h, const unsigned char *rgba, size_t pitch) {
+  for (int j = 0; j < h; j++)
+    memcpy(&pixels[((size_t) (y + j) * width + x) * 4], rgba + pitch * j, (size_t) w * 4);
+  return true;
+}
+
+ImageFileSource::~ImageFileSource() {
+  if (file != NULL)
+    fclose(file);
+}
+
+bool ImageFileSource::Open(const std::string &path) {
+  file = fopen(path.c_str(), "rb");
+  if (file == NULL) {
+    std::cout << "Err: cannot open " << path << std::endl;
+    return false;
+  }
+  //BMP headers are 54 bytes, PNM headers a few short lines
+  unsigned char head[512];
+  size_t got = fread(head, 1, sizeof(head), file);
+  fseek64(file, 0, SEEK_END);
+  long long size = ftell64(file);
+  return ParseImageHeader(head, got, header, size > 0 ? size : 0);
+}
+
+bool ImageFileSource::Read(int x, int y, int w, int h, unsigned char *rgba, size_t pitch) {
+  row.resize((size_t) w * header.channels);
+  for (int j = 0; j < h; j++) {
+    long long offset = (long long) header.offset + header.rowPitch * (y + j) + (long long) x * header.channels;
+    if (fseek64(file, offset, SEEK_SET) != 0 || fread(&row[0], 1, row.size(), file) != row.size())
+      return false;
+    RowToRGBA(header, &row[0], rgba + pitch * j, w);
+  }
+  return true;
+}
+
+ImageFileSink::~ImageFileSink() {
+  if (file != NULL)
+    fclose(file);
+}
+
+bool ImageFileSink::Create(const std::string &path, int width, int height) {
+  ImageFileFormat format = ImageFormatFromName(path);
+  size_t bytes = ImageFileSize(format, width, height);
+  file = bytes > 0 ? fopen(path.c_str(), "wb") : NULL;
+  if (file == NULL) {
+    std::cout << "Err: cannot write " << path << std::endl;
+    return false;
+  }
+  unsigned char head[64];
+  WriteImageHeader(format, width, height, head, header);
+  size_t headBytes = format == IMAGE_BMP ? 54 : header.offset;
+  fwrite(head, 1, headBytes, file);
+  //full size up front: BMP row padding stays zero
+  fseek64(file, (long long) bytes - 1, SEEK_SET);
+  fputc(0, file);
+  return true;
+}
+
+bool ImageFileSink::Write(int x, int y, int w, int h, const unsigned char *rgba, size_t pitch) {
+  row.resize((size_t) w * header.channels);
+  for (int j = 0; j < h; j++) {
+    RowFromRGBA(header, rgba + pitch * j, &row[0], w);
+    long long offset = (long long) header.offset + header.rowPitch * (y + j) + (long long) x * header.channels;
+    if (fseek64(file, offset, SEEK_SET) != 0 || fwrite(&row[0], 1, row.size(), file) != row.size())
+      return false;
+  }
+  return true;
+}
+
+//Largest interior that fits the device with the halo around it
+void ImageTiler::ChooseTileSize(int width, int height) {
+  cl_device_id device = dev.pDevices[0];
+  size_t maxWidth = 0, maxHeight = 0;
+  cl_ulong maxAlloc = 0;
+  clGetDeviceInfo(device, CL_DEVICE_IMAGE2D_MAX_WIDTH, sizeof(size_t), &maxWidth, NULL);
+  clGetDeviceInfo(device, CL_DEVICE_IMAGE2D_MAX_HEIGHT, sizeof(size_t), &maxHeight, NULL);
+  clGetDeviceInfo(device, CL_DEVICE_MAX_MEM_ALLOC_SIZE, sizeof(cl_ulong), &maxAlloc, NULL);
+  //room for a float4 copy of the tile, as SeparableGaussian keeps
+  cl_ulong maxPixels = maxAlloc / 16;
+  int edge = maxTile;
+  while (edge > 16 && (cl_ulong) (edge + 2 * halo) * (edge + 2 * halo) > maxPixels)
+    edge /= 2;
+  tileWidth = std::min(edge, width);
+  tileHeight = std::min(edge, height);
+  if (maxWidth > 0)
+    tileWidth = std::min(tileWidth, (int) maxWidth - 2 * halo);
+  if (maxHeight > 0)
+    tileHeight = std::min(tileHeight, (int) maxHeight - 2 * halo);
+}
+
+//The tile at (x0, y0) of fw x fh, edge pixels repeated past the image
+static bool FillTile(TileSource &src, unsigned char *tile, int x0, int y0, int fw, int fh) {
+  int cx0 = std::max(x0, 0), cy0 = std::max(y0, 0);
+  int cx1 = std::min(x0 + fw, src.Width()), cy1 = std::min(y0 + fh, src.Height());
+  size_t pitch = (size_t) fw * 4;
+  if (!src.Read(cx0, cy0, cx1 - cx0, cy1 - cy0, tile + (cy0 - y0) * pitch + (size_t) (cx0 - x0) * 4, pitch))
+    return false;
+  for (int j = cy0 - y0; j < cy1 - y0; j++) {
+    unsigned int *line = (unsigned int *) (tile + j * pitch);
+    std::fill(line, line + (cx0 - x0), line[cx0 - x0]);
+    std::fill(line + (cx1 - x0), line + fw, line[cx1 - x0 - 1]);
+  }
+  for (int j = 0; j < cy0 - y0; j++)
+    memcpy(tile + j * pitch, tile + (cy0 - y0) * pitch, pitch);
+  for (int j = cy1 - y0; j < fh; j++)
+    memcpy(tile + j * pitch, tile + (cy1 - y0 - 1) * pitch, pitch);
+  return true;
+}
+
+namespace {
+struct TileSlot {
+  TileSlot() : in(NULL), out(NULL), written(NULL), filtered(NULL), read(NULL), x(0), y(0), w(0), h(0) {}
+  cl_mem in;
+  cl_mem out;
+  std::vector<unsigned char> host;    //tile with halo
+  std::vector<unsigned char> result;  //interior
+  cl_event written;
+  cl_event filtered;
+  cl_event read;
+  int x, y, w, h;
+};
+
+void ReleaseEvent(cl_event &event) {
+  if (event != NULL)
+    clReleaseEvent(event);
+  event = NULL;
+}
+
+//Finish the slot's tile and hand its interior to the sink
+bool Drain(TileSlot &slot, TileSink &dst) {
+  bool ok = true;
+  if (slot.read != NULL) {
+    ok = clWaitForEvents(1, &slot.read) == CL_SUCCESS
+        && dst.Write(slot.x, slot.y, slot.w, slot.h, &slot.result[0], (size_t) slot.w * 4);
+  } else if (slot.written != NULL) {
+    clWaitForEvents(1, &slot.written);
+  }
+  ReleaseEvent(slot.written);
+  ReleaseEvent(slot.filtered);
+  ReleaseEvent(slot.read);
+  return ok;
+}
+}
+
+cl_int ImageTiler::Run(TileSource &src, TileSink &dst, TileFilter filter) {
+  int width = src.Width(), height = src.Height();
+  ChooseTileSize(width, height);
+  if (tileWidth <= 0 || tileHeight <= 0) {
+    std::cout << "Err: ImageTiler halo " << halo << " leaves no room for a tile" << std::endl;
+    return CL_INVALID_IMAGE_SIZE;
+  }
+  int fullWidth = tileWidth + 2 * halo, fullHeight = tileHeight + 2 * halo;
+  int tilesX = (width + tileWidth - 1) / tileWidth;
+  int tilesY = (height + tileHeight - 1) / tileHeight;
+  tiles = (size_t) tilesX * tilesY;
+  cl_command_queue transfers = dev.CommandQueue_helper;
+  cl_command_queue compute = dev.CommandQueue;
+
+  cl_image_format format;
+  format.image_channel_order = CL_RGBA;
+  format.image_channel_data_type = CL_UNORM_INT8;
+  cl_int err = CL_SUCCESS;
+  TileSlot slots[2];
+  for (int i = 0; i < 2 && err == CL_SUCCESS; i++) {
+    slots[i].in = clCreateImage2D(dev.Context, CL_MEM_READ_WRITE, &format, fullWidth, fullHeight, 0, NULL, &err);
+    if (err == CL_SUCCESS)
+      slots[i].out = clCreateImage2D(dev.Context, CL_MEM_READ_WRITE, &format, fullWidth, fullHeight, 0, NULL, &err);
+    slots[i].host.resize((size_t) fullWidth * fullHeight * 4);
+    slots[i].result.resize((size_t) tileWidth * tileHeight * 4);
+  }
+  OCL_CHECK(err, "ImageTiler: tile images");
+
+  //tile t: host fill, write and filter; then the read of tile t-1, so the
+  //transfer queue runs w0 w1 r0 w2 r1 ... and tile t uploads while t-1 filters
+  for (size_t t = 0; t <= tiles && err == CL_SUCCESS; t++) {
+    if (t < tiles) {
+      TileSlot &slot = slots[t % 2];
+      if (!Drain(slot, dst)) {
+        err = CL_INVALID_VALUE;
+        break;
+      }
+      slot.x = (int) (t % tilesX) * tileWidth;
+      slot.y = (int) (t / tilesX) * tileHeight;
+      slot.w = std::min(tileWidth, width - slot.x);
+      slot.h = std::min(tileHeight, height - slot.y);
+      if (!FillTile(src, &slot.host[0], slot.x - halo, slot.y - halo, fullWidth, fullHeight)) {
+        std::cout << "Err: ImageTiler cannot read the tile at " << slot.x << "," << slot.y << std::endl;
+        err = CL_INVALID_VALUE;
+        break;
+      }
+      size_t origin[3] = { 0, 0, 0 };
+      size_t region[3] = { (size_t) fullWidth, (size_t) fullHeight, 1 };
+      {
+        ProfileEvent pe(dev.Prof, "tile write", PROFILE_WRITE, slot.host.size(), &slot.written);
+        err = clEnqueueWriteImage(transfers, slot.in, CL_FALSE, origin, region, (size_t) fullWidth * 4, 0,
+            &slot.host[0], 0, NULL, pe.Out());
+      }
+      if (err != CL_SUCCESS)
+        break;
+#ifdef CL_VERSION_1_2
+      err = clEnqueueBarrierWithWaitList(compute, 1, &slot.written, NULL);
+#else
+      err = clEnqueueWaitForEvents(compute, 1, &slot.written);
+#endif
+      if (err == CL_SUCCESS)
+        err = filter(slot.in, slot.out, fullWidth, fullHeight);
+      if (err == CL_SUCCESS) {
+#ifdef CL_VERSION_1_2
+        err = clEnqueueMarkerWithWaitList(compute, 0, NULL, &slot.filtered);
+#else
+        err = clEnqueueMarker(compute, &slot.filtered);
+#endif
+      }
+      if (err != CL_SUCCESS)
+        break;
+      clFlush(compute);
+    }
+    if (t >= 1) {
+      TileSlot &prev = slots[(t - 1) % 2];
+      size_t origin[3] = { (size_t) halo, (size_t) halo, 0 };
+      size_t region[3] = { (size_t) prev.w, (size_t) prev.h, 1 };
+      ProfileEvent pe(dev.Prof, "tile read", PROFILE_READ, (size_t) prev.w * prev.h * 4, &prev.read);
+      err = clEnqueueReadImage(transfers, prev.out, CL_FALSE, origin, region, (size_t) prev.w * 4, 0,
+          &prev.result[0], 1, &prev.filtered, pe.Out());
+    }
+    clFlush(transfers);
+  }
+  OCL_CHECK(err, "ImageTiler: tile");
+
+  for (int i = 0; i < 2; i++) {
+    if (!Drain(slots[i], dst) && err == CL_SUCCESS)
+      err = CL_INVALID_VALUE;
+  }
+  clFinish(compute);
+  clFinish(transfers);
+  for (int i = 0; i < 2; i++) {
+    if (slots[i].in != NULL)
+      clReleaseMemObject(slots[i].in);
+    if (slots[i].out != NULL)
+      clReleaseMemObject(slots[i].out);
+  }
+  return err;
+}
@@ -0,0 +1,103 @@
+#ifndef TILER_HPP
+#define TILER_HPP
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <functional>
+#include <CL/cl.h>
+#include "image_io.hpp"
+
+class Device;
+
+//An RGBA8 image read a rectangle at a time; the rectangle lies inside
+//the image, rows of pitch bytes
+class TileSource {
+  public:
+    virtual ~TileSource() {}
+    virtual int Width() const = 0;
+    virtual int Height() const = 0;
+    virtual bool Read(int x, int y, int w, int h, unsigned char *rgba, size_t pitch) = 0;
+};
+
+class TileSink {
+  public:
+    virtual ~TileSink() {}
+    virtual bool Write(int x, int y, int w, int h, const unsigned char *rgba, size_t pitch) = 0;
+};
+
+//RGBA8 pixels in host memory, as source and sink
+class MemoryImage : public TileSource, public TileSink {
+  public:
+    MemoryImage(int width, int height) : width(width), height(height), pixels((size_t) width * height * 4) {}
+    int Width() const { return width; }
+    int Height() const { return height; }
+    bool Read(int x, int y, int w, int h, unsigned char *rgba, size_t pitch);
+    bool Write(int x, int y, int w, int h, const unsigned char *rgba, size_t pitch);
+
+    int width;
+    int height;
+    std::vector<unsigned char> pixels;
+};
+
+//BMP/PPM/PGM file read with a seek per row segment: only the tiles in
+//flight are ever in host memory
+class ImageFileSource : public TileSource {
+  public:
+    ImageFileSource() : file(NULL) {}
+    ~ImageFileSource();
+    bool Open(const std::string &path);
+    int Width() const { return header.width; }
+    int Height() const { return header.height; }
+    bool Read(int x, int y, int w, int h, unsigned char *rgba, size_t pitch);
+
+  private:
+    FILE *file;
+    ImageFileHeader header;
+    std::vector<unsigned char> row;
+};
+
+//Output file of the extension's format, created at full size and filled
+//a tile at a time
+class ImageFileSink : public TileSink {
+  public:
+    ImageFileSink() : file(NULL) {}
+    ~ImageFileSink();
+    bool Create(const std::string &path, int width, int height);
+    bool Write(int x, int y, int w, int h, const unsigned char *rgba, size_t pitch);
+
+  private:
+    FILE *file;
+    ImageFileHeader header;
+    std::vector<unsigned char> row;
+};
+
+//Filter applied to each tile: RGBA8 images of width x height, on the
+//Device's CommandQueue, e.g. SeparableGaussian::Run
+typedef std::function<cl_int(cl_mem src, cl_mem dst, int width, int height)> TileFilter;
+
+//Runs a filter over images of any size, one device-sized tile at a
+//time. Each tile carries a halo of the filter's radius; past the image
+//border the halo repeats the edge pixels, so the filter sees the same
+//clamp-to-edge image it would see whole and the stitched output has no
+//seams. Tiles are double-buffered: uploads and downloads run on
+//CommandQueue_helper and the filter on CommandQueue, while the host
+//reads the next tile and writes the previous one.
+class ImageTiler {
+  public:
+    ImageTiler(Device &device, int halo) : halo(halo), maxTile(2048), tileWidth(0), tileHeight(0),
+        tiles(0), dev(device) {}
+
+    int halo;      //pixels of context the filter needs on each side
+    int maxTile;   //interior edge cap, lowered further to fit the device
+    int tileWidth; //interior size of the last run
+    int tileHeight;
+    size_t tiles;
+
+    cl_int Run(TileSource &src, TileSink &dst, TileFilter filter);
+
+  private:
+    void ChooseTileSize(int width, int height);
+    Device &dev;
+};
+
+#endif //TILER_HPP
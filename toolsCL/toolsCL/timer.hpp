@@ -0,0 +1,20 @@
+#ifndef TIMER_HPP
+#define TIMER_HPP
+#include <chrono>
+
+//Wall-clock stopwatch used for host-side timings
+class Timer {
+  public:
+    Timer() { Start(); }
+
+    void Start() { start = std::chrono::steady_clock::now(); }
+    double MilliSeconds() const {
+      return std::chrono::duration<double, std::milli>(
+          std::chrono::steady_clock::now() - start).count();
+    }
+
+  private:
+    std::chrono::steady_clock::time_point start;
+};
+
+#endif //TIMER_HPP
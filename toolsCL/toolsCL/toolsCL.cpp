@@ -8,6 +8,21 @@ int _tmain(int argc, _TCHAR* argv[])
 {
 	//BufferMul();
 	ImageFilter2D();
+	//KernelBinaries();
+	//MultiDevice(4);
+	//TransferBandwidth();
+	//ZeroCopy();
+	//StreamPipeline();
+	//KernelThreads();
+	//LaunchOverhead();
+	//GaussianBenchmark();
+	//ConvolutionBenchmark();
+	//TiledFilter("scan.bmp", "scan_blur.bmp");
+	//TypedKernels();
+	//HalfStorage();
+	//FusedExpression();
+	//ElementwiseBandwidth();
+	//ReduceBenchmark();
 
 	return 0;
 }
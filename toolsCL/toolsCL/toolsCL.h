@@ -3,6 +3,36 @@
 
 void BufferMul();
 
-int ImageFilter2D();
+int ImageFilter2D(int radius = 1);
+
+int KernelBinaries();
+
+int MultiDevice(int subDevices = 0);
+
+int TransferBandwidth();
+
+int ZeroCopy(bool unifiedOnly = true);
+
+int StreamPipeline();
+
+int KernelThreads(int maxThreads = 8);
+
+int LaunchOverhead();
+
+int GaussianBenchmark();
+
+int ConvolutionBenchmark();
+
+int TiledFilter(const char *input = NULL, const char *output = "tiled_out.bmp", int radius = 15);
+
+int TypedKernels(int num = 1 << 24);
+
+int HalfStorage(int num = 1 << 24);
+
+int FusedExpression(int num = 1 << 24);
+
+int ElementwiseBandwidth();
+
+int ReduceBenchmark(int num = 1 << 24);
 
 #endif//#ifndef TOOLSCL_H_
\ No newline at end of file